@@ -0,0 +1,67 @@
+#include "p2p-resource-sync/catalog_codec.hpp"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+p2p::LocalCatalog makeCatalog(size_t resource_count) {
+  p2p::LocalCatalog catalog{.version = 1, .resources = {}};
+  catalog.resources.reserve(resource_count);
+  for (size_t i = 0; i < resource_count; ++i) {
+    auto name = "shared/file_" + std::to_string(i) + ".bin";
+    catalog.resources.push_back(
+        std::make_shared<const p2p::ResourceInfo>(p2p::ResourceInfo{
+            .name = name,
+            .path = "/srv/" + name,
+            .size = i * 4096,
+            .lastModified = 1700000000,
+            .fileModified = 0,
+            .contentHash = std::nullopt}));
+  }
+  return catalog;
+}
+} // namespace
+
+// What the broadcaster does when the catalog version changes
+static void BM_AnnouncementSerialize(benchmark::State &state) {
+  auto catalog = makeCatalog(static_cast<size_t>(state.range(0)));
+  size_t bytes = 0;
+  for (auto _ : state) {
+    auto entries = p2p::CatalogCodec::serializeEntries(
+        p2p::CatalogCodec::fromLocalResources(catalog));
+    bytes = entries.size();
+    benchmark::DoNotOptimize(entries.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_AnnouncementSerialize)->RangeMultiplier(8)->Range(8, 8 << 9);
+
+static void BM_AnnouncementParse(benchmark::State &state) {
+  auto count = static_cast<uint32_t>(state.range(0));
+  auto entries = p2p::CatalogCodec::serializeEntries(
+      p2p::CatalogCodec::fromLocalResources(makeCatalog(count)));
+  for (auto _ : state) {
+    auto resources =
+        p2p::CatalogCodec::parseEntries(entries.data(), entries.size(), count);
+    benchmark::DoNotOptimize(resources.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(entries.size()));
+}
+BENCHMARK(BM_AnnouncementParse)->RangeMultiplier(8)->Range(8, 8 << 9);
+
+static void BM_CatalogDigest(benchmark::State &state) {
+  auto entries = p2p::CatalogCodec::serializeEntries(
+      p2p::CatalogCodec::fromLocalResources(
+          makeCatalog(static_cast<size_t>(state.range(0)))));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        p2p::CatalogCodec::digest(entries.data(), entries.size()));
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(entries.size()));
+}
+BENCHMARK(BM_CatalogDigest)->RangeMultiplier(8)->Range(8, 8 << 9);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "p2p-resource-sync/logger.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Sends stderr, and so the log, to /dev/null while in scope
+ *
+ * Keeps benchmarks that log on every iteration from flooding the console.
+ * Queued log messages are written before stderr is restored.
+ */
+class DiscardedStderr {
+public:
+  DiscardedStderr() : saved_(dup(STDERR_FILENO)) {
+    int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    dup2(null, STDERR_FILENO);
+    close(null);
+  }
+
+  ~DiscardedStderr() {
+    p2p::Logger::flush();
+    dup2(this->saved_, STDERR_FILENO);
+    close(this->saved_);
+  }
+
+  DiscardedStderr(const DiscardedStderr &) = delete;
+  DiscardedStderr &operator=(const DiscardedStderr &) = delete;
+
+private:
+  int saved_;
+};
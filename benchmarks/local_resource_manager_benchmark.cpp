@@ -0,0 +1,103 @@
+#include "discarded_stderr.hpp"
+#include "p2p-resource-sync/local_resource_manager.hpp"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+const std::filesystem::path shared_file =
+    std::filesystem::temp_directory_path() / "p2p_benchmark_resource.bin";
+
+std::string resourceName(size_t i) {
+  return "shared/file_" + std::to_string(i) + ".bin";
+}
+
+// Every resource points at the same small file
+std::unique_ptr<p2p::LocalResourceManager> makeManager(size_t resource_count) {
+  std::ofstream(shared_file, std::ios::binary | std::ios::trunc) << "content";
+  auto manager = std::make_unique<p2p::LocalResourceManager>();
+  std::vector<p2p::NewResource> resources;
+  for (size_t i = 0; i < resource_count; ++i) {
+    resources.push_back(
+        p2p::NewResource{.name = resourceName(i), .path = shared_file.string()});
+  }
+  DiscardedStderr quiet;
+  manager->addResources(resources);
+  return manager;
+}
+
+// Shared by the threads of one run; set up and torn down by thread 0
+std::unique_ptr<p2p::LocalResourceManager> shared_manager;
+
+void setUpShared(const benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    shared_manager = makeManager(static_cast<size_t>(state.range(0)));
+  }
+}
+
+void tearDownShared(const benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    shared_manager.reset();
+    std::filesystem::remove(shared_file);
+  }
+}
+} // namespace
+
+// The read path: the snapshot is already published
+static void BM_LocalGetSnapshot(benchmark::State &state) {
+  setUpShared(state);
+  for (auto _ : state) {
+    auto snapshot = shared_manager->getSnapshot();
+    benchmark::DoNotOptimize(snapshot.get());
+  }
+  state.SetItemsProcessed(state.iterations());
+  tearDownShared(state);
+}
+BENCHMARK(BM_LocalGetSnapshot)
+    ->RangeMultiplier(16)
+    ->Range(256, 65536)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// The first read after a mutation, which builds the next snapshot
+static void BM_LocalSnapshotRebuild(benchmark::State &state) {
+  auto manager = makeManager(static_cast<size_t>(state.range(0)));
+  auto name = resourceName(0);
+  DiscardedStderr quiet;
+  for (auto _ : state) {
+    state.PauseTiming();
+    if (!manager->removeResource(name)) {
+      manager->addResource(name, shared_file.string());
+    }
+    state.ResumeTiming();
+    auto snapshot = manager->getSnapshot();
+    benchmark::DoNotOptimize(snapshot.get());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::filesystem::remove(shared_file);
+}
+BENCHMARK(BM_LocalSnapshotRebuild)->RangeMultiplier(16)->Range(256, 65536);
+
+static void BM_LocalGetResourceInfo(benchmark::State &state) {
+  setUpShared(state);
+  auto resource_count = static_cast<size_t>(state.range(0));
+  std::vector<std::string> names;
+  for (size_t i = 0; i < resource_count; ++i) {
+    names.push_back(resourceName(i));
+  }
+  size_t i = static_cast<size_t>(state.thread_index()) * 7919;
+  for (auto _ : state) {
+    auto info = shared_manager->getResourceInfo(names[i++ % names.size()]);
+    benchmark::DoNotOptimize(info);
+  }
+  state.SetItemsProcessed(state.iterations());
+  tearDownShared(state);
+}
+BENCHMARK(BM_LocalGetResourceInfo)
+    ->RangeMultiplier(16)
+    ->Range(256, 65536)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
@@ -0,0 +1,74 @@
+#include "discarded_stderr.hpp"
+#include "p2p-resource-sync/logger.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace {
+// Owned by thread 0; the writer drains into /dev/null
+std::unique_ptr<DiscardedStderr> quiet;
+
+void discardLog(const benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    quiet = std::make_unique<DiscardedStderr>();
+  }
+}
+
+void restoreLog(const benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    // Includes writing out whatever is still queued
+    quiet.reset();
+  }
+}
+} // namespace
+
+// Cost to the caller of an enabled message, formatting included
+static void BM_LoggerLog(benchmark::State &state) {
+  discardLog(state);
+  std::string host = "10.0.0." + std::to_string(state.thread_index());
+  uint64_t sent = 0;
+  for (auto _ : state) {
+    p2p::Logger::log<p2p::LogLevel::INFO>("Sent {} bytes to {}", sent++,
+                                          host);
+  }
+  state.SetItemsProcessed(state.iterations());
+  restoreLog(state);
+}
+BENCHMARK(BM_LoggerLog)->ThreadRange(1, 8)->UseRealTime();
+
+// A message already formatted by the caller
+static void BM_LoggerLogPrebuilt(benchmark::State &state) {
+  discardLog(state);
+  for (auto _ : state) {
+    p2p::Logger::log(p2p::LogLevel::INFO, "Download request sent");
+  }
+  state.SetItemsProcessed(state.iterations());
+  restoreLog(state);
+}
+BENCHMARK(BM_LoggerLogPrebuilt)->ThreadRange(1, 8)->UseRealTime();
+
+// Should be free unless TRACE is compiled in
+static void BM_LoggerLogBelowMinimum(benchmark::State &state) {
+  discardLog(state);
+  uint64_t received = 0;
+  for (auto _ : state) {
+    p2p::Logger::log<p2p::LogLevel::TRACE>("Successfully received {} bytes",
+                                           received++);
+  }
+  benchmark::DoNotOptimize(received);
+  state.SetItemsProcessed(state.iterations());
+  restoreLog(state);
+}
+BENCHMARK(BM_LoggerLogBelowMinimum);
+
+static void BM_LoggerFormat(benchmark::State &state) {
+  uint64_t offset = 0;
+  for (auto _ : state) {
+    auto message = p2p::Logger::format(
+        "Retrying download (attempt {}/{}) from offset {}", 2, 5, offset++);
+    benchmark::DoNotOptimize(message.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LoggerFormat);
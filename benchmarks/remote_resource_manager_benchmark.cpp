@@ -0,0 +1,159 @@
+#include "p2p-resource-sync/remote_resource_manager.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr size_t NODE_COUNT = 16;
+
+struct sockaddr_in nodeAddress(size_t node) {
+  struct sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(8000);
+  address.sin_addr.s_addr = htonl(0x0A000001 + static_cast<uint32_t>(node));
+  return address;
+}
+
+uint64_t now() {
+  return std::chrono::system_clock::now().time_since_epoch().count();
+}
+
+std::string resourceName(size_t i) {
+  return "shared/file_" + std::to_string(i) + ".bin";
+}
+
+// Node n announces every resource i with i % NODE_COUNT == n
+std::vector<p2p::Resource> nodeCatalog(size_t node, size_t catalog_size) {
+  std::vector<p2p::Resource> resources;
+  for (size_t i = node; i < catalog_size; i += NODE_COUNT) {
+    resources.push_back(p2p::Resource{resourceName(i), i * 4096});
+  }
+  return resources;
+}
+
+std::unique_ptr<p2p::RemoteResourceManager> makeManager(size_t catalog_size) {
+  auto manager =
+      std::make_unique<p2p::RemoteResourceManager>(std::chrono::seconds(60));
+  for (size_t node = 0; node < NODE_COUNT; ++node) {
+    manager->addOrUpdateNodeResources(nodeAddress(node),
+                                      nodeCatalog(node, catalog_size), now());
+  }
+  return manager;
+}
+
+// Shared by the threads of one run; set up and torn down by thread 0
+std::unique_ptr<p2p::RemoteResourceManager> shared_manager;
+std::vector<std::string> shared_names;
+std::atomic<uint64_t> shared_writes{0};
+
+void setUpShared(const benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    auto catalog_size = static_cast<size_t>(state.range(0));
+    shared_manager = makeManager(catalog_size);
+    shared_names.clear();
+    for (size_t i = 0; i < catalog_size; ++i) {
+      shared_names.push_back(resourceName(i));
+    }
+  }
+}
+
+void tearDownShared(const benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    shared_manager.reset();
+  }
+}
+} // namespace
+
+static void BM_RemoteFindNodesWithResource(benchmark::State &state) {
+  setUpShared(state);
+  size_t i = static_cast<size_t>(state.thread_index()) * 7919;
+  for (auto _ : state) {
+    auto nodes = shared_manager->findNodesWithResource(
+        shared_names[i++ % shared_names.size()]);
+    benchmark::DoNotOptimize(nodes.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  tearDownShared(state);
+}
+BENCHMARK(BM_RemoteFindNodesWithResource)
+    ->RangeMultiplier(16)
+    ->Range(256, 65536)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+static void BM_RemoteFindResourceHolders(benchmark::State &state) {
+  setUpShared(state);
+  size_t i = static_cast<size_t>(state.thread_index()) * 7919;
+  for (auto _ : state) {
+    auto holders = shared_manager->findResourceHolders(
+        shared_names[i++ % shared_names.size()]);
+    benchmark::DoNotOptimize(holders.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  tearDownShared(state);
+}
+BENCHMARK(BM_RemoteFindResourceHolders)
+    ->RangeMultiplier(16)
+    ->Range(256, 65536)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// Replaces a whole node catalog, as on an announcement with a new digest
+static void BM_RemoteUpdateNode(benchmark::State &state) {
+  setUpShared(state);
+  auto catalog_size = static_cast<size_t>(state.range(0));
+  size_t node = static_cast<size_t>(state.thread_index()) % NODE_COUNT;
+  auto catalog = nodeCatalog(node, catalog_size);
+  for (auto _ : state) {
+    shared_manager->addOrUpdateNodeResources(nodeAddress(node), catalog,
+                                             now());
+  }
+  state.SetItemsProcessed(state.iterations());
+  tearDownShared(state);
+}
+BENCHMARK(BM_RemoteUpdateNode)
+    ->RangeMultiplier(16)
+    ->Range(256, 65536)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// Lookups while a background writer keeps replacing a node's catalog
+static void BM_RemoteFindUnderWrites(benchmark::State &state) {
+  setUpShared(state);
+  std::jthread writer;
+  if (state.thread_index() == 0) {
+    auto catalog = nodeCatalog(0, static_cast<size_t>(state.range(0)));
+    writer = std::jthread([catalog](std::stop_token stop) {
+      while (!stop.stop_requested()) {
+        shared_manager->addOrUpdateNodeResources(nodeAddress(0), catalog,
+                                                 now());
+        shared_writes.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  size_t i = static_cast<size_t>(state.thread_index()) * 7919;
+  for (auto _ : state) {
+    auto nodes = shared_manager->findNodesWithResource(
+        shared_names[i++ % shared_names.size()]);
+    benchmark::DoNotOptimize(nodes.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    writer = {};
+    state.counters["writes"] =
+        benchmark::Counter(static_cast<double>(shared_writes.exchange(0)),
+                           benchmark::Counter::kIsRate);
+  }
+  tearDownShared(state);
+}
+BENCHMARK(BM_RemoteFindUnderWrites)
+    ->RangeMultiplier(16)
+    ->Range(256, 65536)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
@@ -1,12 +1,17 @@
 #pragma once
+#include "announcement_transport.hpp"
 #include "local_resource_manager.hpp"
 #include "remote_resource_manager.hpp"
 #include "constants.hpp"
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <netinet/in.h>
+#include <optional>
+#include <random>
 #include <vector>
 
 namespace p2p {
@@ -16,9 +21,26 @@ typedef struct {
   uint64_t timestamp;
   uint32_t senderId;
   uint32_t resourceCount;
+  // TCP port the sender serves downloads and its catalog on, 0 if unknown
+  uint16_t servicePort;
   std::vector<Resource> resources;
 } AnnounceMessage;
 
+/**
+ * @brief Digest-only announcement used in digest mode
+ *
+ * Shares the AnnounceMessage header layout; resourceCount is set to
+ * protocol::HEARTBEAT_RESOURCE_COUNT and the entries are replaced by the
+ * catalog digest.
+ */
+typedef struct {
+  uint32_t datagramLength;
+  uint64_t timestamp;
+  uint32_t senderId;
+  uint16_t servicePort;
+  uint64_t catalogDigest;
+} HeartbeatMessage;
+
 class AnnouncementBroadcaster {
 public:
   AnnouncementBroadcaster(
@@ -34,20 +56,90 @@ public:
   void run();
   void stop();
 
+  /**
+   * @brief Scales the periodic interval with the number of known peers
+   *
+   * The interval never drops below the configured broadcast interval, but
+   * grows by PER_PEER_INTERVAL for every node tracked by the given manager,
+   * up to MAX_BROADCAST_INTERVAL.
+   * Must be called before run().
+   *
+   * @param remote_manager Manager whose node count is observed
+   */
+  void setPeerCountSource(std::shared_ptr<RemoteResourceManager> remote_manager);
+
+  /**
+   * @brief Replaces the default broadcast transport
+   *
+   * Must be called before run().
+   *
+   * @param transport Transport used to deliver announcements
+   * @throws std::runtime_error if the transport cannot configure the socket
+   */
+  void setTransport(std::shared_ptr<AnnouncementTransport> transport);
+
+  /**
+   * @brief Sets the port announced as this node's service port
+   *
+   * Every announcement carries it, and receivers store this node under its
+   * IP and that port, the address other sources such as gossip know it by.
+   * Until set, receivers store it under its UDP address. Must be called
+   * before run().
+   *
+   * @param service_port Port of this node's TcpServer
+   */
+  void setServicePort(uint16_t service_port);
+
+  /**
+   * @brief Sends digest-only heartbeats instead of full catalogs
+   *
+   * Receivers that see an unknown digest fetch the catalog from the
+   * TcpServer on the service port, so setServicePort() must be called as
+   * well. Must be called before run().
+   */
+  void enableDigestMode();
+
 private:
-  void initializeSocket_(uint16_t broadcast_port);
+  void initializeSocket_();
+
+  AnnounceMessage createAnnounceMessage_(const LocalCatalog &catalog) const;
+
+  HeartbeatMessage
+  createHeartbeatMessage_(const AnnounceMessage &announcement) const;
+
+  static std::vector<uint8_t> serializeAnnounceMessage_(AnnounceMessage &message);
 
-  AnnounceMessage createAnnounceMessage_() const;
+  static std::vector<uint8_t>
+  serializeHeartbeatMessage_(HeartbeatMessage &message);
 
-  void broadcastAnnouncement_() const;
+  void broadcastAnnouncement_(bool announce_empty);
+
+  std::chrono::milliseconds nextBroadcastDelay_();
+
+  void onCatalogChange_();
 
   std::shared_ptr<LocalResourceManager> resource_manager_;
+  std::shared_ptr<RemoteResourceManager> peer_count_source_;
   uint32_t node_id_;
   uint16_t port_;
   std::chrono::seconds broadcast_interval_;
   int socket_;
-  struct sockaddr_in broadcast_address_;
+  std::shared_ptr<AnnouncementTransport> transport_;
+  bool digest_mode_{false};
+  uint16_t service_port_{0};
   std::atomic<bool> running_{false};
+
+  // Serialized for the catalog version it was built from; broadcasts only
+  // patch in the timestamp
+  std::vector<uint8_t> datagram_;
+  std::optional<uint64_t> datagram_version_;
+  uint32_t datagram_resource_count_{0};
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  bool catalog_changed_{false};
+  size_t change_listener_id_;
+  std::mt19937_64 random_engine_;
 };
 
 } // namespace p2p
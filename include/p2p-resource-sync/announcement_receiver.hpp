@@ -1,12 +1,18 @@
 #pragma once
 
 #include "announcement_broadcaster.hpp"
+#include "catalog_fetcher.hpp"
 #include "remote_resource_manager.hpp"
 #include "constants.hpp"
 #include <atomic>
 #include <cstdint>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <netinet/in.h>
+#include <set>
+#include <string>
+#include <vector>
 
 namespace p2p {
 
@@ -24,6 +30,20 @@ public:
   void run();
   void stop();
 
+  /**
+   * @brief Subscribes the receiving socket to a multicast group
+   *
+   * Required to receive announcements sent with MulticastTransport. May be
+   * called for several groups.
+   *
+   * @param group Multicast group address
+   * @param interface_address Local interface to join on, INADDR_ANY lets the
+   * kernel choose
+   * @throws std::runtime_error if the group cannot be joined
+   */
+  void joinMulticastGroup(const std::string &group,
+                          const std::string &interface_address = "0.0.0.0");
+
 private:
   void initializeSocket_(int socket_timeout_ms);
 
@@ -32,16 +52,58 @@ private:
   void processAnnouncement_(const std::vector<uint8_t> &buffer, size_t size,
                             const struct sockaddr_in &sender_addr);
 
-  AnnounceMessage parseAnnounceMessage_(const std::vector<uint8_t> &buffer,
-                                        size_t size);
+  /**
+   * @brief Parses and validates only the fixed announcement header
+   * @return Message without resources
+   */
+  AnnounceMessage parseAnnounceHeader_(const std::vector<uint8_t> &buffer,
+                                       size_t size);
+
+  static bool isHeartbeat_(const std::vector<uint8_t> &buffer, size_t size);
+
+  HeartbeatMessage parseHeartbeatMessage_(const std::vector<uint8_t> &buffer,
+                                          size_t size);
+
+  void processHeartbeat_(const HeartbeatMessage &message,
+                         const struct sockaddr_in &sender_addr);
+
+  /**
+   * @brief Address a sender is stored under, given the port it serves on
+   *
+   * Its IP and service port, the address other sources such as gossip know
+   * it by, so that a peer seen through several of them is a single node.
+   * Senders that announce no service port keep their UDP address.
+   */
+  static struct sockaddr_in nodeAddress_(const struct sockaddr_in &sender_addr,
+                                         uint16_t service_port);
+
+  /**
+   * @brief Fetches a node's catalog in the background
+   *
+   * At most one fetch per node is in flight; heartbeats arriving meanwhile
+   * are ignored until the catalog is stored.
+   */
+  void scheduleCatalogFetch_(const HeartbeatMessage &message,
+                             const struct sockaddr_in &node_addr);
 
   std::shared_ptr<RemoteResourceManager> resource_manager_;
   uint32_t node_id_;
   uint16_t port_;
   int socket_;
   std::atomic<bool> running_{false};
+
+  CatalogFetcher catalog_fetcher_;
+  std::mutex fetch_mutex_;
+  std::set<std::pair<in_addr_t, in_port_t>> fetches_in_flight_;
+  std::vector<std::future<void>> pending_fetches_;
   static constexpr size_t MAX_DATAGRAM_SIZE =
       constants::announcement_receiver::MAX_DATAGRAM_SIZE;
+  // datagramLength, timestamp, senderId
+  static constexpr size_t RESOURCE_COUNT_OFFSET =
+      sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+  // Followed by resourceCount and servicePort
+  static constexpr size_t ANNOUNCE_HEADER_SIZE =
+      RESOURCE_COUNT_OFFSET + sizeof(uint32_t) + sizeof(uint16_t);
 };
 
 } // namespace p2p
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "constants.hpp"
+#include "remote_resource_manager.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Strategy used by AnnouncementBroadcaster to deliver datagrams
+ *
+ * The broadcaster owns the UDP socket; a transport only configures it and
+ * decides where each announcement is sent.
+ */
+class AnnouncementTransport {
+public:
+  virtual ~AnnouncementTransport() = default;
+
+  /**
+   * @brief Applies transport specific socket options
+   * @param socket Bound UDP socket of the broadcaster
+   * @throws std::runtime_error if an option cannot be set
+   */
+  virtual void configureSocket(int socket) = 0;
+
+  /**
+   * @brief Sends a serialized announcement
+   * @param socket Socket previously passed to configureSocket
+   * @param datagram Serialized announcement
+   * @throws std::runtime_error if the datagram could not be sent
+   */
+  virtual void send(int socket, const std::vector<uint8_t> &datagram) = 0;
+};
+
+/**
+ * @brief Sends announcements to the limited broadcast address
+ *
+ * Reaches every host on the local L2 segment. This is the default transport.
+ */
+class BroadcastTransport : public AnnouncementTransport {
+public:
+  explicit BroadcastTransport(uint16_t port);
+
+  void configureSocket(int socket) override;
+  void send(int socket, const std::vector<uint8_t> &datagram) override;
+
+private:
+  struct sockaddr_in broadcast_address_;
+};
+
+/**
+ * @brief Sends announcements to an IP multicast group
+ *
+ * Only hosts that joined the group (see
+ * AnnouncementReceiver::joinMulticastGroup) receive the datagrams. A TTL
+ * above 1 lets announcements cross multicast-enabled routers.
+ */
+class MulticastTransport : public AnnouncementTransport {
+public:
+  /**
+   * @param group Multicast group address, e.g. 239.255.77.77
+   * @param port Port receivers listen on
+   * @param ttl Number of router hops announcements may cross
+   * @param interface_address Local interface to send from, INADDR_ANY lets
+   * the kernel choose
+   */
+  MulticastTransport(
+      const std::string &group, uint16_t port,
+      int ttl = constants::announcement_transport::DEFAULT_MULTICAST_TTL,
+      const std::string &interface_address = "0.0.0.0");
+
+  void configureSocket(int socket) override;
+  void send(int socket, const std::vector<uint8_t> &datagram) override;
+
+private:
+  struct sockaddr_in group_address_;
+  struct in_addr interface_address_;
+  int ttl_;
+};
+
+/**
+ * @brief Sends a copy of each announcement to every known peer
+ *
+ * Peers come from a static list and, optionally, from the nodes currently
+ * tracked by a RemoteResourceManager. Works across routed subnets without
+ * any multicast support in the network.
+ */
+class UnicastTransport : public AnnouncementTransport {
+public:
+  /**
+   * @param port Port the peers' receivers listen on
+   * @param peers Statically configured peer addresses (port is ignored)
+   */
+  explicit UnicastTransport(uint16_t port,
+                            const std::vector<struct in_addr> &peers = {});
+
+  void addPeer(const struct in_addr &peer);
+
+  /**
+   * @brief Also sends to every node the given manager has heard from
+   * @param remote_manager Manager whose node addresses are used
+   */
+  void learnPeersFrom(std::shared_ptr<RemoteResourceManager> remote_manager);
+
+  void configureSocket(int socket) override;
+  void send(int socket, const std::vector<uint8_t> &datagram) override;
+
+private:
+  std::vector<struct in_addr> collectPeers_() const;
+
+  const uint16_t port_;
+  mutable std::mutex mutex_;
+  std::vector<struct in_addr> peers_;
+  std::shared_ptr<RemoteResourceManager> learned_peers_source_;
+};
+
+} // namespace p2p
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "local_resource_manager.hpp"
+#include "remote_resource_manager.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Wire encoding of resource catalogs
+ *
+ * A catalog is a sequence of entries, each encoded as
+ * nameLength (uint32), name bytes and size (uint64). The same encoding is
+ * used by full announcements and by the TCP catalog endpoint, so the digest
+ * of a catalog is identical no matter how it was obtained.
+ */
+class CatalogCodec {
+public:
+  /**
+   * @brief Computes a 64-bit FNV-1a digest of encoded entries
+   */
+  static uint64_t digest(const uint8_t *data, size_t size);
+
+  /**
+   * @brief Converts the local catalog into announced resources
+   *
+   * Entries keep the name order of the map, which makes the encoding and
+   * therefore the digest deterministic.
+   */
+  static std::vector<Resource>
+  fromLocalResources(const std::map<std::string, ResourceInfo> &resources);
+
+  static std::vector<Resource> fromLocalResources(const LocalCatalog &catalog);
+
+  /**
+   * @brief Converts the latest snapshot of a manager's catalog
+   */
+  static std::vector<Resource>
+  fromLocalResources(const LocalResourceManager &manager);
+
+  static void appendEntry(std::vector<uint8_t> &buffer,
+                          const Resource &resource);
+
+  static std::vector<uint8_t>
+  serializeEntries(const std::vector<Resource> &resources);
+
+  /**
+   * @brief Decodes exactly count entries
+   * @throws std::runtime_error if the entries do not fit in size bytes
+   */
+  static std::vector<Resource> parseEntries(const uint8_t *data, size_t size,
+                                            uint32_t count);
+};
+
+} // namespace p2p
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "constants.hpp"
+#include "remote_resource_manager.hpp"
+#include <cstdint>
+#include <netinet/in.h>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Catalog received from a node's TCP catalog endpoint
+ */
+struct FetchedCatalog {
+  uint64_t digest;
+  std::vector<Resource> resources;
+};
+
+/**
+ * @brief Client for the TcpServer catalog endpoint
+ *
+ * Used in digest announcement mode to pull a node's full catalog once its
+ * heartbeat advertises a digest the receiver does not know yet.
+ */
+class CatalogFetcher {
+public:
+  explicit CatalogFetcher(
+      uint32_t socket_timeout_ms =
+          constants::catalog_fetcher::DEFAULT_SOCKET_TIMEOUT_MS);
+
+  CatalogFetcher(const CatalogFetcher &) = delete;
+  CatalogFetcher &operator=(const CatalogFetcher &) = delete;
+
+  /**
+   * @brief Downloads the full catalog of a node
+   * @param host Address of the node
+   * @param port Port of the node's TcpServer
+   * @return Catalog and the digest computed by the serving node
+   * @throws std::runtime_error on connection, protocol or validation errors
+   */
+  FetchedCatalog fetch(const struct in_addr &host, uint16_t port) const;
+
+private:
+  int connect_(const struct in_addr &host, uint16_t port) const;
+  void receiveExactly_(int sock, void *buffer, size_t length) const;
+
+  const uint32_t socket_timeout_ms_;
+};
+
+} // namespace p2p
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "remote_resource_manager.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <netinet/in.h>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Memory-mapped file holding a saved remote catalog
+ *
+ * The file is a header followed by fixed-size node records sorted by
+ * address, a name table, fixed-size entry records and the name bytes, in
+ * decreasing order of alignment so every record is read aligned. Every
+ * distinct name is stored once. Opening the file only maps and validates it;
+ * records are read in place, and findNode() binary searches the node table.
+ *
+ * Integers are stored in host byte order, so a file is only meant to be read
+ * back on the machine that wrote it.
+ */
+class CatalogSnapshotFile {
+public:
+#pragma pack(push, 4)
+  struct Entry {
+    uint32_t nameId;
+    uint64_t size;
+  };
+#pragma pack(pop)
+
+  struct Node {
+    struct sockaddr_in address;
+    std::chrono::system_clock::time_point lastSeen;
+    std::optional<uint64_t> catalogDigest;
+    std::span<const Entry> entries;
+  };
+
+  /**
+   * @brief A node to be saved; the catalog must outlive the write
+   */
+  struct NodeToSave {
+    struct sockaddr_in address;
+    std::chrono::system_clock::time_point lastSeen;
+    std::optional<uint64_t> catalogDigest;
+    const CompactCatalog *catalog;
+  };
+
+  /**
+   * @brief Maps and validates a snapshot file
+   * @throws std::runtime_error if the file cannot be read or is malformed
+   */
+  explicit CatalogSnapshotFile(const std::filesystem::path &path);
+  ~CatalogSnapshotFile();
+
+  CatalogSnapshotFile(const CatalogSnapshotFile &) = delete;
+  CatalogSnapshotFile &operator=(const CatalogSnapshotFile &) = delete;
+
+  /**
+   * @brief Writes a snapshot, replacing any previous file atomically
+   * @param nodes Nodes to save, in any order
+   */
+  static void write(const std::filesystem::path &path,
+                    std::vector<NodeToSave> nodes,
+                    std::chrono::system_clock::time_point saved_at);
+
+  std::chrono::system_clock::time_point savedAt() const;
+  size_t nodeCount() const;
+  Node node(size_t position) const;
+  std::optional<Node> findNode(const struct sockaddr_in &address) const;
+  std::string_view name(uint32_t name_id) const;
+
+private:
+  struct Header;
+  struct NodeRecord;
+  struct NameRecord;
+
+  void validate_() const;
+  const Header &header_() const;
+  const NodeRecord *nodeRecords_() const;
+  const NameRecord *nameRecords_() const;
+  const Entry *entryRecords_() const;
+  const char *nameBytes_() const;
+
+  const uint8_t *data_{nullptr};
+  size_t size_{0};
+};
+
+} // namespace p2p
@@ -7,29 +7,156 @@ namespace constants {
 
 namespace announcement_broadcaster {
 static constexpr std::chrono::seconds DEFAULT_BROADCAST_INTERVAL{10};
+// Upper bound for the peer-scaled interval, must stay below node expiry
+static constexpr std::chrono::seconds MAX_BROADCAST_INTERVAL{30};
+static constexpr std::chrono::milliseconds CHANGE_DEBOUNCE_INTERVAL{50};
+// Periodic refreshes are spread uniformly over [1 - f, 1 + f] * interval
+static constexpr double INTERVAL_JITTER_FACTOR = 0.5;
+// Lower bound on interval per known peer, keeps aggregate traffic bounded
+static constexpr std::chrono::milliseconds PER_PEER_INTERVAL{100};
 
 namespace socket {
 static constexpr int BROADCAST_ENABLE = 1;
 }
 } // namespace announcement_broadcaster
+namespace announcement_transport {
+static constexpr const char *DEFAULT_MULTICAST_GROUP = "239.255.77.77";
+static constexpr int DEFAULT_MULTICAST_TTL = 1;
+} // namespace announcement_transport
 namespace announcement_receiver {
 static constexpr size_t MAX_DATAGRAM_SIZE = 65507;
 static constexpr int DEFAULT_SOCKET_TIMEOUT_MS = 1000;
 } // namespace announcement_receiver
 
+namespace remote_resource_manager {
+// Shards of the name index; a snapshot copies only the shards it changes
+static constexpr size_t INDEX_SHARDS = 64;
+static constexpr size_t DEFAULT_SEARCH_LIMIT = 20;
+static constexpr std::chrono::seconds SNAPSHOT_INTERVAL{30};
+// Older snapshots are ignored on startup
+static constexpr std::chrono::seconds MAX_SNAPSHOT_AGE{3600};
+} // namespace remote_resource_manager
+
+namespace peer_stats {
+// Weight of the newest sample in the moving averages
+static constexpr double EWMA_WEIGHT = 0.3;
+// Peers failing at least this often are ranked after healthy ones
+static constexpr double UNHEALTHY_FAILURE_RATE = 0.5;
+// Probability of trying another healthy peer than the best one
+static constexpr double EXPLORATION_RATE = 0.1;
+// Floor of the success probability expected costs are divided by
+static constexpr double MIN_SUCCESS_PROBABILITY = 0.05;
+} // namespace peer_stats
+
+namespace catalog_snapshot {
+static constexpr uint32_t FILE_MAGIC = 0x53435350;
+static constexpr uint32_t FORMAT_VERSION = 2;
+} // namespace catalog_snapshot
+
+namespace name_pool {
+// Interned names are stored in chunks that never move, allowing up to
+// CHUNK_SIZE * MAX_CHUNKS distinct names
+static constexpr size_t CHUNK_SIZE = 1024;
+static constexpr size_t MAX_CHUNKS = 16384;
+} // namespace name_pool
+
+namespace name_index {
+// Share of trigrams a name must have in common with a query to be reported
+// as a likely misspelling of it
+static constexpr double FUZZY_MIN_SIMILARITY = 0.5;
+// Bounds the work of very unselective queries such as a single letter
+static constexpr size_t MAX_CANDIDATES = 100000;
+} // namespace name_index
+
 namespace local_resource_manager {
-static constexpr size_t MAX_RESOURCES = 1000;
-static constexpr size_t MAX_RESOURCE_SIZE = 1024 * 1024 * 1024;
+// Files are streamed, so the limit does not bound memory use
+static constexpr uint64_t DEFAULT_MAX_RESOURCE_SIZE = 1ULL << 40;
 static constexpr size_t MAX_RESOURCE_NAME_LENGTH = 256;
 static constexpr size_t MAX_RESOURCE_PATH_LENGTH = 4096;
+// Resources forEachResource visits per snapshot
+static constexpr size_t ITERATION_PAGE_SIZE = 256;
+// addResources() starts another validation thread per this many files
+static constexpr size_t MIN_FILES_PER_VALIDATION_THREAD = 256;
+static constexpr size_t MAX_VALIDATION_THREADS = 8;
 } // namespace local_resource_manager
 
+namespace resource_index {
+static constexpr uint32_t FILE_MAGIC = 0x58444952;
+static constexpr uint32_t FORMAT_VERSION = 1;
+// The log is compacted once it holds this many records per live resource,
+// plus MIN_COMPACTION_RECORDS
+static constexpr size_t COMPACTION_FACTOR = 2;
+static constexpr size_t MIN_COMPACTION_RECORDS = 1024;
+} // namespace resource_index
+
+namespace content_hash {
+// Unit of parallelism; changing it changes every content hash
+static constexpr uint64_t CHUNK_SIZE = 4 * 1024 * 1024;
+static constexpr uint32_t CACHE_FILE_MAGIC = 0x48534843;
+static constexpr uint32_t CACHE_FORMAT_VERSION = 1;
+} // namespace content_hash
+
+namespace directory_watcher {
+// Quiet period after the last event before a burst is applied
+static constexpr std::chrono::milliseconds DEFAULT_COALESCE_WINDOW{100};
+// A burst that never goes quiet is applied once its first event is this many
+// coalescing windows old
+static constexpr int MAX_COALESCE_WINDOWS = 10;
+static constexpr int POLL_INTERVAL_MS = 100;
+static constexpr size_t EVENT_BUFFER_SIZE = 64 * 1024;
+} // namespace directory_watcher
+
 namespace resource_downloader {
 static constexpr uint32_t DEFAULT_SOCKET_TIMEOUT_MS = 60000;
 static constexpr int MAX_RETRIES = 5;
 static constexpr size_t BUFFER_SIZE = 4096;
 } // namespace resource_downloader
 
+namespace catalog_fetcher {
+static constexpr uint32_t DEFAULT_SOCKET_TIMEOUT_MS = 5000;
+static constexpr size_t MAX_CATALOG_SIZE = 64 * 1024 * 1024;
+} // namespace catalog_fetcher
+
+namespace gossip {
+static constexpr std::chrono::milliseconds DEFAULT_PROTOCOL_PERIOD{1000};
+static constexpr std::chrono::milliseconds DEFAULT_PING_TIMEOUT{300};
+static constexpr std::chrono::milliseconds DEFAULT_SUSPICION_TIMEOUT{5000};
+static constexpr std::chrono::seconds DEAD_MEMBER_RETENTION{30};
+static constexpr size_t DEFAULT_INDIRECT_PROBES = 3;
+static constexpr size_t MAX_PIGGYBACK_UPDATES = 8;
+// Updates are piggybacked RETRANSMIT_MULTIPLIER * log2(cluster size) times
+static constexpr size_t RETRANSMIT_MULTIPLIER = 3;
+static constexpr size_t SYNC_INTERVAL_PERIODS = 10;
+static constexpr size_t MAX_SYNC_MEMBERS = 32;
+static constexpr size_t MAX_CONCURRENT_FETCHES = 4;
+static constexpr size_t MAX_DATAGRAM_SIZE = 1400;
+static constexpr uint32_t MESSAGE_MAGIC = 0x47535750;
+} // namespace gossip
+
+namespace dht {
+// Bucket size and replication factor (Kademlia's k)
+static constexpr size_t BUCKET_SIZE = 8;
+// Concurrent requests per lookup round (Kademlia's alpha)
+static constexpr size_t LOOKUP_PARALLELISM = 3;
+static constexpr std::chrono::milliseconds DEFAULT_RPC_TIMEOUT{500};
+static constexpr std::chrono::seconds PROVIDER_TTL{180};
+static constexpr std::chrono::seconds REPUBLISH_INTERVAL{60};
+static constexpr std::chrono::seconds HOLDER_CACHE_TTL{30};
+static constexpr std::chrono::milliseconds MAINTENANCE_INTERVAL{1000};
+static constexpr size_t MAX_CACHED_LOOKUPS = 4096;
+static constexpr size_t MAX_PROVIDERS_PER_RESPONSE = 32;
+static constexpr size_t MAX_DATAGRAM_SIZE = 1400;
+static constexpr int RECEIVE_POLL_INTERVAL_MS = 100;
+static constexpr uint32_t MESSAGE_MAGIC = 0x54484450;
+} // namespace dht
+
+namespace logger {
+// Messages queued for the writer thread; a power of two
+static constexpr size_t QUEUE_CAPACITY = 8192;
+// Messages formatted into one write
+static constexpr size_t MAX_BATCH_SIZE = 512;
+} // namespace logger
+
 namespace tcp_server {
 static constexpr int DEFAULT_PORT = 8080;
 static constexpr int DEFAULT_MAX_CLIENTS = 10;
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "constants.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Hashes file contents on a pool of threads
+ *
+ * Files are split into CHUNK_SIZE chunks hashed independently with XXH64,
+ * and the content hash is the XXH64 of the chunk hashes, seeded with the
+ * file size. Chunks of the same file are hashed by several threads at
+ * once, so a single large file is hashed as fast as the disk reads it, and
+ * the hash does not depend on the number of threads.
+ */
+class ContentHasher {
+public:
+  // nullopt if the file could not be read
+  using Callback = std::function<void(std::optional<uint64_t> hash)>;
+
+  /**
+   * @param thread_count Number of hashing threads; 0 for one per core
+   */
+  explicit ContentHasher(size_t thread_count = 0);
+  /**
+   * @brief Drops the files not hashed yet and waits for the threads
+   */
+  ~ContentHasher();
+
+  ContentHasher(const ContentHasher &) = delete;
+  ContentHasher &operator=(const ContentHasher &) = delete;
+
+  /**
+   * @brief Queues a file for hashing
+   *
+   * on_done runs on a hashing thread, or on the caller's if the file cannot
+   * be opened or is empty. It must not call back into the hasher.
+   */
+  void hashFile(const std::string &path, Callback on_done);
+
+  /**
+   * @brief XXH64 of a buffer
+   */
+  static uint64_t hashBytes(const void *data, size_t length,
+                            uint64_t seed = 0);
+
+private:
+  struct Job;
+  struct Task {
+    std::shared_ptr<Job> job;
+    uint64_t chunk;
+  };
+
+  void work_();
+  static void hashChunk_(Job &job, uint64_t chunk, std::vector<char> &buffer);
+
+  std::mutex mutex_;
+  std::condition_variable tasks_available_;
+  std::deque<Task> tasks_;
+  bool stopping_{false};
+  std::vector<std::jthread> workers_;
+};
+
+} // namespace p2p
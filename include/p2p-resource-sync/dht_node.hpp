@@ -0,0 +1,183 @@
+#pragma once
+
+#include "constants.hpp"
+#include "dht_transport.hpp"
+#include "local_resource_manager.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Replication and timing parameters of the DHT
+ */
+struct DhtConfig {
+  size_t bucketSize = constants::dht::BUCKET_SIZE;
+  size_t lookupParallelism = constants::dht::LOOKUP_PARALLELISM;
+  std::chrono::seconds providerTtl = constants::dht::PROVIDER_TTL;
+  std::chrono::seconds republishInterval = constants::dht::REPUBLISH_INTERVAL;
+  std::chrono::seconds holderCacheTtl = constants::dht::HOLDER_CACHE_TTL;
+};
+
+/**
+ * @brief Kademlia-style DHT locating the holders of resources
+ *
+ * Resource names are hashed into the 64-bit node id space. A holder
+ * publishes a provider record on the bucketSize nodes closest (by XOR
+ * distance) to the hash of each of its resources, and lookups walk the
+ * routing tables towards that hash, querying lookupParallelism nodes per
+ * round. Routing state and lookup traffic are O(log N) per node.
+ *
+ * Provider records expire after providerTtl and are republished by their
+ * holder every republishInterval. Lookup results are cached for
+ * holderCacheTtl.
+ */
+class DhtNode {
+public:
+  /**
+   * @param node_id Position of the node in the id space; should be uniformly
+   * distributed, e.g. a hash
+   * @param transport Channel to other nodes
+   * @param config Protocol parameters
+   */
+  DhtNode(uint64_t node_id, std::shared_ptr<DhtTransport> transport,
+          DhtConfig config = {});
+  ~DhtNode();
+
+  DhtNode(const DhtNode &) = delete;
+  DhtNode &operator=(const DhtNode &) = delete;
+
+  /**
+   * @brief Hashes a resource name into the id space
+   */
+  static uint64_t keyFor(const std::string &resource_name);
+
+  /**
+   * @brief Joins the overlay through already running nodes
+   * @return true if at least one seed answered
+   */
+  bool bootstrap(const std::vector<struct sockaddr_in> &seeds);
+
+  /**
+   * @brief Announces that provider serves resource_name
+   *
+   * The record is republished by refresh() until unpublish() is called.
+   */
+  void publish(const std::string &resource_name, uint64_t size,
+               const struct sockaddr_in &provider);
+
+  void unpublish(const std::string &resource_name);
+
+  /**
+   * @brief Keeps the published set in sync with a LocalResourceManager
+   * @param provider Address of the TcpServer serving the resources;
+   * INADDR_ANY lets storing nodes fill in the address they see
+   */
+  void publishFrom(std::shared_ptr<LocalResourceManager> local_manager,
+                   const struct sockaddr_in &provider);
+
+  /**
+   * @brief Finds the nodes serving resource_name
+   *
+   * Served from the holder cache when possible, otherwise by an iterative
+   * lookup.
+   */
+  std::vector<ProviderRecord> findProviders(const std::string &resource_name);
+
+  /**
+   * @brief Republishes due records and expires stale state
+   *
+   * Called periodically by run(); may be called directly instead.
+   */
+  void refresh();
+
+  void run();
+  void stop();
+
+  size_t getRoutingTableSize() const;
+  size_t getStoredProviderCount() const;
+
+private:
+  struct StoredProvider {
+    ProviderRecord record;
+    std::chrono::steady_clock::time_point expiresAt;
+  };
+
+  struct CachedHolders {
+    std::vector<ProviderRecord> providers;
+    std::chrono::steady_clock::time_point expiresAt;
+  };
+
+  struct PublishedResource {
+    uint64_t size;
+    struct sockaddr_in provider;
+    std::chrono::steady_clock::time_point publishedAt;
+    bool due;
+  };
+
+  struct LookupResult {
+    std::vector<DhtContact> closest;
+    std::vector<ProviderRecord> providers;
+  };
+
+  DhtMessage handleRequest_(const struct sockaddr_in &from,
+                            const DhtMessage &request);
+
+  /**
+   * @brief Iterative lookup of the nodes closest to key
+   *
+   * For FIND_PROVIDERS the lookup stops as soon as providers are found.
+   * Must be called without mutex_ held.
+   */
+  LookupResult lookup_(uint64_t key, DhtMessageType type,
+                       const std::string &resource_name);
+  std::optional<DhtMessage> call_(const DhtContact &contact,
+                                  DhtMessage request);
+  void publishRecord_(const std::string &resource_name,
+                      const PublishedResource &resource);
+  void syncPublished_();
+
+  // Routing table and storage, called with mutex_ held
+  void addContact_(const DhtContact &contact);
+  void removeContact_(uint64_t id);
+  std::vector<DhtContact> closestContacts_(uint64_t key, size_t count) const;
+  size_t bucketIndex_(uint64_t id) const;
+  void storeProviders_(uint64_t key, const std::string &resource_name,
+                       const std::vector<ProviderRecord> &providers);
+  std::vector<ProviderRecord> storedProviders_(uint64_t key,
+                                               const std::string &resource_name);
+
+  const uint64_t node_id_;
+  std::shared_ptr<DhtTransport> transport_;
+  const DhtConfig config_;
+  std::atomic<bool> running_{false};
+
+  mutable std::mutex mutex_;
+  std::array<std::vector<DhtContact>, 64> buckets_;
+  std::unordered_map<uint64_t,
+                     std::map<std::string, std::vector<StoredProvider>>>
+      providers_;
+  std::unordered_map<std::string, CachedHolders> holder_cache_;
+  std::map<std::string, PublishedResource> published_;
+
+  std::shared_ptr<LocalResourceManager> local_manager_;
+  struct sockaddr_in local_provider_;
+  size_t change_listener_id_{0};
+  bool local_changed_{false};
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+};
+
+} // namespace p2p
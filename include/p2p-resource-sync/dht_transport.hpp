@@ -0,0 +1,175 @@
+#pragma once
+
+#include "constants.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Node of the DHT overlay as known to other nodes
+ */
+struct DhtContact {
+  uint64_t id;
+  struct sockaddr_in address;
+};
+
+/**
+ * @brief A node that serves a resource over TCP
+ *
+ * An address of INADDR_ANY stands for "the address the record came from".
+ */
+struct ProviderRecord {
+  struct sockaddr_in address;
+  uint64_t size;
+};
+
+enum class DhtMessageType : uint8_t {
+  PING = 1,
+  FIND_NODE = 2,
+  FIND_PROVIDERS = 3,
+  ADD_PROVIDER = 4,
+  RESPONSE = 5
+};
+
+/**
+ * @brief Request or response exchanged between DHT nodes
+ *
+ * FIND_NODE and FIND_PROVIDERS carry the looked up key; responses carry the
+ * closest contacts the responder knows and, for FIND_PROVIDERS, the provider
+ * records it stores for resourceName. ADD_PROVIDER carries the records to
+ * store under key.
+ */
+struct DhtMessage {
+  DhtMessageType type;
+  uint64_t senderId;
+  uint64_t key;
+  std::string resourceName;
+  std::vector<DhtContact> contacts;
+  std::vector<ProviderRecord> providers;
+};
+
+/**
+ * @brief Request/response channel used by DhtNode
+ */
+class DhtTransport {
+public:
+  using RequestHandler = std::function<DhtMessage(
+      const struct sockaddr_in &from, const DhtMessage &request)>;
+
+  virtual ~DhtTransport() = default;
+
+  /**
+   * @brief Installs the handler answering incoming requests
+   *
+   * Passing nullptr uninstalls it; once this returns the previous handler
+   * is no longer running.
+   */
+  virtual void setRequestHandler(RequestHandler handler) = 0;
+
+  /**
+   * @brief Sends a request and waits for the response
+   * @return Response, or nullopt if the destination did not answer in time
+   */
+  virtual std::optional<DhtMessage> call(const struct sockaddr_in &destination,
+                                         const DhtMessage &request) = 0;
+
+  /**
+   * @brief Address other nodes reach this transport at
+   */
+  virtual struct sockaddr_in localAddress() const = 0;
+};
+
+/**
+ * @brief In-process network of DHT transports for tests and simulations
+ *
+ * Calls are delivered synchronously to the destination's handler. Endpoints
+ * can be taken offline to simulate failures, and every delivered request is
+ * counted.
+ */
+class SimulatedDhtNetwork {
+public:
+  std::shared_ptr<DhtTransport> createTransport(const struct sockaddr_in &address);
+
+  void setOnline(const struct sockaddr_in &address, bool online);
+
+  size_t getMessageCount() const;
+
+private:
+  class Transport;
+
+  struct Endpoint {
+    std::mutex mutex;
+    DhtTransport::RequestHandler handler;
+    bool online = true;
+  };
+
+  std::optional<DhtMessage> deliver_(const struct sockaddr_in &from,
+                                     const struct sockaddr_in &to,
+                                     const DhtMessage &request);
+
+  mutable std::mutex mutex_;
+  std::map<std::pair<uint32_t, uint16_t>, std::shared_ptr<Endpoint>> endpoints_;
+  std::atomic<size_t> message_count_{0};
+};
+
+/**
+ * @brief DHT transport over UDP datagrams
+ *
+ * run() receives datagrams, answers requests and completes pending calls;
+ * call() may be used from any other thread.
+ */
+class UdpDhtTransport : public DhtTransport {
+public:
+  UdpDhtTransport(const std::string &bind_address, uint16_t port,
+                  std::chrono::milliseconds rpc_timeout =
+                      constants::dht::DEFAULT_RPC_TIMEOUT);
+  ~UdpDhtTransport() override;
+
+  UdpDhtTransport(const UdpDhtTransport &) = delete;
+  UdpDhtTransport &operator=(const UdpDhtTransport &) = delete;
+
+  void run();
+  void stop();
+
+  void setRequestHandler(RequestHandler handler) override;
+  std::optional<DhtMessage> call(const struct sockaddr_in &destination,
+                                 const DhtMessage &request) override;
+  struct sockaddr_in localAddress() const override;
+
+  static std::vector<uint8_t> serializeMessage(uint32_t nonce,
+                                               const DhtMessage &message);
+  /**
+   * @throws std::runtime_error on malformed datagrams
+   */
+  static std::pair<uint32_t, DhtMessage> parseMessage(const uint8_t *data,
+                                                      size_t size);
+
+private:
+  void handleDatagram_(const uint8_t *data, size_t size,
+                       const struct sockaddr_in &sender_addr);
+
+  int socket_;
+  struct sockaddr_in local_address_;
+  const std::chrono::milliseconds rpc_timeout_;
+  std::atomic<bool> running_{false};
+
+  std::mutex handler_mutex_;
+  RequestHandler handler_;
+
+  std::mutex calls_mutex_;
+  std::condition_variable calls_cv_;
+  uint32_t next_nonce_{0};
+  std::map<uint32_t, std::optional<DhtMessage>> pending_calls_;
+};
+
+} // namespace p2p
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "constants.hpp"
+#include "local_resource_manager.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Keeps a LocalResourceManager in sync with a shared directory tree
+ *
+ * Every regular file below the root is registered under its path relative
+ * to the root, e.g. "videos/talk.mkv". run() first watches every directory
+ * with inotify and registers the existing files as one batch, then applies
+ * changes incrementally: files are added or updated once written
+ * (IN_CLOSE_WRITE) or moved in, and removed when deleted or moved out;
+ * directories created, moved or deleted are handled as a whole.
+ *
+ * Events are coalesced: a burst of events is collected until the tree has
+ * been quiet for the coalescing window, and each path touched is then
+ * reconciled once against its current state on disk. A tree that never
+ * goes quiet is still reconciled once its oldest pending event is
+ * MAX_COALESCE_WINDOWS windows old. The tree is only
+ * rescanned if the kernel event queue overflows.
+ *
+ * Only resources registered by the watcher are ever removed by it.
+ */
+class DirectoryWatcher {
+public:
+  /**
+   * @throws std::filesystem::filesystem_error if the root does not exist
+   */
+  DirectoryWatcher(
+      std::shared_ptr<LocalResourceManager> resource_manager,
+      const std::filesystem::path &root,
+      std::chrono::milliseconds coalesce_window =
+          constants::directory_watcher::DEFAULT_COALESCE_WINDOW);
+  ~DirectoryWatcher();
+
+  DirectoryWatcher(const DirectoryWatcher &) = delete;
+  DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+  /**
+   * @brief Registers the tree and follows its changes until stop() is called
+   * @throws std::runtime_error if inotify is unavailable
+   */
+  void run();
+  void stop();
+
+  const std::filesystem::path &getRoot() const;
+  size_t getWatchedDirectoryCount() const;
+  size_t getRegisteredResourceCount() const;
+
+private:
+  void watchTree_(const std::filesystem::path &directory,
+                  std::vector<std::filesystem::path> &files);
+  void unwatchTree_(const std::filesystem::path &directory);
+  void registerFiles_(const std::vector<std::filesystem::path> &files);
+  void readEvents_();
+  void flush_();
+  void rescan_();
+  void unregister_(const std::string &resource_name);
+  std::string resourceName_(const std::filesystem::path &file) const;
+
+  std::shared_ptr<LocalResourceManager> resource_manager_;
+  const std::filesystem::path root_;
+  const std::chrono::milliseconds coalesce_window_;
+  std::atomic<bool> running_{false};
+  int inotify_fd_{-1};
+
+  // Owned by the thread in run()
+  std::unordered_map<int, std::filesystem::path> watches_;
+  std::unordered_map<std::string, int> watch_ids_;
+  std::set<std::string> registered_;
+  std::set<std::filesystem::path> changed_files_;
+  std::set<std::filesystem::path> added_directories_;
+  std::set<std::filesystem::path> removed_directories_;
+  bool overflowed_{false};
+
+  std::atomic<size_t> watched_directory_count_{0};
+  std::atomic<size_t> registered_resource_count_{0};
+};
+
+} // namespace p2p
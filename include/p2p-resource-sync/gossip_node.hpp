@@ -0,0 +1,207 @@
+#pragma once
+
+#include "catalog_fetcher.hpp"
+#include "constants.hpp"
+#include "local_resource_manager.hpp"
+#include "remote_resource_manager.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <optional>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace p2p {
+
+enum class MemberState : uint8_t { ALIVE = 0, SUSPECT = 1, DEAD = 2 };
+
+/**
+ * @brief Membership entry of a gossip cluster member
+ */
+struct GossipMember {
+  uint32_t nodeId;
+  struct sockaddr_in gossipAddress;
+  uint16_t servicePort;
+  uint64_t incarnation;
+  MemberState state;
+  uint64_t catalogDigest;
+};
+
+/**
+ * @brief Timing and fan-out parameters of the gossip protocol
+ */
+struct GossipConfig {
+  std::chrono::milliseconds protocolPeriod =
+      constants::gossip::DEFAULT_PROTOCOL_PERIOD;
+  std::chrono::milliseconds pingTimeout = constants::gossip::DEFAULT_PING_TIMEOUT;
+  std::chrono::milliseconds suspicionTimeout =
+      constants::gossip::DEFAULT_SUSPICION_TIMEOUT;
+  size_t indirectProbes = constants::gossip::DEFAULT_INDIRECT_PROBES;
+  size_t maxPiggybackUpdates = constants::gossip::MAX_PIGGYBACK_UPDATES;
+  size_t syncIntervalPeriods = constants::gossip::SYNC_INTERVAL_PERIODS;
+};
+
+/**
+ * @brief SWIM-style membership and catalog dissemination over UDP
+ *
+ * Each protocol period the node probes one member (directly, then through
+ * indirectProbes helpers), suspects members that stay silent and declares
+ * them dead after suspicionTimeout. Membership changes are piggybacked on
+ * probe traffic a logarithmic number of times, and a periodic push-pull sync
+ * with a random member repairs missed updates. Per-node traffic is therefore
+ * bounded by a few small datagrams per period regardless of cluster size.
+ *
+ * Every member advertises the digest of its catalog. When a member's digest
+ * differs from the one stored in the RemoteResourceManager, the catalog is
+ * pulled once from the member's TcpServer. Alive members are kept fresh in
+ * the manager; dead members are removed from it.
+ */
+class GossipNode {
+public:
+  using CatalogFetchFunction =
+      std::function<FetchedCatalog(const struct in_addr &, uint16_t)>;
+
+  /**
+   * @param local_manager Source of this node's catalog digest
+   * @param remote_manager Manager fed with the catalogs of other members
+   * @param node_id Cluster-unique node identifier
+   * @param bind_address Local IPv4 address to bind and advertise
+   * @param gossip_port UDP port used for gossip traffic
+   * @param service_port Port of this node's TcpServer
+   * @param config Protocol parameters
+   */
+  GossipNode(std::shared_ptr<LocalResourceManager> local_manager,
+             std::shared_ptr<RemoteResourceManager> remote_manager,
+             uint32_t node_id, const std::string &bind_address,
+             uint16_t gossip_port, uint16_t service_port,
+             GossipConfig config = {});
+
+  ~GossipNode();
+
+  GossipNode(const GossipNode &) = delete;
+  GossipNode &operator=(const GossipNode &) = delete;
+
+  /**
+   * @brief Contacts seed members to join the cluster
+   * @param seeds Gossip addresses of already running members
+   */
+  void join(const std::vector<struct sockaddr_in> &seeds);
+
+  void run();
+  void stop();
+
+  /**
+   * @brief Replaces the TCP catalog fetch, e.g. with an in-process one
+   */
+  void setCatalogFetchFunction(CatalogFetchFunction fetch);
+
+  std::vector<GossipMember> getMembers() const;
+
+  size_t getAliveMemberCount() const;
+
+private:
+  enum class MessageType : uint8_t { PING = 1, ACK = 2, PING_REQ = 3, SYNC = 4 };
+
+  struct Message {
+    MessageType type;
+    uint32_t sequence;
+    GossipMember sender;
+    std::optional<GossipMember> target;
+    bool replyRequested;
+    std::vector<GossipMember> updates;
+  };
+
+  struct PendingProbe {
+    uint32_t targetId;
+    std::chrono::steady_clock::time_point sentAt;
+    bool indirect;
+  };
+
+  struct RelayedProbe {
+    struct sockaddr_in requester;
+    uint32_t requesterSequence;
+    std::chrono::steady_clock::time_point sentAt;
+  };
+
+  struct MemberRecord {
+    GossipMember member;
+    std::chrono::steady_clock::time_point stateChangedAt;
+  };
+
+  void initializeSocket_(const std::string &bind_address, uint16_t port);
+
+  // Protocol steps, called with mutex_ held
+  void runProtocolPeriod_();
+  void expireProbes_();
+  void probeNextMember_();
+  void sendSync_();
+  void updateSelfDigest_();
+  void feedRemoteManager_();
+
+  void handleDatagram_(const uint8_t *data, size_t size,
+                       const struct sockaddr_in &sender_addr);
+  void handleMessage_(const Message &message,
+                      const struct sockaddr_in &sender_addr);
+
+  /**
+   * @brief Applies a membership update according to SWIM precedence rules
+   * @return true if the update changed local state
+   */
+  bool applyUpdate_(const GossipMember &update);
+  void markMember_(MemberRecord &record, MemberState state);
+  void enqueueUpdate_(uint32_t node_id);
+
+  void sendMessage_(MessageType type, uint32_t sequence,
+                    const struct sockaddr_in &destination,
+                    const std::optional<GossipMember> &target = std::nullopt,
+                    bool reply_requested = false,
+                    std::vector<GossipMember> extra_updates = {});
+  std::vector<GossipMember> takePiggybackUpdates_(size_t limit);
+
+  std::vector<uint8_t> serializeMessage_(const Message &message) const;
+  static std::optional<Message> parseMessage_(const uint8_t *data, size_t size);
+
+  std::vector<uint32_t> randomMembers_(size_t count,
+                                       const std::set<uint32_t> &excluded);
+  size_t retransmitLimit_() const;
+  GossipMember self_() const;
+
+  void scheduleCatalogFetch_(const GossipMember &member);
+
+  std::shared_ptr<LocalResourceManager> local_manager_;
+  std::shared_ptr<RemoteResourceManager> remote_manager_;
+  const uint32_t node_id_;
+  const uint16_t service_port_;
+  const GossipConfig config_;
+  struct sockaddr_in self_address_;
+  int socket_;
+  std::atomic<bool> running_{false};
+
+  mutable std::mutex mutex_;
+  uint64_t incarnation_{0};
+  uint64_t catalog_digest_{0};
+  std::optional<uint64_t> digest_version_;
+  std::map<uint32_t, MemberRecord> members_;
+  std::map<uint32_t, size_t> pending_updates_;
+  std::vector<uint32_t> probe_order_;
+  size_t probe_index_{0};
+  std::map<uint32_t, PendingProbe> pending_probes_;
+  std::map<uint32_t, RelayedProbe> relayed_probes_;
+  uint32_t next_sequence_{0};
+  size_t periods_{0};
+  std::mt19937 random_engine_;
+
+  CatalogFetcher catalog_fetcher_;
+  CatalogFetchFunction fetch_function_;
+  std::set<uint32_t> fetches_in_flight_;
+  std::vector<std::future<void>> pending_fetches_;
+};
+
+} // namespace p2p
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace p2p {
+
+/**
+ * @brief Content hashes of files, valid while their size and modification
+ * time are unchanged
+ *
+ * Thread-safe. The cache is kept in memory and written to a file with
+ * save(), so hashes survive restarts.
+ */
+class HashCache {
+public:
+  HashCache() = default;
+
+  HashCache(const HashCache &) = delete;
+  HashCache &operator=(const HashCache &) = delete;
+
+  /**
+   * @brief Hash of the file if it was stored with the same size and mtime
+   */
+  std::optional<uint64_t> lookup(const std::string &path, uint64_t size,
+                                 int64_t modified) const;
+  void store(const std::string &path, uint64_t size, int64_t modified,
+             uint64_t hash);
+  void erase(const std::string &path);
+  size_t size() const;
+
+  /**
+   * @brief Replaces the cache with the contents of a file saved before
+   * @throws std::runtime_error if the file is unreadable or corrupt
+   */
+  void load(const std::filesystem::path &file);
+  /**
+   * @brief Writes the cache if it changed since the last load or save
+   * @throws std::runtime_error if the file cannot be written
+   */
+  void save(const std::filesystem::path &file);
+
+private:
+  struct Entry {
+    uint64_t size;
+    int64_t modified;
+    uint64_t hash;
+  };
+
+  mutable std::mutex mutex_;
+  // Serialises writers of the cache file
+  std::mutex save_mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  bool dirty_{false};
+};
+
+} // namespace p2p
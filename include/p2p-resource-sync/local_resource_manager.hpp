@@ -1,15 +1,30 @@
 #pragma once
 
+#include "constants.hpp"
+#include "content_hasher.hpp"
+#include "hash_cache.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <ctime>
+#include <filesystem>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <shared_mutex>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
 
 namespace p2p {
 
+class ResourceIndex;
+
 class ResourceError : public std::runtime_error {
 public:
   explicit ResourceError(const std::string &message)
@@ -28,10 +43,62 @@ public:
 struct ResourceInfo {
   std::string name;
   std::string path;
-  std::size_t size;
+  uint64_t size;
   std::time_t lastModified;
+  // Modification time of the file when added, in file clock nanoseconds
+  int64_t fileModified;
+  // nullopt until hashed, or if content hashing is disabled
+  std::optional<uint64_t> contentHash;
+};
+
+/**
+ * @brief One item of a LocalResourceManager::addResources() batch
+ */
+struct NewResource {
+  std::string name;
+  std::string path;
+};
+
+/**
+ * @brief Outcome of one item of a LocalResourceManager::addResources() batch
+ */
+struct ResourceAddResult {
+  // As returned by addResource()
+  bool inserted{false};
+  // Why the resource was rejected; nullopt if it was added
+  std::optional<std::string> error;
+};
+
+/**
+ * @brief One page of the local catalog, in name order
+ */
+struct LocalResourcePage {
+  std::vector<ResourceInfo> resources;
+  // Name of the last resource on the page; nullopt once the catalog is
+  // exhausted
+  std::optional<std::string> nextCursor;
+};
+
+/**
+ * @brief Immutable view of the local catalog as of one version
+ *
+ * Entries are shared with the manager and with other snapshots, so a
+ * snapshot holds one pointer per resource and never copies its strings.
+ */
+struct LocalCatalog {
+  uint64_t version;
+  // In name order
+  std::vector<std::shared_ptr<const ResourceInfo>> resources;
+
+  /**
+   * @brief Finds a resource by name
+   * @return The resource, or nullptr if it is not in the catalog
+   */
+  const ResourceInfo *find(std::string_view name) const;
 };
 
+using LocalCatalogSnapshot = std::shared_ptr<const LocalCatalog>;
+
 /**
  * @brief Class managing local node resources
  *
@@ -40,8 +107,16 @@ struct ResourceInfo {
  */
 class LocalResourceManager {
 public:
-  LocalResourceManager() = default;
-  ~LocalResourceManager() = default;
+  using ChangeListener = std::function<void(uint64_t version)>;
+  using ResourceVisitor = std::function<void(const ResourceInfo &resource)>;
+
+  /**
+   * @param max_resource_size Largest file addResource() accepts, in bytes
+   */
+  explicit LocalResourceManager(
+      uint64_t max_resource_size =
+          constants::local_resource_manager::DEFAULT_MAX_RESOURCE_SIZE);
+  ~LocalResourceManager();
 
   // Delete copy operations
   LocalResourceManager(const LocalResourceManager &) = delete;
@@ -56,6 +131,44 @@ public:
   bool addResource(const std::string &name,
                    const std::string &added_resource_path);
 
+  /**
+   * @brief Adds many resources at once
+   *
+   * The files are checked on several threads without holding the lock, and
+   * all accepted resources are then added under a single lock acquisition,
+   * as one new catalog version. A rejected file does not affect the others.
+   *
+   * @param resources Resources to add; a later item replaces an earlier one
+   * of the same name
+   * @return One result per item, in the same order
+   */
+  std::vector<ResourceAddResult>
+  addResources(const std::vector<NewResource> &resources);
+
+  /**
+   * @brief Hashes the content of every resource, now and when added
+   *
+   * Files are hashed on a pool of thread_count threads, one per core if 0,
+   * and the hash shows up in ResourceInfo::contentHash once done. Hashes are
+   * cached by path, size and modification time, and saved to cache_path if
+   * given, so files unchanged since they were hashed are not read again.
+   * Call before the manager is shared between threads.
+   */
+  void enableContentHashing(const std::filesystem::path &cache_path = {},
+                            size_t thread_count = 0);
+
+  /**
+   * @brief Restores the catalog from an index file and records every
+   * change to it from now on
+   *
+   * Restored resources are trusted at first, so startup does not wait on
+   * the filesystem. A background thread then checks them: resources whose
+   * file is gone are removed, and those whose file changed are added again.
+   * An unreadable index is discarded. Call before the manager is shared
+   * between threads.
+   */
+  void enablePersistence(const std::filesystem::path &index_path);
+
   /**
    * @brief Removes a resource from the manager
    * @param name Name of the resource to remove
@@ -77,6 +190,37 @@ public:
    */
   std::map<std::string, ResourceInfo> getAllResources() const;
 
+  /**
+   * @brief Gets up to limit resources following a cursor, in name order
+   * @param after nextCursor of the previous page, std::nullopt for the first
+   * page
+   * @param limit Maximum number of resources on the page
+   */
+  LocalResourcePage getResourcePage(const std::optional<std::string> &after,
+                                    size_t limit) const;
+
+  /**
+   * @brief Gets the catalog as of the latest mutation
+   *
+   * Snapshots are immutable and shared by every reader. A mutation only
+   * marks the current one stale; the first reader after it builds the next,
+   * so a burst of mutations publishes a single snapshot and other reads take
+   * no lock.
+   */
+  LocalCatalogSnapshot getSnapshot() const;
+
+  /**
+   * @brief Visits every resource in name order
+   *
+   * The catalog is visited in pages, each taken from the latest snapshot,
+   * and the visitor runs without any lock held, so it may call back into the
+   * manager. Resources changed during the iteration may or may not be
+   * visited, but each name is visited at most once.
+   *
+   * @param visitor Called once per resource
+   */
+  void forEachResource(const ResourceVisitor &visitor) const;
+
   /**
    * @brief Gets the file path for a given resource
    * @param name Resource name
@@ -85,9 +229,109 @@ public:
    */
   std::optional<std::string> getResourcePath(const std::string &name) const;
 
+  /**
+   * @brief Checks the stat of a resource's open file against the catalog
+   *
+   * Meant for the serving path, which stats the file it opened anyway, so
+   * detecting a change costs no extra system call. A file that no longer
+   * matches is refreshed with refreshResource().
+   *
+   * @return true if the file matches the catalog entry
+   */
+  bool checkFile(const ResourceInfo &resource, const struct stat &file_stat);
+
+  /**
+   * @brief Rechecks a resource against its file in the background
+   *
+   * A changed file is added again, which updates its size and hash and
+   * bumps the catalog version; a file that is gone is removed. Requests for
+   * a resource already waiting to be refreshed are merged.
+   */
+  void refreshResource(const std::string &name);
+
+  /**
+   * @brief Gets the current catalog version
+   *
+   * The version is incremented on every successful mutation of the catalog.
+   *
+   * @return Current catalog version
+   */
+  uint64_t getVersion() const;
+
+  /**
+   * @brief Registers a callback invoked after every catalog mutation
+   *
+   * Callbacks are invoked outside of the catalog lock with the new version,
+   * so they may safely query the manager. They should return quickly.
+   *
+   * @param listener Callback to invoke
+   * @return Identifier used to unregister the listener
+   */
+  size_t addChangeListener(ChangeListener listener);
+
+  /**
+   * @brief Unregisters a previously added change listener
+   * @param listener_id Identifier returned by addChangeListener
+   */
+  void removeChangeListener(size_t listener_id);
+
 private:
-  mutable std::shared_mutex mutex_;
-  std::map<std::string, p2p::ResourceInfo> resources_;
+  struct ValidatedResource {
+    ResourceInfo info;
+    // Modification time, nullopt if it could not be read
+    std::optional<int64_t> modified;
+  };
+
+  /**
+   * @throws ResourceError if the file cannot be shared
+   */
+  ValidatedResource validate_(const std::string &name,
+                              const std::string &path) const;
+  // Called with mutex_ held; false if the resource is already in the
+  // catalog unchanged
+  bool changes_(const ValidatedResource &resource) const;
+  void notifyChange_();
+  void hashUnhashed_();
+  void hashResource_(const ResourceInfo &resource);
+  // Called with mutex_ held
+  void publish_();
+  LocalCatalogSnapshot currentSnapshot_() const;
+  void persistAdd_(const ResourceInfo &resource);
+  void persistRemove_(const std::string &name);
+  void verifyResources_(std::stop_token stop);
+  void refreshResources_(std::stop_token stop);
+  // Updates the resource from its file; false if the file is unchanged
+  bool refresh_(const ResourceInfo &resource);
+  void saveHashCache_();
+  // Nanoseconds since the file clock's epoch; nullopt if the file is gone
+  static std::optional<int64_t> modificationTime_(const std::string &path);
+
+  const uint64_t max_resource_size_;
+
+  // Serialises mutations; readers go through snapshot_
+  mutable std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<const ResourceInfo>, std::less<>>
+      resources_;
+  std::atomic<uint64_t> version_{0};
+  // Null while stale
+  mutable std::atomic<LocalCatalogSnapshot> snapshot_;
+
+  std::mutex listeners_mutex_;
+  std::map<size_t, ChangeListener> listeners_;
+  size_t next_listener_id_{0};
+
+  HashCache hash_cache_;
+  std::filesystem::path hash_cache_path_;
+  std::atomic<size_t> hashes_pending_{0};
+  std::unique_ptr<ContentHasher> hasher_;
+  std::unique_ptr<ResourceIndex> index_;
+  std::jthread verifier_thread_;
+
+  std::mutex refresh_mutex_;
+  std::condition_variable_any refresh_cv_;
+  std::set<std::string> refresh_queue_;
+  // Started by the first refreshResource()
+  std::jthread refresher_thread_;
 };
 
 /**
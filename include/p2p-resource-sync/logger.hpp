@@ -1,23 +1,138 @@
 #pragma once
 
+#include <charconv>
 #include <chrono>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Lowest level compiled in; set by the build, INFO unless configured
+#ifndef P2P_MIN_LOG_LEVEL
+#define P2P_MIN_LOG_LEVEL INFO
+#endif
 
 namespace p2p {
 
-enum class LogLevel { INFO, ERROR };
+enum class LogLevel { TRACE, DEBUG, INFO, ERROR };
+
+inline constexpr LogLevel MIN_LOG_LEVEL = LogLevel::P2P_MIN_LOG_LEVEL;
+
+/**
+ * @brief What Logger::log() does when the message queue is full
+ */
+enum class LogOverflowPolicy {
+  // Waits for the writer thread to make room
+  BLOCK,
+  // Discards the message; the number discarded is logged once there is room
+  DROP
+};
 
+/**
+ * @brief Process-wide logger writing to stderr
+ *
+ * log() only moves the message into a bounded lock-free queue, so it never
+ * waits on I/O. A background thread, started by the first message, formats
+ * queued messages and writes them in batches with one write per batch.
+ * Messages still queued when the process exits are written first.
+ *
+ * Messages below MIN_LOG_LEVEL are dropped. Logged through log<level>(),
+ * they are not even formatted: the call compiles to nothing, so tracing can
+ * stay in hot paths at no cost in release builds.
+ */
 class Logger {
 public:
   static uint32_t node_id;
   static void setNodeId(uint32_t id) { node_id = id; }
-  static void log(LogLevel level, const std::string &message);
+  static void log(LogLevel level, std::string message);
+
+  /**
+   * @brief Formats and logs a message, if level is compiled in
+   *
+   * The arguments are only formatted when the message is logged, e.g.
+   * log<LogLevel::DEBUG>("Sent {} bytes to {}", size, host).
+   */
+  template <LogLevel level, typename... Args>
+  static void log(std::string_view format, const Args &...args) {
+    if constexpr (level >= MIN_LOG_LEVEL) {
+      log(level, Logger::format(format, args...));
+    }
+  }
+
+  /**
+   * @brief Replaces each {} in format with the next argument
+   *
+   * {{ and }} stand for literal braces. Strings are inserted as they are,
+   * numbers in their shortest form, and anything else through operator<<.
+   */
+  template <typename... Args>
+  static std::string format(std::string_view format, const Args &...args) {
+    std::string output;
+    output.reserve(format.size() + 16 * sizeof...(Args));
+    (appendArgument_(output, format, args), ...);
+    // Placeholders left without an argument are kept
+    while (copyToPlaceholder_(output, format)) {
+      output += "{}";
+    }
+    return output;
+  }
+
+  /**
+   * @brief Sets what log() does when the queue is full; BLOCK by default
+   */
+  static void setOverflowPolicy(LogOverflowPolicy policy);
+
+  /**
+   * @brief Waits until every message logged so far has been written
+   */
+  static void flush();
+
+  /**
+   * @brief Number of messages discarded under the DROP policy
+   */
+  static uint64_t getDroppedCount();
 
 private:
+  class Writer;
+
+  static Writer &writer_();
   static const char *levelToString(LogLevel level);
-  static std::string getCurrentTimestamp();
+  // Copies format up to its next {}, which is consumed; false if there is
+  // none left
+  static bool copyToPlaceholder_(std::string &output, std::string_view &format);
+
+  template <typename T>
+  static void appendArgument_(std::string &output, std::string_view &format,
+                              const T &value) {
+    if (copyToPlaceholder_(output, format)) {
+      appendValue_(output, value);
+    }
+  }
+
+  template <typename T>
+  static void appendValue_(std::string &output, const T &value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      output += value ? "true" : "false";
+    } else if constexpr (std::is_same_v<T, char>) {
+      output += value;
+    } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+      output += std::string_view(value);
+    } else if constexpr (std::is_arithmetic_v<T>) {
+      char buffer[32];
+      auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+      output.append(buffer, static_cast<size_t>(result.ptr - buffer));
+    } else if constexpr (std::is_enum_v<T>) {
+      appendValue_(output, std::to_underlying(value));
+    } else {
+      std::ostringstream stream;
+      stream << value;
+      output += stream.str();
+    }
+  }
 };
 
 } // namespace p2p
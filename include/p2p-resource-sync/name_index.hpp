@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Case-insensitive search over a set of resource names
+ *
+ * Names are kept in a sorted set for prefix queries and in a trigram index
+ * for substring and fuzzy queries. Queries shorter than a trigram fall back
+ * to a vectorised scan. Insertions and removals update both structures
+ * incrementally.
+ */
+class NameIndex {
+public:
+  enum class MatchKind { EXACT, PREFIX, SUBSTRING, FUZZY };
+
+  struct Match {
+    std::string name;
+    MatchKind kind;
+    // Higher is better: exact 3, prefix (2, 3), substring (1, 2) and fuzzy
+    // matches their trigram similarity in (0, 1]
+    double score;
+  };
+
+  NameIndex() = default;
+
+  NameIndex(const NameIndex &) = delete;
+  NameIndex &operator=(const NameIndex &) = delete;
+
+  /**
+   * @return false if the name was already indexed
+   */
+  bool insert(const std::string &name);
+
+  /**
+   * @return false if the name was not indexed
+   */
+  bool erase(const std::string &name);
+
+  size_t size() const;
+
+  /**
+   * @brief Finds the names matching a query, best first
+   *
+   * Exact matches rank first, then prefix and substring matches (favouring
+   * names close in length to the query), then names sharing enough
+   * trigrams with the query to be likely misspellings of it.
+   */
+  std::vector<Match> search(std::string_view query, size_t limit) const;
+
+  /**
+   * @brief Substring test used by the scanning fallback; SSE2 accelerated
+   * where available
+   */
+  static bool containsSubstring(std::string_view haystack,
+                                std::string_view needle);
+
+private:
+  struct Entry {
+    std::string name;
+    std::string folded;
+    size_t trigramCount;
+    bool live;
+  };
+
+  static std::string fold_(std::string_view text);
+  static std::vector<uint32_t> trigrams_(std::string_view folded);
+
+  mutable std::shared_mutex mutex_;
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> free_ids_;
+  std::unordered_map<std::string, uint32_t> ids_;
+  std::set<std::pair<std::string, uint32_t>> sorted_;
+  std::unordered_map<uint32_t, std::unordered_set<uint32_t>> postings_;
+};
+
+} // namespace p2p
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Reference-counted string interning with stable ids
+ *
+ * Every distinct name is stored once, however many catalogs contain it.
+ * Entries live in fixed-size chunks that are never moved, so name() reads
+ * without locking; acquire() and release() serialise on a mutex.
+ *
+ * An id stays valid, and its name unchanged, until the matching release();
+ * ids of released names are reused.
+ */
+class NamePool {
+public:
+  NamePool();
+  ~NamePool();
+
+  NamePool(const NamePool &) = delete;
+  NamePool &operator=(const NamePool &) = delete;
+
+  /**
+   * @brief Interns a name and takes a reference to it
+   * @return Id of the name
+   */
+  uint32_t acquire(std::string_view name);
+
+  /**
+   * @brief Drops a reference taken by acquire()
+   */
+  void release(uint32_t id);
+
+  /**
+   * @brief Name of an id; the caller must hold a reference to it
+   */
+  std::string_view name(uint32_t id) const;
+
+  /**
+   * @brief Number of distinct names currently referenced
+   */
+  size_t size() const;
+
+private:
+  struct Entry {
+    std::string name;
+    uint32_t references;
+  };
+
+  Entry &entry_(uint32_t id) const;
+
+  std::unique_ptr<std::atomic<Entry *>[]> chunks_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string_view, uint32_t> ids_;
+  std::vector<uint32_t> free_ids_;
+  uint32_t next_id_{0};
+};
+
+} // namespace p2p
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "constants.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <netinet/in.h>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Transfer performance observed for one peer
+ *
+ * Throughput, round-trip time and failure rate are exponentially weighted
+ * moving averages, so recent transfers weigh more than old ones.
+ */
+struct PeerStats {
+  // Of the attempts that received data; 0 until one did
+  double throughputBytesPerSecond;
+  // From connecting until the peer answers the request
+  std::chrono::microseconds rtt;
+  // Fraction of attempts that failed, in [0, 1]
+  double failureRate;
+  uint32_t activeTransfers;
+  uint64_t attempts;
+};
+
+/**
+ * @brief Outcome of one attempt to download from a peer
+ */
+struct TransferSample {
+  uint64_t bytes;
+  std::chrono::steady_clock::duration duration;
+  // nullopt if the attempt failed before the peer answered
+  std::optional<std::chrono::steady_clock::duration> rtt;
+  bool succeeded;
+};
+
+/**
+ * @brief Per-peer transfer statistics and the peer ranking built on them
+ *
+ * Peers are ranked by the expected time to fetch a resource from them: the
+ * round-trip time plus the size over the throughput, scaled up by the
+ * failure rate and by the transfers already running against the peer.
+ * Peers never measured rank first so they get measured; peers failing more
+ * often than UNHEALTHY_FAILURE_RATE rank last. With probability
+ * exploration_rate another healthy peer is moved to the front, so estimates
+ * of peers that are not the best do not go stale.
+ */
+class PeerStatsTable {
+public:
+  /**
+   * @brief A peer able to serve a resource
+   */
+  struct Candidate {
+    struct sockaddr_in address;
+    // Announced size of the resource; 0 if unknown
+    uint64_t size;
+    // Ranked after every candidate that is not
+    bool deprioritised;
+  };
+
+  explicit PeerStatsTable(
+      double exploration_rate = constants::peer_stats::EXPLORATION_RATE);
+
+  PeerStatsTable(const PeerStatsTable &) = delete;
+  PeerStatsTable &operator=(const PeerStatsTable &) = delete;
+
+  void transferStarted(const struct sockaddr_in &peer);
+  void recordAttempt(const struct sockaddr_in &peer,
+                     const TransferSample &sample);
+  void transferFinished(const struct sockaddr_in &peer);
+
+  std::optional<PeerStats> get(const struct sockaddr_in &peer) const;
+
+  /**
+   * @brief Drops the statistics of idle peers the predicate rejects
+   */
+  void retain(const std::function<bool(const struct sockaddr_in &)> &keep);
+
+  /**
+   * @brief Orders candidates best first
+   */
+  std::vector<struct sockaddr_in>
+  rank(const std::vector<Candidate> &candidates) const;
+
+  void setExplorationRate(double exploration_rate);
+
+private:
+  static uint64_t key_(const struct sockaddr_in &peer);
+  // Expected seconds to fetch size bytes; 0 for peers never measured
+  double expectedCost_(const PeerStats *stats, uint64_t size) const;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<uint64_t, PeerStats> stats_;
+  double exploration_rate_;
+  mutable std::mt19937_64 random_engine_;
+};
+
+} // namespace p2p
@@ -1,9 +1,13 @@
+#pragma once
 /**
  * @brief Structure representing resource download request
  *
  * Used for sending requests over TCP to download resources from remote nodes.
  * The structure has a variable-length field (resourceName) which must always
  * be placed at the end of the structure.
+ *
+ * A request whose resourceNameLength equals CATALOG_REQUEST_NAME_LENGTH
+ * carries no name and asks for the node's full resource catalog instead.
  */
 #pragma pack(1)
 #include <cstdint>
@@ -14,3 +18,10 @@ struct ResourceRequest {
   char resourceName[];
 };
 #pragma pack()
+
+namespace p2p::protocol {
+// resourceNameLength marking a catalog request
+static constexpr uint32_t CATALOG_REQUEST_NAME_LENGTH = 0xFFFFFFFF;
+// resourceCount marking a digest-only heartbeat announcement
+static constexpr uint32_t HEARTBEAT_RESOURCE_COUNT = 0xFFFFFFFF;
+} // namespace p2p::protocol
@@ -1,11 +1,23 @@
 #pragma once
 
+#include "constants.hpp"
+#include "name_index.hpp"
+#include "name_pool.hpp"
+#include "peer_stats.hpp"
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
-#include <map>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <netinet/in.h>
-#include <shared_mutex>
+#include <optional>
+#include <queue>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -13,18 +25,136 @@ namespace p2p {
 
 typedef struct {
   std::string name;
-  uint32_t size;
+  uint64_t size;
 } Resource;
 
-typedef struct {
-  std::vector<Resource> resources;
-  std::chrono::system_clock::time_point lastAnnouncementTime;
-} RemoteNode;
+/**
+ * @brief A node announcing a resource, with the size it announced
+ */
+struct ResourceHolder {
+  struct sockaddr_in address;
+  uint64_t size;
+};
+
+/**
+ * @brief Immutable catalog of a remote node
+ *
+ * Entries are stored contiguously as (name id, size) pairs, twelve bytes
+ * each, with the names interned in a NamePool shared by all catalogs of a
+ * manager. A name announced by many nodes is therefore stored once. The
+ * catalog holds a reference to each of its names until it is destroyed.
+ */
+class CompactCatalog {
+public:
+#pragma pack(push, 4)
+  struct Entry {
+    uint32_t nameId;
+    uint64_t size;
+
+    bool operator==(const Entry &other) const = default;
+  };
+#pragma pack(pop)
+
+  CompactCatalog(std::shared_ptr<NamePool> pool,
+                 const std::vector<Resource> &resources);
+  ~CompactCatalog();
+
+  CompactCatalog(const CompactCatalog &) = delete;
+  CompactCatalog &operator=(const CompactCatalog &) = delete;
+
+  const std::vector<Entry> &entries() const { return this->entries_; }
+  size_t size() const { return this->entries_.size(); }
 
+  std::string_view name(const Entry &entry) const {
+    return this->pool_->name(entry.nameId);
+  }
+
+  Resource resourceAt(size_t position) const;
+
+private:
+  std::shared_ptr<NamePool> pool_;
+  std::vector<Entry> entries_;
+};
+
+using SharedCatalog = std::shared_ptr<const CompactCatalog>;
+
+/**
+ * @brief A resource name matching a search, with the nodes announcing it
+ */
+struct ResourceMatch {
+  std::string name;
+  NameIndex::MatchKind kind;
+  double score;
+  std::vector<ResourceHolder> holders;
+};
+
+/**
+ * @brief Position in the remote catalog: a node and an offset into its
+ * catalog
+ */
+struct RemoteResourceCursor {
+  struct sockaddr_in node;
+  size_t offset;
+};
+
+/**
+ * @brief One page of the remote catalog, ordered by node
+ */
+struct RemoteResourcePage {
+  std::vector<std::pair<struct sockaddr_in, Resource>> resources;
+  // Start of the next page; nullopt once the catalog is exhausted
+  std::optional<RemoteResourceCursor> nextCursor;
+};
+
+/**
+ * @brief State kept for every remote node
+ *
+ * The catalog is immutable and shared between all nodes announcing an
+ * identical one. The timestamp cell is shared by every snapshot version of
+ * the node, so unchanged announcements refresh it in place without
+ * publishing a new snapshot.
+ *
+ * Nodes restored from a saved snapshot are provisional until they announce
+ * themselves again; they expire one cleanup interval after the restore if
+ * they do not.
+ */
+struct RemoteNode {
+  SharedCatalog resources;
+  std::shared_ptr<std::atomic<std::chrono::system_clock::time_point>>
+      lastAnnouncementTime;
+  std::optional<uint64_t> catalogDigest;
+  bool provisional;
+};
+
+/**
+ * @brief Catalogs announced by remote nodes
+ *
+ * State is published as immutable, versioned snapshots swapped atomically
+ * (read-copy-update). Readers load the current snapshot and never wait for
+ * writers. Writers queue their updates; whichever writer holds the writer
+ * lock applies every queued update to one new snapshot, so a burst of
+ * announcements produces few snapshots. Every write is visible to its caller
+ * once the call returns.
+ *
+ * The name index is split into shards that are copied only when an update
+ * touches them, which keeps the cost of a snapshot proportional to the
+ * change rather than to the total catalog size.
+ *
+ * Node expiry is driven by a deadline-ordered heap holding one entry per
+ * node. Announcements only move the node's timestamp; an entry found to be
+ * outdated when it comes due is re-armed with the node's current deadline.
+ * Expiring nodes therefore costs time proportional to the nodes coming due,
+ * not to the number of known nodes.
+ */
 class RemoteResourceManager {
 public:
-  RemoteResourceManager(std::chrono::seconds interval)
-      : cleanup_interval_(interval) {};
+  using ProviderLookup = std::function<std::vector<struct sockaddr_in>(
+      const std::string &resource_name)>;
+  using ResourceVisitor =
+      std::function<void(const struct sockaddr_in &node_address,
+                         std::string_view resource_name, uint64_t size)>;
+
+  RemoteResourceManager(std::chrono::seconds interval);
   ~RemoteResourceManager() = default;
 
   RemoteResourceManager(const RemoteResourceManager &) = delete;
@@ -32,26 +162,297 @@ public:
 
   std::vector<std::pair<struct sockaddr_in, Resource>> getAllResources() const;
 
-  void addOrUpdateNodeResources(const struct sockaddr_in &node_address,
-                                const std::vector<Resource> &resources,
-                                uint64_t timestamp);
+  /**
+   * @brief Visits every announced resource of one snapshot
+   *
+   * Takes no lock and copies nothing; writers publishing meanwhile are not
+   * blocked and their changes are not seen.
+   */
+  void forEachResource(const ResourceVisitor &visitor) const;
+
+  /**
+   * @brief Gets up to limit announced resources starting at a cursor
+   *
+   * Pages are read from the snapshot current at each call, so catalogs
+   * changing between calls may cause entries of the changed nodes to be
+   * skipped or repeated.
+   *
+   * @param from nextCursor of the previous page, std::nullopt for the first
+   * page
+   */
+  RemoteResourcePage
+  getResourcePage(const std::optional<RemoteResourceCursor> &from,
+                  size_t limit) const;
+
+  /**
+   * @brief Replaces a node's catalog
+   *
+   * When a digest is given, catalogs with the same digest and content are
+   * stored once and shared between nodes.
+   */
+  void addOrUpdateNodeResources(
+      const struct sockaddr_in &node_address, std::vector<Resource> resources,
+      uint64_t timestamp,
+      std::optional<uint64_t> catalog_digest = std::nullopt);
+
+  /**
+   * @brief Refreshes a node's liveness without touching its catalog
+   *
+   * Succeeds only if the node is known and its stored catalog has the given
+   * digest; otherwise the caller has to obtain the full catalog. Only waits
+   * for writers when it confirms a provisional node.
+   *
+   * @return true if the stored catalog is up to date
+   */
+  bool refreshNode(const struct sockaddr_in &node_address,
+                   uint64_t catalog_digest, uint64_t timestamp);
 
   bool hasResource(const struct sockaddr_in &node_address,
                    const std::string &resource_name) const;
 
+  /**
+   * @brief Finds the nodes holding a resource
+   *
+   * Answered from the name index in O(1) on average. Confirmed holders are
+   * listed before provisional ones. Besides the announced
+   * catalogs, consults the provider lookup (e.g. a DHT) when one is set.
+   */
   std::vector<struct sockaddr_in>
   findNodesWithResource(const std::string &resource_name) const;
 
+  /**
+   * @brief Enables lookups of holders that are not in any announced catalog
+   * @param lookup Called without locks held; nullptr disables it
+   */
+  void setProviderLookup(ProviderLookup lookup);
+
+  /**
+   * @brief Lists the nodes announcing a resource together with its size
+   */
+  std::vector<ResourceHolder>
+  findResourceHolders(const std::string &resource_name) const;
+
+  /**
+   * @brief Searches announced resource names by prefix, substring or
+   * approximate spelling, case-insensitively
+   * @return At most limit matches, best first; see NameIndex::search
+   */
+  std::vector<ResourceMatch> searchResources(
+      const std::string &query,
+      size_t limit = constants::remote_resource_manager::DEFAULT_SEARCH_LIMIT)
+      const;
+
+  /**
+   * @brief Forgets a node, e.g. once membership declared it dead
+   */
+  void removeNode(const struct sockaddr_in &node_address);
+
+  size_t getNodeCount() const;
+
+  /**
+   * @brief Nodes able to serve a resource, best first
+   *
+   * Same nodes as findNodesWithResource(), ordered by the transfer
+   * statistics recorded for them; see PeerStatsTable.
+   */
+  std::vector<struct sockaddr_in>
+  rankHolders(const std::string &resource_name) const;
+
+  // Transfer statistics, fed by ResourceDownloader
+  void recordTransferStart(const struct sockaddr_in &node_address);
+  void recordTransferAttempt(const struct sockaddr_in &node_address,
+                             const TransferSample &sample);
+  void recordTransferEnd(const struct sockaddr_in &node_address);
+  std::optional<PeerStats>
+  getPeerStats(const struct sockaddr_in &node_address) const;
+  void setExplorationRate(double exploration_rate);
+
+  /**
+   * @brief Whether a node was restored from a snapshot and has not announced
+   * itself since
+   */
+  bool isProvisional(const struct sockaddr_in &node_address) const;
+
+  /**
+   * @brief Writes the current catalog to a memory-mappable snapshot file
+   */
+  void saveSnapshot(const std::filesystem::path &path) const;
+
+  /**
+   * @brief Restores the nodes of a snapshot file as provisional
+   *
+   * Nodes already known are left untouched, as are nodes last seen more
+   * than MAX_SNAPSHOT_AGE ago.
+   *
+   * @return Number of nodes restored
+   * @throws std::runtime_error if the file cannot be read or is malformed
+   */
+  size_t loadSnapshot(const std::filesystem::path &path);
+
+  /**
+   * @brief Restores the snapshot at path if there is one and makes run()
+   * save it every interval and when stopping
+   *
+   * Must be called before run().
+   */
+  void enablePersistence(
+      std::filesystem::path path,
+      std::chrono::seconds interval =
+          constants::remote_resource_manager::SNAPSHOT_INTERVAL);
+
+  std::vector<struct sockaddr_in> getNodeAddresses() const;
+
+  /**
+   * @brief Removes the nodes whose deadline has passed
+   *
+   * Only inspects the entries of the expiry heap that are due. Called by
+   * run() at each deadline; may be called directly instead.
+   */
   void cleanupStaleNodes();
 
+  /**
+   * @brief Expires stale nodes at their deadlines until stop() is called
+   *
+   * With persistence enabled, also saves the snapshot every interval and
+   * once more when stopping.
+   */
+  void run();
+  void stop();
+
+  /**
+   * @brief Version of the current snapshot, incremented on every publish
+   */
+  uint64_t getSnapshotVersion() const;
+
 private:
   struct SockAddrCompare {
     bool operator()(const struct sockaddr_in &a,
                     const struct sockaddr_in &b) const;
   };
-  mutable std::shared_mutex mutex_;
-  std::map<struct sockaddr_in, RemoteNode, SockAddrCompare> nodes_;
+
+  // Nodes announcing a name, sorted by address
+  using HolderList = std::vector<ResourceHolder>;
+  // Inverted index shard: resource name -> nodes announcing it. Keys view
+  // the interned names, which the catalogs of the same snapshot keep alive.
+  using IndexShard = std::unordered_map<std::string_view, HolderList>;
+
+  struct NodeEntry {
+    struct sockaddr_in address;
+    RemoteNode node;
+  };
+  // Flat array sorted by address: binary searched by readers and copied
+  // with the snapshot in one contiguous block
+  using NodeMap = std::vector<NodeEntry>;
+
+  struct Snapshot {
+    uint64_t version;
+    NodeMap nodes;
+    std::vector<std::shared_ptr<const IndexShard>> index;
+  };
+
+  struct PendingUpdate {
+    enum class Kind { UPSERT, CONFIRM, REMOVE, REMOVE_IF_STALE };
+    Kind kind;
+    struct sockaddr_in address;
+    SharedCatalog catalog;
+    std::chrono::system_clock::time_point time;
+    std::optional<uint64_t> digest;
+    // Restored from a snapshot rather than announced
+    bool provisional;
+  };
+
+  using TimestampCell = std::atomic<std::chrono::system_clock::time_point>;
+
+  /**
+   * @brief Expiry heap entry; the timestamp cell identifies the node
+   * instance, so entries of removed nodes are recognised and dropped
+   */
+  struct ExpiryEntry {
+    std::chrono::system_clock::time_point deadline;
+    struct sockaddr_in address;
+    std::weak_ptr<TimestampCell> lastSeen;
+
+    bool operator>(const ExpiryEntry &other) const {
+      return this->deadline > other.deadline;
+    }
+  };
+
+  /**
+   * @brief Next snapshot under construction; index shards are copied on
+   * first write
+   */
+  struct SnapshotBuilder {
+    NodeMap nodes;
+    std::vector<std::shared_ptr<const IndexShard>> index;
+    std::vector<std::shared_ptr<IndexShard>> copied;
+    // Armed once the snapshot containing the nodes is published
+    std::vector<ExpiryEntry> expiring;
+    // Names that gained their first or lost their last holder, in order
+    std::vector<std::pair<bool, std::string>> nameChanges;
+
+    IndexShard &shardFor(std::string_view resource_name);
+  };
+
+  SharedCatalog internCatalog_(const std::vector<Resource> &resources,
+                               std::optional<uint64_t> catalog_digest);
+
+  /**
+   * @brief Queues updates and waits until a snapshot containing them is
+   * published
+   */
+  void submit_(std::vector<PendingUpdate> updates);
+  void applyUpdate_(SnapshotBuilder &builder, PendingUpdate &update);
+
+  /**
+   * @brief Moves a node's index entries from one catalog to another
+   *
+   * Name-sorted catalogs (as produced by CatalogCodec) are diffed so only
+   * changed entries are touched.
+   */
+  static void reindexNode_(SnapshotBuilder &builder,
+                           const struct sockaddr_in &node_address,
+                           const CompactCatalog *previous,
+                           const CompactCatalog *next);
+  static size_t shardIndex_(std::string_view resource_name);
+  static size_t nodePosition_(const NodeMap &nodes,
+                              const struct sockaddr_in &address);
+  static const RemoteNode *findNode_(const NodeMap &nodes,
+                                     const struct sockaddr_in &address);
+  static const HolderList *findHolders_(const Snapshot &snapshot,
+                                        std::string_view resource_name);
+  void armExpiry_(std::vector<ExpiryEntry> entries);
+  void persist_() const;
+
+  std::shared_ptr<NamePool> name_pool_;
+  std::atomic<std::shared_ptr<const Snapshot>> snapshot_;
   const std::chrono::seconds cleanup_interval_;
+  std::atomic<std::shared_ptr<const ProviderLookup>> provider_lookup_;
+
+  std::mutex writer_mutex_;
+  std::mutex pending_mutex_;
+  std::vector<PendingUpdate> pending_;
+  uint64_t next_ticket_{0};
+  std::atomic<uint64_t> applied_ticket_{0};
+
+  // Follows the published snapshots; updated by the writer after publishing
+  NameIndex name_index_;
+  // Kept apart from the snapshots: updated on every transfer
+  PeerStatsTable peer_stats_;
+
+  std::optional<std::filesystem::path> snapshot_path_;
+  std::chrono::seconds snapshot_interval_{
+      constants::remote_resource_manager::SNAPSHOT_INTERVAL};
+
+  std::atomic<bool> running_{false};
+  std::mutex expiry_mutex_;
+  std::condition_variable expiry_cv_;
+  std::priority_queue<ExpiryEntry, std::vector<ExpiryEntry>,
+                      std::greater<ExpiryEntry>>
+      expiry_heap_;
+
+  std::mutex catalog_pool_mutex_;
+  std::unordered_map<uint64_t, std::weak_ptr<const CompactCatalog>>
+      catalog_pool_;
 };
 
 } // namespace p2p
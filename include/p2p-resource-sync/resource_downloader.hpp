@@ -1,10 +1,12 @@
 #pragma once
 #include "protocol.hpp"
+#include "remote_resource_manager.hpp"
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <netinet/in.h>
 #include <string>
+#include <tuple>
 
 #include "constants.hpp"
 
@@ -64,7 +66,25 @@ public:
   downloadResource(const std::string &peer_addr, int peer_port, uint64_t offset,
                    const std::string &resource_name) const;
 
+  /**
+   * @brief Downloads resource from a node known to the remote manager
+   *
+   * Same as above, connecting to the node's address on peer_port. Every
+   * attempt is recorded in the statistics of the node, if a sink was set.
+   */
+  std::pair<uint64_t, uint64_t>
+  downloadResource(const struct sockaddr_in &node_address, int peer_port,
+                   uint64_t offset, const std::string &resource_name) const;
+
+  /**
+   * @brief Reports transfer statistics to the given manager
+   *
+   * Must be called before downloading.
+   */
+  void setPeerStatsSink(std::shared_ptr<RemoteResourceManager> remote_manager);
+
 private:
+  std::shared_ptr<RemoteResourceManager> peer_stats_sink_;
   const std::string download_dir_;
   const uint32_t socket_timeout_ms_;
   int initialize_socket_(const std::string &host, int port) const;
@@ -73,7 +93,14 @@ private:
   std::unique_ptr<ResourceRequest>
   create_resource_request_(const uint64_t offset,
                            const std::string &resource_name) const;
-  std::pair<bool, uint64_t> receive_initial_response_(int sock) const;
+  void receive_exactly_(int sock, void *buffer, size_t length) const;
+  // Whether the resource exists, its size and its version
+  std::tuple<bool, uint64_t, uint64_t>
+  receive_initial_response_(int sock) const;
+  std::pair<uint64_t, uint64_t>
+  download_(const std::string &peer_addr, int peer_port, uint64_t offset,
+            const std::string &resource_name,
+            const struct sockaddr_in *node_address) const;
   uint64_t receive_file_(int sock, uint64_t offset,
                          const std::string &resource_name,
                          uint64_t file_size) const;
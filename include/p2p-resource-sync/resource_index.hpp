@@ -0,0 +1,75 @@
+#pragma once
+
+#include "local_resource_manager.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace p2p {
+
+/**
+ * @brief Append-only log of the local catalog, replayed on startup
+ *
+ * Every addition and removal appends one checksummed record, written with
+ * a single write() call. On load, records are replayed until the first
+ * incomplete or corrupt one, and the file is truncated there, so a crash
+ * loses at most the records being written. Once the log holds
+ * COMPACTION_FACTOR times more records than live resources, it is rewritten
+ * with one record per resource, fsynced and renamed over the old log.
+ *
+ * Not thread-safe; LocalResourceManager calls it under its lock.
+ */
+class ResourceIndex {
+public:
+  /**
+   * @brief Opens the log, creating it if missing, and replays it
+   * @throws std::runtime_error if the file is unusable or not an index
+   */
+  explicit ResourceIndex(const std::filesystem::path &path);
+  ~ResourceIndex();
+
+  ResourceIndex(const ResourceIndex &) = delete;
+  ResourceIndex &operator=(const ResourceIndex &) = delete;
+
+  /**
+   * @brief Catalog as of the last record replayed
+   */
+  const std::map<std::string, ResourceInfo> &restored() const;
+  /**
+   * @brief Frees the replayed catalog once it has been taken over
+   */
+  void releaseRestored();
+
+  /**
+   * @throws std::runtime_error if the record cannot be written
+   */
+  void recordAdd(const ResourceInfo &resource);
+  void recordRemove(const std::string &name);
+
+  bool needsCompaction(size_t live_resources) const;
+  /**
+   * @brief Rewrites the log with one record per resource
+   */
+  void compact(const LocalCatalog &catalog);
+
+  size_t getRecordCount() const;
+
+private:
+  struct RecordHeader;
+
+  void replay_();
+  void append_(const std::vector<char> &record);
+  static void encodeAdd_(std::vector<char> &buffer,
+                         const ResourceInfo &resource);
+  static void encodeRemove_(std::vector<char> &buffer,
+                            const std::string &name);
+
+  const std::filesystem::path path_;
+  int fd_{-1};
+  size_t record_count_{0};
+  std::map<std::string, ResourceInfo> restored_;
+};
+
+} // namespace p2p
@@ -2,7 +2,12 @@
 #include "local_resource_manager.hpp"
 #include "constants.hpp"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <sys/stat.h>
 
 namespace p2p {
 /**
@@ -44,6 +49,16 @@ public:
    */
   void run();
   void stop();
+
+  /**
+   * @brief Waits until run() accepts connections
+   *
+   * The socket is bound in run(), which usually runs on another thread.
+   *
+   * @return true once listening; false if run() failed to bind or the
+   * timeout expired first
+   */
+  bool waitUntilListening(std::chrono::milliseconds timeout);
   int getServerSocket();
   void simulatePeriodicDrop(size_t frequency);
 
@@ -71,6 +86,32 @@ private:
    */
   void handleClient_(int client_socket);
 
+  /**
+   * @brief Sends an open resource file from an offset
+   *
+   * Response: status (uint8), file size (uint64) and file version (uint64),
+   * followed by the file from the offset. The version identifies the
+   * content by inode, size and modification time, so a client resuming a
+   * download can tell whether the file changed in between. Exactly the
+   * announced size is sent, even if the file grows meanwhile.
+   *
+   * @param file_stat fstat of fd, taken when it was opened
+   * @throws std::runtime_error if the file shrinks while it is sent
+   */
+  void sendFile_(int client_socket, int fd, uint64_t offset,
+                 const struct stat &file_stat);
+
+  /**
+   * @brief Sends the full local catalog to a client
+   *
+   * Response: status (uint8), payload length (uint64), followed by the
+   * payload consisting of catalog digest (uint64), resource count (uint32)
+   * and the encoded entries.
+   *
+   * @param client_socket Socket for connected client
+   */
+  void sendCatalog_(int client_socket);
+
   std::shared_ptr<LocalResourceManager> resource_manager_;
   int server_socket_;
   const int port_;
@@ -78,7 +119,14 @@ private:
   std::atomic<bool> should_stop_{false};
   std::atomic<bool> should_simulate_periodic_drop_;
   size_t drop_frequency_{constants::tcp_server::DEFAULT_DROP_FREQUENCY};
-  void sendChunk_(int client_socket, const char* data, size_t length, size_t& total_sent);
+
+  enum class ListenState { STARTING, LISTENING, FAILED };
+  std::mutex listen_mutex_;
+  std::condition_variable listen_cv_;
+  ListenState listen_state_{ListenState::STARTING};
+  void setListenState_(ListenState state);
+  void sendChunk_(int client_socket, const char* data, size_t length, uint64_t& total_sent);
+  void receiveExactly_(int client_socket, void *buffer, size_t length);
 
 };
 
@@ -1,5 +1,8 @@
 #include "p2p-resource-sync/announcement_broadcaster.hpp"
 #include "p2p-resource-sync/announcement_receiver.hpp"
+#include "p2p-resource-sync/dht_node.hpp"
+#include "p2p-resource-sync/directory_watcher.hpp"
+#include "p2p-resource-sync/gossip_node.hpp"
 #include "p2p-resource-sync/local_resource_manager.hpp"
 #include "p2p-resource-sync/logger.hpp"
 #include "p2p-resource-sync/remote_resource_manager.hpp"
@@ -13,9 +16,12 @@
 #include <cstdint>
 #include <exception>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <netinet/in.h>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <thread>
 
@@ -25,7 +31,10 @@ class Application {
 public:
   Application(uint32_t node_id, uint16_t sender_port, uint16_t broadcast_port,
               uint16_t tcp_port, bool simulate_drops,
-              const std::string &downloads_path = "downloads/")
+              const std::string &downloads_path = "downloads/",
+              const std::string &transport = "broadcast",
+              const std::string &announce_mode = "full",
+              const std::string &gossip = "", const std::string &dht = "")
       : local_resource_manager_(std::make_shared<p2p::LocalResourceManager>()),
         remote_resource_manager_(std::make_shared<p2p::RemoteResourceManager>(
             std::chrono::seconds(60))),
@@ -33,18 +42,34 @@ public:
                      broadcast_port),
         receiver_(remote_resource_manager_, node_id, broadcast_port),
         tcp_server_(local_resource_manager_, tcp_port, 10, simulate_drops),
-        downloads_path_(downloads_path), downloader_(downloads_path),
-        tcp_port_(tcp_port) {
+        downloads_path_(downloads_path), downloader_(downloads_path) {
 
+    this->broadcaster_.setPeerCountSource(remote_resource_manager_);
+    this->downloader_.setPeerStatsSink(remote_resource_manager_);
+    this->broadcaster_.setServicePort(tcp_port);
+    this->local_resource_manager_->enableContentHashing(
+        "content_hashes_" + std::to_string(node_id) + ".cache");
+    this->local_resource_manager_->enablePersistence(
+        "local_index_" + std::to_string(node_id) + ".log");
+    this->remote_resource_manager_->enablePersistence(
+        "remote_catalog_" + std::to_string(node_id) + ".snapshot");
+    this->configureTransport_(transport, broadcast_port);
+    if (announce_mode == "digest") {
+      this->broadcaster_.enableDigestMode();
+    } else if (announce_mode != "full") {
+      throw std::runtime_error("Unknown announcement mode: " + announce_mode);
+    }
+    if (!gossip.empty()) {
+      this->configureGossip_(gossip, node_id, tcp_port);
+    }
+    if (!dht.empty()) {
+      this->configureDht_(dht, node_id, tcp_port);
+    }
     this->broadcaster_thread_ = std::jthread([this]() { broadcaster_.run(); });
     this->receiver_thread_ = std::jthread([this]() { receiver_.run(); });
     this->tcp_server_thread_ = std::jthread([this]() { tcp_server_.run(); });
-    this->cleanup_thread_ = std::jthread([this]() {
-      while (!shutdown_requested) {
-        remote_resource_manager_->cleanupStaleNodes();
-        std::this_thread::sleep_for(std::chrono::seconds(10));
-      }
-    });
+    this->cleanup_thread_ =
+        std::jthread([this]() { remote_resource_manager_->run(); });
   }
 
   ~Application() { stop(); }
@@ -53,6 +78,26 @@ public:
     this->broadcaster_.stop();
     this->receiver_.stop();
     this->tcp_server_.stop();
+    this->remote_resource_manager_->stop();
+    for (auto &watcher : this->directory_watchers_)
+      watcher->stop();
+    for (auto &thread : this->directory_watcher_threads_)
+      if (thread.joinable())
+        thread.join();
+    if (this->gossip_node_)
+      this->gossip_node_->stop();
+    if (this->gossip_thread_.joinable())
+      this->gossip_thread_.join();
+    if (this->dht_node_) {
+      this->remote_resource_manager_->setProviderLookup(nullptr);
+      this->dht_node_->stop();
+    }
+    if (this->dht_thread_.joinable())
+      this->dht_thread_.join();
+    if (this->dht_transport_)
+      this->dht_transport_->stop();
+    if (this->dht_transport_thread_.joinable())
+      this->dht_transport_thread_.join();
     if (this->broadcaster_thread_.joinable())
       this->broadcaster_thread_.join();
     if (this->receiver_thread_.joinable())
@@ -73,6 +118,115 @@ public:
   }
 
 private:
+  // Supported specs: "broadcast", "multicast[:group]" and
+  // "unicast[:ip,ip,...]"; unicast also sends to every node heard from.
+  void configureTransport_(const std::string &spec, uint16_t broadcast_port) {
+    auto separator = spec.find(':');
+    std::string kind = spec.substr(0, separator);
+    std::string argument =
+        separator == std::string::npos ? "" : spec.substr(separator + 1);
+
+    if (kind == "broadcast") {
+      return;
+    }
+    if (kind == "multicast") {
+      std::string group =
+          argument.empty()
+              ? constants::announcement_transport::DEFAULT_MULTICAST_GROUP
+              : argument;
+      this->broadcaster_.setTransport(
+          std::make_shared<p2p::MulticastTransport>(group, broadcast_port));
+      this->receiver_.joinMulticastGroup(group);
+      return;
+    }
+    if (kind == "unicast") {
+      auto transport = std::make_shared<p2p::UnicastTransport>(broadcast_port);
+      std::stringstream peers(argument);
+      std::string peer;
+      while (std::getline(peers, peer, ',')) {
+        struct in_addr address;
+        if (inet_pton(AF_INET, peer.c_str(), &address) != 1) {
+          throw std::runtime_error("Invalid unicast peer address: " + peer);
+        }
+        transport->addPeer(address);
+      }
+      transport->learnPeersFrom(this->remote_resource_manager_);
+      this->broadcaster_.setTransport(transport);
+      return;
+    }
+    throw std::runtime_error("Unknown announcement transport: " + spec);
+  }
+
+  // Overlay specs: "port[:seed_ip:seed_port,...]", seeds are addresses of
+  // already running members; the first member is started without seeds.
+  static std::pair<uint16_t, std::vector<struct sockaddr_in>>
+  parseOverlaySpec_(const std::string &spec) {
+    auto separator = spec.find(':');
+    auto port = static_cast<uint16_t>(std::stoi(spec.substr(0, separator)));
+    std::vector<struct sockaddr_in> seeds;
+    if (separator != std::string::npos) {
+      std::stringstream seed_list(spec.substr(separator + 1));
+      std::string seed;
+      while (std::getline(seed_list, seed, ',')) {
+        auto port_separator = seed.rfind(':');
+        struct sockaddr_in address{};
+        address.sin_family = AF_INET;
+        if (port_separator == std::string::npos ||
+            inet_pton(AF_INET, seed.substr(0, port_separator).c_str(),
+                      &address.sin_addr) != 1) {
+          throw std::runtime_error("Invalid seed address: " + seed);
+        }
+        address.sin_port = htons(
+            static_cast<uint16_t>(std::stoi(seed.substr(port_separator + 1))));
+        seeds.push_back(address);
+      }
+    }
+    return {port, seeds};
+  }
+
+  void configureGossip_(const std::string &spec, uint32_t node_id,
+                        uint16_t tcp_port) {
+    auto [gossip_port, seeds] = parseOverlaySpec_(spec);
+    this->gossip_node_ = std::make_unique<p2p::GossipNode>(
+        this->local_resource_manager_, this->remote_resource_manager_, node_id,
+        "0.0.0.0", gossip_port, tcp_port);
+    this->gossip_node_->join(seeds);
+    this->gossip_thread_ =
+        std::jthread([this]() { this->gossip_node_->run(); });
+  }
+
+  // Publishes local resources in the DHT and resolves unknown holders
+  // through it
+  void configureDht_(const std::string &spec, uint32_t node_id,
+                     uint16_t tcp_port) {
+    auto [dht_port, seeds] = parseOverlaySpec_(spec);
+    this->dht_transport_ =
+        std::make_shared<p2p::UdpDhtTransport>("0.0.0.0", dht_port);
+    this->dht_transport_thread_ =
+        std::jthread([this]() { this->dht_transport_->run(); });
+    this->dht_node_ = std::make_unique<p2p::DhtNode>(
+        p2p::DhtNode::keyFor("node-" + std::to_string(node_id)),
+        this->dht_transport_);
+    if (!seeds.empty() && !this->dht_node_->bootstrap(seeds)) {
+      p2p::Logger::log<p2p::LogLevel::ERROR>("No DHT seed answered");
+    }
+
+    struct sockaddr_in provider{};
+    provider.sin_family = AF_INET;
+    provider.sin_addr.s_addr = INADDR_ANY;
+    provider.sin_port = htons(tcp_port);
+    this->dht_node_->publishFrom(this->local_resource_manager_, provider);
+    this->remote_resource_manager_->setProviderLookup(
+        [dht = this->dht_node_.get()](const std::string &name) {
+          std::vector<struct sockaddr_in> holders;
+          for (const auto &provider : dht->findProviders(name)) {
+            holders.push_back(provider.address);
+          }
+          return holders;
+        });
+    this->dht_thread_ = std::jthread([this]() { this->dht_node_->run(); });
+  }
+
   void displayMenu_() {
     std::cout << "\r"
               << "P2P File Sharing System\n"
@@ -81,7 +235,9 @@ private:
               << "3. Add local resource\n"
               << "4. Remove local resource\n"
               << "5. Download resource\n"
-              << "6. Exit\n"
+              << "6. Search network resources\n"
+              << "7. Share a directory\n"
+              << "8. Exit\n"
               << "Enter command: " << std::flush;
   }
 
@@ -105,34 +261,69 @@ private:
         this->downloadRemoteResource_();
         break;
       case 6:
+        this->searchRemoteResources_();
+        break;
+      case 7:
+        this->shareDirectory_();
+        break;
+      case 8:
         shutdown_requested = true;
         break;
       default:
         std::cout
-            << "Invalid command - please enter a number between 1 and 6\n";
+            << "Invalid command - please enter a number between 1 and 8\n";
       }
     } catch (const std::exception &e) {
-      std::cout << "Invalid input - please enter a number between 1 and 6\n";
+      std::cout << "Invalid input - please enter a number between 1 and 8\n";
     }
   }
 
   void listLocalResources_() {
-    auto resources = this->local_resource_manager_->getAllResources();
     std::cout << "\nLocal resources:\n";
-    for (const auto &resource : resources) {
-      std::cout << "- " << resource.first << " (" << resource.second.size
-                << " bytes)\n";
-    }
+    this->local_resource_manager_->forEachResource(
+        [](const p2p::ResourceInfo &resource) {
+          std::cout << "- " << resource.name << " (" << resource.size
+                    << " bytes";
+          if (resource.contentHash) {
+            std::cout << ", hash " << std::hex << std::setw(16)
+                      << std::setfill('0') << *resource.contentHash
+                      << std::dec << std::setfill(' ');
+          }
+          std::cout << ")\n";
+        });
   }
 
   void listRemoteResources_() {
-    auto resources = this->remote_resource_manager_->getAllResources();
     std::cout << "\nRemote resources:\n";
-    for (const auto &[addr, resource] : resources) {
-      char ip[INET_ADDRSTRLEN];
-      inet_ntop(AF_INET, &(addr.sin_addr), ip, INET_ADDRSTRLEN);
-      std::cout << "- " << resource.name << " (" << resource.size
-                << " bytes) at " << ip << "\n";
+    this->remote_resource_manager_->forEachResource(
+        [](const struct sockaddr_in &addr, std::string_view name,
+           uint64_t size) {
+          char ip[INET_ADDRSTRLEN];
+          inet_ntop(AF_INET, &(addr.sin_addr), ip, INET_ADDRSTRLEN);
+          std::cout << "- " << name << " (" << size << " bytes) at " << ip
+                    << "\n";
+        });
+  }
+
+  void searchRemoteResources_() {
+    std::cout << "Enter search query: ";
+    std::string query;
+    std::getline(std::cin, query);
+
+    auto matches = this->remote_resource_manager_->searchResources(query);
+    if (matches.empty()) {
+      std::cout << "No resources match: " << query << std::endl;
+      return;
+    }
+    std::cout << "\nMatching resources:\n";
+    for (const auto &match : matches) {
+      std::cout << "- " << match.name << " at";
+      for (const auto &holder : match.holders) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(holder.address.sin_addr), ip, INET_ADDRSTRLEN);
+        std::cout << " " << ip << " (" << holder.size << " bytes)";
+      }
+      std::cout << "\n";
     }
   }
 
@@ -140,6 +331,10 @@ private:
     std::cout << "Enter resource path: ";
     std::string path;
     std::getline(std::cin, path);
+    if (std::filesystem::is_directory(path)) {
+      this->importDirectory_(path);
+      return;
+    }
 
     std::cout << "Enter resource name: ";
     std::string name;
@@ -152,6 +347,37 @@ private:
     }
   }
 
+  // Adds every file below the directory once, named by its relative path,
+  // without watching it for changes
+  void importDirectory_(const std::filesystem::path &directory) {
+    std::vector<p2p::NewResource> resources;
+    try {
+      for (const auto &entry :
+           std::filesystem::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+          resources.push_back(p2p::NewResource{
+              .name = entry.path().lexically_relative(directory).string(),
+              .path = entry.path().string()});
+        }
+      }
+    } catch (const std::exception &e) {
+      std::cout << "Failed to read directory: " << e.what() << "\n";
+      return;
+    }
+
+    auto results = this->local_resource_manager_->addResources(resources);
+    size_t failed = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (results[i].error) {
+        failed++;
+        std::cout << "Failed to add " << resources[i].path << ": "
+                  << *results[i].error << "\n";
+      }
+    }
+    std::cout << "Added " << results.size() - failed << " of "
+              << results.size() << " resources\n";
+  }
+
   void removeLocalResource_() {
     std::cout << "Enter resource name: ";
     std::string name;
@@ -165,6 +391,30 @@ private:
     std::cout << "Resource removed successfully" << std::endl;
   }
 
+  // Files in the directory are shared under their relative paths and kept
+  // in sync with it until shutdown
+  void shareDirectory_() {
+    std::cout << "Enter directory path: ";
+    std::string path;
+    std::getline(std::cin, path);
+    try {
+      auto &watcher = this->directory_watchers_.emplace_back(
+          std::make_unique<p2p::DirectoryWatcher>(this->local_resource_manager_,
+                                                  path));
+      this->directory_watcher_threads_.emplace_back([&watcher = *watcher]() {
+        try {
+          watcher.run();
+        } catch (const std::exception &e) {
+          p2p::Logger::log<p2p::LogLevel::ERROR>(
+              "Failed to watch {}: {}", watcher.getRoot().string(), e.what());
+        }
+      });
+      std::cout << "Sharing " << watcher->getRoot().string() << "\n";
+    } catch (const std::exception &e) {
+      std::cout << "Failed to share directory: " << e.what() << "\n";
+    }
+  }
+
   void downloadRemoteResource_() {
     std::cout << "Enter resource name: ";
     std::string name;
@@ -172,7 +422,7 @@ private:
     uint64_t offset = 0;
 
     while (true) {
-      auto nodes = this->remote_resource_manager_->findNodesWithResource(name);
+      auto nodes = this->remote_resource_manager_->rankHolders(name);
       if (nodes.empty()) {
         std::cout << "Resource not found: " << name << std::endl;
         return;
@@ -180,13 +430,10 @@ private:
 
       size_t choice = this->chooseNodeToDownload_(nodes);
 
-      char chosen_ip[INET_ADDRSTRLEN];
-      inet_ntop(AF_INET, &(nodes[choice - 1].sin_addr), chosen_ip,
-                INET_ADDRSTRLEN);
-
       try {
         auto [received, total_size] = this->downloader_.downloadResource(
-            chosen_ip, this->tcp_port_, offset, name);
+            nodes[choice - 1], ntohs(nodes[choice - 1].sin_port), offset,
+            name);
 
         if (total_size == 0) {
           std::cout << "Download failed, resource not found" << std::endl;
@@ -228,16 +475,32 @@ private:
     std::cout << "Found " << nodes.size() << " nodes with resource"
               << std::endl;
     if (nodes.size() > 1) {
+      // Ranked best first, so the default is the fastest healthy node
       for (size_t i = 0; i < nodes.size(); i++) {
         char ip[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &(nodes[i].sin_addr), ip, INET_ADDRSTRLEN);
-        std::cout << i + 1 << " - " << ip << std::endl;
+        std::cout << i + 1 << " - " << ip;
+        if (auto stats = this->remote_resource_manager_->getPeerStats(nodes[i]);
+            stats && stats->throughputBytesPerSecond > 0) {
+          std::ostringstream summary;
+          summary << std::fixed << std::setprecision(2)
+                  << stats->throughputBytesPerSecond / (1024 * 1024)
+                  << " MB/s, " << std::setprecision(0)
+                  << stats->failureRate * 100 << "% failed";
+          std::cout << " (" << summary.str() << ")";
+        }
+        std::cout << std::endl;
       }
 
       while (true) {
-        std::cout << "Choose node number (1-" << nodes.size() << "): ";
+        std::cout << "Choose node number (1-" << nodes.size()
+                  << ", Enter for 1): ";
         std::string input;
         std::getline(std::cin, input);
+        if (input.empty()) {
+          choice = 1;
+          break;
+        }
 
         try {
           choice = std::stoul(input);
@@ -267,17 +530,32 @@ private:
   std::jthread receiver_thread_;
   std::jthread tcp_server_thread_;
   std::jthread cleanup_thread_;
-  uint16_t tcp_port_;
+  std::unique_ptr<p2p::GossipNode> gossip_node_;
+  std::jthread gossip_thread_;
+  std::shared_ptr<p2p::UdpDhtTransport> dht_transport_;
+  std::jthread dht_transport_thread_;
+  std::unique_ptr<p2p::DhtNode> dht_node_;
+  std::jthread dht_thread_;
+  std::vector<std::unique_ptr<p2p::DirectoryWatcher>> directory_watchers_;
+  std::vector<std::jthread> directory_watcher_threads_;
 };
 
 void signalHandler(int) { shutdown_requested = true; }
 
 int main(int argc, char *argv[]) {
   try {
-    if (argc != 5 && argc != 6 && argc != 7) {
+    if (argc < 5 || argc > 11) {
       std::cout << "Usage: " << argv[0]
                 << " <node_id> <udp_port> <broadcast_port> <tcp_port> "
-                   "[simulate_drops] [downloads_path]\n";
+                   "[simulate_drops] [downloads_path] [transport] "
+                   "[announce_mode] [gossip] [dht]\n"
+                << "  transport: broadcast (default), multicast[:group] or "
+                   "unicast[:ip,ip,...]\n"
+                << "  announce_mode: full (default) or digest\n"
+                << "  gossip: port[:seed_ip:seed_port,...] enables the gossip "
+                   "overlay\n"
+                << "  dht: port[:seed_ip:seed_port,...] enables DHT lookups of "
+                   "resource holders\n";
       return 1;
     }
 
@@ -287,7 +565,11 @@ int main(int argc, char *argv[]) {
     uint16_t broadcast_port = static_cast<uint16_t>(std::stoi(argv[3]));
     uint16_t tcp_port = static_cast<uint16_t>(std::stoi(argv[4]));
     bool simulate_drops = (argc >= 6) && std::stoi(argv[5]) != 0;
-    std::string downloads_path = (argc == 7) ? argv[6] : "downloads/";
+    std::string downloads_path = (argc >= 7) ? argv[6] : "downloads/";
+    std::string transport = (argc >= 8) ? argv[7] : "broadcast";
+    std::string announce_mode = (argc >= 9) ? argv[8] : "full";
+    std::string gossip = (argc >= 10) ? argv[9] : "";
+    std::string dht = (argc == 11) ? argv[10] : "";
 
     if (!std::filesystem::exists(downloads_path)) {
       std::filesystem::create_directories(downloads_path);
@@ -296,7 +578,8 @@ int main(int argc, char *argv[]) {
     std::signal(SIGINT, signalHandler);
     std::signal(SIGTERM, signalHandler);
     Application app(node_id, sender_port, broadcast_port, tcp_port,
-                    simulate_drops, downloads_path);
+                    simulate_drops, downloads_path, transport, announce_mode,
+                    gossip, dht);
     app.run();
     std::cout << "\nShutting down...\n";
     app.stop();
@@ -1,14 +1,19 @@
+#include "p2p-resource-sync/catalog_codec.hpp"
 #include "p2p-resource-sync/constants.hpp"
 #include "p2p-resource-sync/local_resource_manager.hpp"
 #include "p2p-resource-sync/logger.hpp"
+#include "p2p-resource-sync/protocol.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <netinet/in.h>
 #include <p2p-resource-sync/announcement_broadcaster.hpp>
+#include <random>
 #include <string>
 #include <sys/socket.h>
 #include <thread>
@@ -25,31 +30,47 @@ AnnouncementBroadcaster::AnnouncementBroadcaster(
   this->node_id_ = node_id;
   this->port_ = port;
   this->broadcast_interval_ = broadcast_interval;
-  this->initializeSocket_(broadcast_port);
+  this->random_engine_.seed(std::random_device{}() ^ node_id);
+  this->initializeSocket_();
+  try {
+    this->setTransport(std::make_shared<BroadcastTransport>(broadcast_port));
+  } catch (const std::exception &) {
+    close(this->socket_);
+    throw;
+  }
+  this->change_listener_id_ = this->resource_manager_->addChangeListener(
+      [this](uint64_t) { this->onCatalogChange_(); });
+};
+
+AnnouncementBroadcaster::~AnnouncementBroadcaster() {
+  this->resource_manager_->removeChangeListener(this->change_listener_id_);
+  close(this->socket_);
+};
+
+void AnnouncementBroadcaster::setPeerCountSource(
+    std::shared_ptr<RemoteResourceManager> remote_manager) {
+  this->peer_count_source_ = std::move(remote_manager);
+};
+
+void AnnouncementBroadcaster::setServicePort(uint16_t service_port) {
+  this->service_port_ = service_port;
 };
 
-AnnouncementBroadcaster::~AnnouncementBroadcaster() { close(this->socket_); };
+void AnnouncementBroadcaster::enableDigestMode() { this->digest_mode_ = true; };
 
-void AnnouncementBroadcaster::initializeSocket_(uint16_t broadcast_port) {
+void AnnouncementBroadcaster::setTransport(
+    std::shared_ptr<AnnouncementTransport> transport) {
+  transport->configureSocket(this->socket_);
+  this->transport_ = std::move(transport);
+};
+
+void AnnouncementBroadcaster::initializeSocket_() {
   this->socket_ = socket(AF_INET, SOCK_DGRAM, 0);
   if (this->socket_ < 0) {
     throw std::runtime_error("Failed to create socket: " +
                              std::string(strerror(errno)));
   }
 
-  int broadcast_enable =
-      constants::announcement_broadcaster::socket::BROADCAST_ENABLE;
-  if (setsockopt(this->socket_, SOL_SOCKET, SO_BROADCAST, &broadcast_enable,
-                 sizeof(broadcast_enable)) < 0) {
-    close(this->socket_);
-    throw std::runtime_error("Failed to set broadcast option: " +
-                             std::string(strerror(errno)));
-  }
-
-  this->broadcast_address_.sin_family = AF_INET;
-  this->broadcast_address_.sin_port = htons(broadcast_port);
-  this->broadcast_address_.sin_addr.s_addr = INADDR_BROADCAST;
-
   struct sockaddr_in addr;
   addr.sin_family = AF_INET;
   addr.sin_port = htons(this->port_);
@@ -63,42 +84,54 @@ void AnnouncementBroadcaster::initializeSocket_(uint16_t broadcast_port) {
   }
 };
 
-AnnounceMessage AnnouncementBroadcaster::createAnnounceMessage_() const {
+AnnounceMessage AnnouncementBroadcaster::createAnnounceMessage_(
+    const LocalCatalog &catalog) const {
   AnnounceMessage message;
-  auto local_resources = this->resource_manager_->getAllResources();
   message.timestamp =
       std::chrono::system_clock::now().time_since_epoch().count();
   message.senderId = this->node_id_;
-  message.resourceCount = local_resources.size();
-  message.resources.reserve(local_resources.size());
-
-  for (const auto &[name, info] : local_resources) {
-    Resource resource;
-    resource.name = info.name;
-    resource.size = info.size;
-    message.resources.push_back(resource);
-  }
+  message.resources = CatalogCodec::fromLocalResources(catalog);
+  message.resourceCount = message.resources.size();
+  message.servicePort = this->service_port_;
 
   message.datagramLength = sizeof(uint32_t) + // datagramLength
                            sizeof(uint64_t) + // timestamp
                            sizeof(uint32_t) + // senderId
-                           sizeof(uint32_t);  // resourceCount
+                           sizeof(uint32_t) + // resourceCount
+                           sizeof(uint16_t);  // servicePort
 
   // add each resource
   for (const auto &resource : message.resources) {
     message.datagramLength += sizeof(uint32_t) +       // nameLength
                               resource.name.length() + // name
-                              sizeof(uint32_t);        // resourceSize
+                              sizeof(uint64_t);        // resourceSize
   }
   return message;
 };
 
-void AnnouncementBroadcaster::broadcastAnnouncement_() const {
-  AnnounceMessage message = this->createAnnounceMessage_();
-  if (message.resourceCount < 1) {
-    return;
-  }
+HeartbeatMessage AnnouncementBroadcaster::createHeartbeatMessage_(
+    const AnnounceMessage &announcement) const {
+  std::vector<uint8_t> entries =
+      CatalogCodec::serializeEntries(announcement.resources);
+
+  HeartbeatMessage message;
+  message.datagramLength = sizeof(uint32_t) + // datagramLength
+                           sizeof(uint64_t) + // timestamp
+                           sizeof(uint32_t) + // senderId
+                           sizeof(uint32_t) + // resourceCount marker
+                           sizeof(uint16_t) + // servicePort
+                           sizeof(uint64_t);  // catalogDigest
+  message.timestamp = announcement.timestamp;
+  message.senderId = announcement.senderId;
+  message.servicePort = announcement.servicePort;
+  message.catalogDigest = CatalogCodec::digest(entries.data(), entries.size());
+  return message;
+};
+
+std::vector<uint8_t>
+AnnouncementBroadcaster::serializeAnnounceMessage_(AnnounceMessage &message) {
   std::vector<uint8_t> buffer;
+  buffer.reserve(message.datagramLength);
 
   buffer.insert(buffer.end(),
                 reinterpret_cast<uint8_t *>(&message.datagramLength),
@@ -114,39 +147,137 @@ void AnnouncementBroadcaster::broadcastAnnouncement_() const {
                 reinterpret_cast<uint8_t *>(&message.resourceCount),
                 reinterpret_cast<uint8_t *>(&message.resourceCount) +
                     sizeof(message.resourceCount));
+  buffer.insert(buffer.end(),
+                reinterpret_cast<uint8_t *>(&message.servicePort),
+                reinterpret_cast<uint8_t *>(&message.servicePort) +
+                    sizeof(message.servicePort));
 
   for (const auto &resource : message.resources) {
-    uint32_t nameLength = resource.name.length();
-    buffer.insert(buffer.end(), reinterpret_cast<uint8_t *>(&nameLength),
-                  reinterpret_cast<uint8_t *>(&nameLength) +
-                      sizeof(nameLength));
-    buffer.insert(buffer.end(), resource.name.begin(), resource.name.end());
-    buffer.insert(buffer.end(), (uint8_t *)&resource.size,
-                  (uint8_t *)&resource.size + sizeof(resource.size));
+    CatalogCodec::appendEntry(buffer, resource);
+  }
+  return buffer;
+};
+
+std::vector<uint8_t>
+AnnouncementBroadcaster::serializeHeartbeatMessage_(HeartbeatMessage &message) {
+  uint32_t marker = protocol::HEARTBEAT_RESOURCE_COUNT;
+  std::vector<uint8_t> buffer;
+  buffer.reserve(message.datagramLength);
+
+  buffer.insert(buffer.end(),
+                reinterpret_cast<uint8_t *>(&message.datagramLength),
+                reinterpret_cast<uint8_t *>(&message.datagramLength) +
+                    sizeof(message.datagramLength));
+  buffer.insert(buffer.end(), reinterpret_cast<uint8_t *>(&message.timestamp),
+                reinterpret_cast<uint8_t *>(&message.timestamp) +
+                    sizeof(message.timestamp));
+  buffer.insert(buffer.end(), reinterpret_cast<uint8_t *>(&message.senderId),
+                reinterpret_cast<uint8_t *>(&message.senderId) +
+                    sizeof(message.senderId));
+  buffer.insert(buffer.end(), reinterpret_cast<uint8_t *>(&marker),
+                reinterpret_cast<uint8_t *>(&marker) + sizeof(marker));
+  buffer.insert(buffer.end(),
+                reinterpret_cast<uint8_t *>(&message.servicePort),
+                reinterpret_cast<uint8_t *>(&message.servicePort) +
+                    sizeof(message.servicePort));
+  buffer.insert(buffer.end(),
+                reinterpret_cast<uint8_t *>(&message.catalogDigest),
+                reinterpret_cast<uint8_t *>(&message.catalogDigest) +
+                    sizeof(message.catalogDigest));
+  return buffer;
+};
+
+void AnnouncementBroadcaster::broadcastAnnouncement_(bool announce_empty) {
+  auto catalog = this->resource_manager_->getSnapshot();
+  if (catalog->version != this->datagram_version_) {
+    AnnounceMessage message = this->createAnnounceMessage_(*catalog);
+    if (this->digest_mode_) {
+      HeartbeatMessage heartbeat = this->createHeartbeatMessage_(message);
+      this->datagram_ = serializeHeartbeatMessage_(heartbeat);
+    } else {
+      this->datagram_ = serializeAnnounceMessage_(message);
+    }
+    this->datagram_version_ = catalog->version;
+    this->datagram_resource_count_ = message.resourceCount;
   }
+  if (this->datagram_resource_count_ < 1 && !announce_empty) {
+    return;
+  }
+
+  // Both formats put the timestamp right after datagramLength
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+  std::memcpy(this->datagram_.data() + sizeof(uint32_t), &timestamp,
+              sizeof(timestamp));
+
+  this->transport_->send(this->socket_, this->datagram_);
+  Logger::log<LogLevel::DEBUG>(
+      "Successfully broadcasted announcement message, size: {} bytes",
+      this->datagram_.size());
+};
+
+std::chrono::milliseconds AnnouncementBroadcaster::nextBroadcastDelay_() {
+  using namespace constants::announcement_broadcaster;
 
-  if (sendto(this->socket_, buffer.data(), buffer.size(), 0,
-             (struct sockaddr *)&this->broadcast_address_,
-             sizeof(this->broadcast_address_)) == -1) {
-    throw std::runtime_error("Failed to broadcast");
+  std::chrono::milliseconds interval = this->broadcast_interval_;
+  if (this->peer_count_source_) {
+    auto peer_count =
+        static_cast<int64_t>(this->peer_count_source_->getNodeCount());
+    std::chrono::milliseconds scaled = std::min<std::chrono::milliseconds>(
+        PER_PEER_INTERVAL * peer_count, MAX_BROADCAST_INTERVAL);
+    interval = std::max(interval, scaled);
   }
-  Logger::log(LogLevel::INFO,
-              "Successfully broadcasted announcement message, size: " +
-                  std::to_string(buffer.size()) + " bytes");
+
+  std::uniform_real_distribution<double> jitter(1.0 - INTERVAL_JITTER_FACTOR,
+                                                1.0 + INTERVAL_JITTER_FACTOR);
+  return std::chrono::milliseconds(static_cast<int64_t>(
+      interval.count() * jitter(this->random_engine_)));
+};
+
+void AnnouncementBroadcaster::onCatalogChange_() {
+  {
+    std::lock_guard lock(this->wake_mutex_);
+    this->catalog_changed_ = true;
+  }
+  this->wake_cv_.notify_one();
 };
 
 void AnnouncementBroadcaster::run() {
   this->running_ = true;
+  bool triggered_by_change = false;
   while (this->running_) {
     try {
-      this->broadcastAnnouncement_();
+      this->broadcastAnnouncement_(triggered_by_change);
     } catch (const std::exception &e) {
-      Logger::log(LogLevel::ERROR, "Broadcast error: " + std::string(e.what()));
+      Logger::log<LogLevel::ERROR>("Broadcast error: {}", e.what());
+    }
+
+    auto next_broadcast =
+        std::chrono::steady_clock::now() + this->nextBroadcastDelay_();
+    std::unique_lock lock(this->wake_mutex_);
+    this->wake_cv_.wait_until(lock, next_broadcast, [this]() {
+      return !this->running_ || this->catalog_changed_;
+    });
+
+    triggered_by_change = this->catalog_changed_;
+    if (triggered_by_change) {
+      // Coalesce bursts of changes (e.g. bulk additions) into one datagram
+      auto debounce_deadline =
+          std::chrono::steady_clock::now() +
+          constants::announcement_broadcaster::CHANGE_DEBOUNCE_INTERVAL;
+      this->wake_cv_.wait_until(lock, debounce_deadline,
+                                [this]() { return !this->running_; });
+      this->catalog_changed_ = false;
     }
-    std::this_thread::sleep_for(this->broadcast_interval_);
   }
 };
 
-void AnnouncementBroadcaster::stop() { this->running_ = false; };
+void AnnouncementBroadcaster::stop() {
+  {
+    std::lock_guard lock(this->wake_mutex_);
+    this->running_ = false;
+  }
+  this->wake_cv_.notify_all();
+};
 
 } // namespace p2p
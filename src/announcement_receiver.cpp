@@ -1,10 +1,13 @@
 #include "p2p-resource-sync/announcement_receiver.hpp"
+#include "p2p-resource-sync/catalog_codec.hpp"
 #include "p2p-resource-sync/logger.hpp"
+#include "p2p-resource-sync/protocol.hpp"
 #include <arpa/inet.h>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <exception>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <netdb.h>
@@ -29,7 +32,11 @@ AnnouncementReceiver::AnnouncementReceiver(
   this->initializeSocket_(socket_timeout_ms);
 };
 
-AnnouncementReceiver::~AnnouncementReceiver() { close(this->socket_); };
+AnnouncementReceiver::~AnnouncementReceiver() {
+  close(this->socket_);
+  // Waits for outstanding catalog fetches before members go away
+  this->pending_fetches_.clear();
+};
 
 void AnnouncementReceiver::initializeSocket_(int socket_timeout_ms) {
   this->socket_ = socket(AF_INET, SOCK_DGRAM, 0);
@@ -60,6 +67,36 @@ void AnnouncementReceiver::initializeSocket_(int socket_timeout_ms) {
   }
 };
 
+void AnnouncementReceiver::joinMulticastGroup(
+    const std::string &group, const std::string &interface_address) {
+  struct ip_mreq membership{};
+  if (inet_pton(AF_INET, group.c_str(), &membership.imr_multiaddr) != 1 ||
+      inet_pton(AF_INET, interface_address.c_str(),
+                &membership.imr_interface) != 1) {
+    throw std::runtime_error("Invalid multicast group or interface address");
+  }
+
+  if (setsockopt(this->socket_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership,
+                 sizeof(membership)) < 0) {
+    throw std::runtime_error("Failed to join multicast group " + group + ": " +
+                             std::string(strerror(errno)));
+  }
+  Logger::log<LogLevel::INFO>("Joined multicast group {}", group);
+};
+
+struct sockaddr_in
+AnnouncementReceiver::nodeAddress_(const struct sockaddr_in &sender_addr,
+                                   uint16_t service_port) {
+  if (service_port == 0) {
+    return sender_addr;
+  }
+  struct sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr = sender_addr.sin_addr;
+  address.sin_port = htons(service_port);
+  return address;
+};
+
 void AnnouncementReceiver::receiveAndProcessAnnouncement_() {
   std::vector<uint8_t> buffer(MAX_DATAGRAM_SIZE);
   struct sockaddr_in sender_addr;
@@ -76,7 +113,7 @@ void AnnouncementReceiver::receiveAndProcessAnnouncement_() {
   try {
     processAnnouncement_(buffer, received, sender_addr);
   } catch (const std::exception &e) {
-    throw std::runtime_error("Failed to process announcement");
+    throw std::runtime_error(std::string("Failed to process announcement: ") + e.what());
   }
 }
 
@@ -84,24 +121,134 @@ void AnnouncementReceiver::processAnnouncement_(
     const std::vector<uint8_t> &buffer, size_t size,
     const struct sockaddr_in &sender_addr) {
 
-  AnnounceMessage message = parseAnnounceMessage_(buffer, size);
+  if (isHeartbeat_(buffer, size)) {
+    processHeartbeat_(parseHeartbeatMessage_(buffer, size), sender_addr);
+    return;
+  }
+
+  AnnounceMessage message = parseAnnounceHeader_(buffer, size);
 
   if (message.senderId == this->node_id_)
     return;
+
+  struct sockaddr_in node_addr = nodeAddress_(sender_addr, message.servicePort);
+
+  // Unchanged catalogs only refresh the timestamp, entries are not parsed
+  const uint8_t *entries = buffer.data() + ANNOUNCE_HEADER_SIZE;
+  size_t entries_size = size - ANNOUNCE_HEADER_SIZE;
+  uint64_t digest = CatalogCodec::digest(entries, entries_size);
+  if (this->resource_manager_->refreshNode(node_addr, digest,
+                                           message.timestamp)) {
+    return;
+  }
+
+  message.resources =
+      CatalogCodec::parseEntries(entries, entries_size, message.resourceCount);
   char sender_ip[INET_ADDRSTRLEN];
   inet_ntop(AF_INET, &(sender_addr.sin_addr), sender_ip, INET_ADDRSTRLEN);
-  Logger::log(LogLevel::INFO,
-              "Successfully received announcement message from: " +
-                  std::string(sender_ip));
+  Logger::log<LogLevel::DEBUG>(
+      "Successfully received announcement message from: {}", sender_ip);
 
   this->resource_manager_->addOrUpdateNodeResources(
-      sender_addr, message.resources, message.timestamp);
+      node_addr, std::move(message.resources), message.timestamp, digest);
+}
+
+bool AnnouncementReceiver::isHeartbeat_(const std::vector<uint8_t> &buffer,
+                                        size_t size) {
+  if (size < ANNOUNCE_HEADER_SIZE) {
+    return false;
+  }
+  uint32_t resource_count;
+  std::memcpy(&resource_count, buffer.data() + RESOURCE_COUNT_OFFSET,
+              sizeof(uint32_t));
+  return resource_count == protocol::HEARTBEAT_RESOURCE_COUNT;
+}
+
+HeartbeatMessage
+AnnouncementReceiver::parseHeartbeatMessage_(const std::vector<uint8_t> &buffer,
+                                             size_t size) {
+  HeartbeatMessage message;
+  size_t offset = 0;
+
+  std::memcpy(&message.datagramLength, buffer.data() + offset,
+              sizeof(uint32_t));
+  offset += sizeof(uint32_t);
+
+  constexpr size_t expected_length =
+      sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t) +
+      sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint64_t);
+  if (message.datagramLength != size || size != expected_length) {
+    throw std::runtime_error("Invalid heartbeat length");
+  }
+
+  std::memcpy(&message.timestamp, buffer.data() + offset, sizeof(uint64_t));
+  offset += sizeof(uint64_t);
+
+  std::memcpy(&message.senderId, buffer.data() + offset, sizeof(uint32_t));
+  offset += sizeof(uint32_t);
+
+  offset += sizeof(uint32_t); // resourceCount marker
+
+  std::memcpy(&message.servicePort, buffer.data() + offset, sizeof(uint16_t));
+  offset += sizeof(uint16_t);
+
+  std::memcpy(&message.catalogDigest, buffer.data() + offset,
+              sizeof(uint64_t));
+  return message;
+}
+
+void AnnouncementReceiver::processHeartbeat_(
+    const HeartbeatMessage &message, const struct sockaddr_in &sender_addr) {
+  if (message.senderId == this->node_id_)
+    return;
+
+  struct sockaddr_in node_addr = nodeAddress_(sender_addr, message.servicePort);
+  if (this->resource_manager_->refreshNode(node_addr, message.catalogDigest,
+                                           message.timestamp)) {
+    return;
+  }
+  this->scheduleCatalogFetch_(message, node_addr);
+}
+
+void AnnouncementReceiver::scheduleCatalogFetch_(
+    const HeartbeatMessage &message, const struct sockaddr_in &node_addr) {
+  std::lock_guard lock(this->fetch_mutex_);
+  std::erase_if(this->pending_fetches_, [](const std::future<void> &fetch) {
+    return fetch.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+  });
+
+  auto key = std::make_pair(node_addr.sin_addr.s_addr, node_addr.sin_port);
+  if (!this->fetches_in_flight_.insert(key).second) {
+    return;
+  }
+
+  this->pending_fetches_.push_back(
+      std::async(std::launch::async, [this, message, node_addr, key]() {
+        char sender_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(node_addr.sin_addr), sender_ip,
+                  INET_ADDRSTRLEN);
+        try {
+          FetchedCatalog catalog = this->catalog_fetcher_.fetch(
+              node_addr.sin_addr, message.servicePort);
+          this->resource_manager_->addOrUpdateNodeResources(
+              node_addr, catalog.resources, message.timestamp,
+              catalog.digest);
+          Logger::log<LogLevel::INFO>("Fetched catalog with {} resources from {}",
+                                      catalog.resources.size(), sender_ip);
+        } catch (const std::exception &e) {
+          Logger::log<LogLevel::ERROR>("Catalog fetch from {} failed: {}",
+                                       sender_ip, e.what());
+        }
+        std::lock_guard lock(this->fetch_mutex_);
+        this->fetches_in_flight_.erase(key);
+      }));
 }
 
 AnnounceMessage
-AnnouncementReceiver::parseAnnounceMessage_(const std::vector<uint8_t> &buffer,
-                                            size_t size) {
-  if (size < sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t)) {
+AnnouncementReceiver::parseAnnounceHeader_(const std::vector<uint8_t> &buffer,
+                                           size_t size) {
+  if (size < ANNOUNCE_HEADER_SIZE) {
     throw std::runtime_error("Invalid datagram header");
   }
 
@@ -125,22 +272,7 @@ AnnouncementReceiver::parseAnnounceMessage_(const std::vector<uint8_t> &buffer,
   std::memcpy(&message.resourceCount, buffer.data() + offset, sizeof(uint32_t));
   offset += sizeof(uint32_t);
 
-  for (uint32_t i = 0; i < message.resourceCount; ++i) {
-    Resource resource;
-
-    uint32_t nameLength;
-    std::memcpy(&nameLength, buffer.data() + offset, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-
-    resource.name.assign(reinterpret_cast<const char *>(buffer.data() + offset),
-                         nameLength);
-    offset += nameLength;
-
-    std::memcpy(&resource.size, buffer.data() + offset, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-
-    message.resources.push_back(resource);
-  }
+  std::memcpy(&message.servicePort, buffer.data() + offset, sizeof(uint16_t));
 
   return message;
 }
@@ -150,9 +282,8 @@ void AnnouncementReceiver::run() {
   while (this->running_) {
     try {
       this->receiveAndProcessAnnouncement_();
-    } catch (std::exception e) {
-      Logger::log(LogLevel::ERROR,
-                  "Receiving Broadcast error" + std::string(e.what()));
+    } catch (const std::exception &e) {
+      Logger::log<LogLevel::ERROR>("Receiving Broadcast error: {}", e.what());
       std::this_thread::sleep_for(std::chrono::milliseconds(500));
     }
   }
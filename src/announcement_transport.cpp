@@ -0,0 +1,161 @@
+#include "p2p-resource-sync/announcement_transport.hpp"
+#include "p2p-resource-sync/logger.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+namespace p2p {
+
+namespace {
+struct in_addr parseAddress(const std::string &address) {
+  struct in_addr parsed;
+  if (inet_pton(AF_INET, address.c_str(), &parsed) != 1) {
+    throw std::runtime_error("Invalid IPv4 address: " + address);
+  }
+  return parsed;
+}
+
+void sendTo(int socket, const std::vector<uint8_t> &datagram,
+            const struct sockaddr_in &address) {
+  if (sendto(socket, datagram.data(), datagram.size(), 0,
+             reinterpret_cast<const struct sockaddr *>(&address),
+             sizeof(address)) == -1) {
+    throw std::runtime_error("Failed to send announcement: " +
+                             std::string(strerror(errno)));
+  }
+}
+} // namespace
+
+BroadcastTransport::BroadcastTransport(uint16_t port) {
+  this->broadcast_address_ = {};
+  this->broadcast_address_.sin_family = AF_INET;
+  this->broadcast_address_.sin_port = htons(port);
+  this->broadcast_address_.sin_addr.s_addr = INADDR_BROADCAST;
+};
+
+void BroadcastTransport::configureSocket(int socket) {
+  int broadcast_enable =
+      constants::announcement_broadcaster::socket::BROADCAST_ENABLE;
+  if (setsockopt(socket, SOL_SOCKET, SO_BROADCAST, &broadcast_enable,
+                 sizeof(broadcast_enable)) < 0) {
+    throw std::runtime_error("Failed to set broadcast option: " +
+                             std::string(strerror(errno)));
+  }
+};
+
+void BroadcastTransport::send(int socket,
+                              const std::vector<uint8_t> &datagram) {
+  sendTo(socket, datagram, this->broadcast_address_);
+};
+
+MulticastTransport::MulticastTransport(const std::string &group, uint16_t port,
+                                       int ttl,
+                                       const std::string &interface_address)
+    : ttl_(ttl) {
+  this->group_address_ = {};
+  this->group_address_.sin_family = AF_INET;
+  this->group_address_.sin_port = htons(port);
+  this->group_address_.sin_addr = parseAddress(group);
+  if (!IN_MULTICAST(ntohl(this->group_address_.sin_addr.s_addr))) {
+    throw std::runtime_error("Not a multicast address: " + group);
+  }
+  this->interface_address_ = parseAddress(interface_address);
+};
+
+void MulticastTransport::configureSocket(int socket) {
+  unsigned char ttl = static_cast<unsigned char>(this->ttl_);
+  if (setsockopt(socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) <
+      0) {
+    throw std::runtime_error("Failed to set multicast TTL: " +
+                             std::string(strerror(errno)));
+  }
+
+  // Keep local delivery so several nodes can share one host
+  unsigned char loopback = 1;
+  if (setsockopt(socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loopback,
+                 sizeof(loopback)) < 0) {
+    throw std::runtime_error("Failed to enable multicast loopback: " +
+                             std::string(strerror(errno)));
+  }
+
+  if (this->interface_address_.s_addr != INADDR_ANY &&
+      setsockopt(socket, IPPROTO_IP, IP_MULTICAST_IF,
+                 &this->interface_address_,
+                 sizeof(this->interface_address_)) < 0) {
+    throw std::runtime_error("Failed to set multicast interface: " +
+                             std::string(strerror(errno)));
+  }
+};
+
+void MulticastTransport::send(int socket,
+                              const std::vector<uint8_t> &datagram) {
+  sendTo(socket, datagram, this->group_address_);
+};
+
+UnicastTransport::UnicastTransport(uint16_t port,
+                                   const std::vector<struct in_addr> &peers)
+    : port_(port), peers_(peers) {};
+
+void UnicastTransport::addPeer(const struct in_addr &peer) {
+  std::lock_guard lock(this->mutex_);
+  auto known = std::ranges::any_of(this->peers_, [&peer](const in_addr &p) {
+    return p.s_addr == peer.s_addr;
+  });
+  if (!known) {
+    this->peers_.push_back(peer);
+  }
+};
+
+void UnicastTransport::learnPeersFrom(
+    std::shared_ptr<RemoteResourceManager> remote_manager) {
+  std::lock_guard lock(this->mutex_);
+  this->learned_peers_source_ = std::move(remote_manager);
+};
+
+void UnicastTransport::configureSocket(int) {};
+
+std::vector<struct in_addr> UnicastTransport::collectPeers_() const {
+  std::lock_guard lock(this->mutex_);
+  std::vector<struct in_addr> peers = this->peers_;
+  if (this->learned_peers_source_) {
+    for (const auto &node : this->learned_peers_source_->getNodeAddresses()) {
+      auto known = std::ranges::any_of(peers, [&node](const in_addr &p) {
+        return p.s_addr == node.sin_addr.s_addr;
+      });
+      if (!known) {
+        peers.push_back(node.sin_addr);
+      }
+    }
+  }
+  return peers;
+};
+
+void UnicastTransport::send(int socket, const std::vector<uint8_t> &datagram) {
+  auto peers = this->collectPeers_();
+  size_t failures = 0;
+  for (const auto &peer : peers) {
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(this->port_);
+    address.sin_addr = peer;
+    try {
+      sendTo(socket, datagram, address);
+    } catch (const std::exception &e) {
+      char peer_ip[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, &peer, peer_ip, INET_ADDRSTRLEN);
+      Logger::log<LogLevel::ERROR>("Unicast announcement to {} failed: {}",
+                                   peer_ip, e.what());
+      failures++;
+    }
+  }
+  if (!peers.empty() && failures == peers.size()) {
+    throw std::runtime_error("Failed to send announcement to any peer");
+  }
+};
+
+} // namespace p2p
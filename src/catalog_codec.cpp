@@ -0,0 +1,92 @@
+#include "p2p-resource-sync/catalog_codec.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace p2p {
+
+uint64_t CatalogCodec::digest(const uint8_t *data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::vector<Resource> CatalogCodec::fromLocalResources(
+    const std::map<std::string, ResourceInfo> &resources) {
+  std::vector<Resource> converted;
+  converted.reserve(resources.size());
+  for (const auto &[name, info] : resources) {
+    converted.push_back(Resource{.name = info.name, .size = info.size});
+  }
+  return converted;
+}
+
+std::vector<Resource>
+CatalogCodec::fromLocalResources(const LocalCatalog &catalog) {
+  std::vector<Resource> converted;
+  converted.reserve(catalog.resources.size());
+  for (const auto &info : catalog.resources) {
+    converted.push_back(Resource{.name = info->name, .size = info->size});
+  }
+  return converted;
+}
+
+std::vector<Resource>
+CatalogCodec::fromLocalResources(const LocalResourceManager &manager) {
+  return fromLocalResources(*manager.getSnapshot());
+}
+
+void CatalogCodec::appendEntry(std::vector<uint8_t> &buffer,
+                               const Resource &resource) {
+  uint32_t nameLength = resource.name.length();
+  buffer.insert(buffer.end(), reinterpret_cast<uint8_t *>(&nameLength),
+                reinterpret_cast<uint8_t *>(&nameLength) + sizeof(nameLength));
+  buffer.insert(buffer.end(), resource.name.begin(), resource.name.end());
+  buffer.insert(buffer.end(), reinterpret_cast<const uint8_t *>(&resource.size),
+                reinterpret_cast<const uint8_t *>(&resource.size) +
+                    sizeof(resource.size));
+}
+
+std::vector<uint8_t>
+CatalogCodec::serializeEntries(const std::vector<Resource> &resources) {
+  std::vector<uint8_t> buffer;
+  for (const auto &resource : resources) {
+    appendEntry(buffer, resource);
+  }
+  return buffer;
+}
+
+std::vector<Resource> CatalogCodec::parseEntries(const uint8_t *data,
+                                                 size_t size, uint32_t count) {
+  std::vector<Resource> resources;
+  size_t offset = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    Resource resource;
+
+    uint32_t nameLength;
+    if (size - offset < sizeof(uint32_t)) {
+      throw std::runtime_error("Truncated catalog entry");
+    }
+    std::memcpy(&nameLength, data + offset, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+
+    if (size - offset < static_cast<size_t>(nameLength) + sizeof(uint64_t)) {
+      throw std::runtime_error("Truncated catalog entry");
+    }
+    resource.name.assign(reinterpret_cast<const char *>(data + offset),
+                         nameLength);
+    offset += nameLength;
+
+    std::memcpy(&resource.size, data + offset, sizeof(uint64_t));
+    offset += sizeof(uint64_t);
+
+    resources.push_back(std::move(resource));
+  }
+  return resources;
+}
+
+} // namespace p2p
@@ -0,0 +1,113 @@
+#include "p2p-resource-sync/catalog_fetcher.hpp"
+#include "p2p-resource-sync/catalog_codec.hpp"
+#include "p2p-resource-sync/protocol.hpp"
+#include <cstring>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace p2p {
+
+CatalogFetcher::CatalogFetcher(uint32_t socket_timeout_ms)
+    : socket_timeout_ms_(socket_timeout_ms) {}
+
+int CatalogFetcher::connect_(const struct in_addr &host, uint16_t port) const {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock == -1) {
+    throw std::runtime_error("Error opening socket");
+  }
+
+  struct timeval timeout;
+  timeout.tv_sec = this->socket_timeout_ms_ / 1000;
+  timeout.tv_usec = (this->socket_timeout_ms_ % 1000) * 1000;
+  if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) <
+          0 ||
+      setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) <
+          0) {
+    close(sock);
+    throw std::runtime_error("Error setting socket timeout");
+  }
+
+  struct sockaddr_in server{};
+  server.sin_family = AF_INET;
+  server.sin_addr = host;
+  server.sin_port = htons(port);
+  if (connect(sock, reinterpret_cast<struct sockaddr *>(&server),
+              sizeof(server)) < 0) {
+    close(sock);
+    throw std::runtime_error("Error connecting to catalog endpoint: " +
+                             std::string(strerror(errno)));
+  }
+  return sock;
+}
+
+void CatalogFetcher::receiveExactly_(int sock, void *buffer,
+                                     size_t length) const {
+  size_t received_total = 0;
+  while (received_total < length) {
+    ssize_t received = recv(sock, static_cast<uint8_t *>(buffer) + received_total,
+                            length - received_total, 0);
+    if (received <= 0) {
+      throw std::runtime_error("Connection lost while receiving catalog");
+    }
+    received_total += received;
+  }
+}
+
+FetchedCatalog CatalogFetcher::fetch(const struct in_addr &host,
+                                     uint16_t port) const {
+  int sock = this->connect_(host, port);
+  std::vector<uint8_t> payload;
+  try {
+    ResourceRequest request{
+        .messageLength = sizeof(ResourceRequest),
+        .resourceNameLength = protocol::CATALOG_REQUEST_NAME_LENGTH,
+        .offset = 0};
+    if (send(sock, &request, sizeof(request), 0) !=
+        static_cast<ssize_t>(sizeof(request))) {
+      throw std::runtime_error("Failed to send catalog request");
+    }
+
+    uint8_t status;
+    this->receiveExactly_(sock, &status, sizeof(status));
+    if (status == 0) {
+      throw std::runtime_error("Node refused catalog request");
+    }
+
+    uint64_t payload_length;
+    this->receiveExactly_(sock, &payload_length, sizeof(payload_length));
+    if (payload_length < sizeof(uint64_t) + sizeof(uint32_t) ||
+        payload_length > constants::catalog_fetcher::MAX_CATALOG_SIZE) {
+      throw std::runtime_error("Invalid catalog length");
+    }
+
+    payload.resize(payload_length);
+    this->receiveExactly_(sock, payload.data(), payload.size());
+  } catch (const std::exception &) {
+    close(sock);
+    throw;
+  }
+  close(sock);
+
+  // Payload layout: digest (uint64), resourceCount (uint32), entries
+  FetchedCatalog catalog;
+  uint32_t resource_count;
+  std::memcpy(&catalog.digest, payload.data(), sizeof(uint64_t));
+  std::memcpy(&resource_count, payload.data() + sizeof(uint64_t),
+              sizeof(uint32_t));
+
+  const uint8_t *entries = payload.data() + sizeof(uint64_t) + sizeof(uint32_t);
+  size_t entries_size = payload.size() - sizeof(uint64_t) - sizeof(uint32_t);
+  if (CatalogCodec::digest(entries, entries_size) != catalog.digest) {
+    throw std::runtime_error("Catalog digest mismatch");
+  }
+  catalog.resources =
+      CatalogCodec::parseEntries(entries, entries_size, resource_count);
+  return catalog;
+}
+
+} // namespace p2p
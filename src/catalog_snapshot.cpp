@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <p2p-resource-sync/catalog_snapshot.hpp>
+#include <p2p-resource-sync/constants.hpp>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace p2p {
+
+struct CatalogSnapshotFile::Header {
+  uint32_t magic;
+  uint32_t formatVersion;
+  int64_t savedAt;
+  uint64_t nodeCount;
+  uint64_t entryCount;
+  uint64_t nameCount;
+  uint64_t nameBytes;
+};
+
+struct CatalogSnapshotFile::NodeRecord {
+  uint32_t address;
+  uint16_t port;
+  uint8_t hasDigest;
+  uint8_t reserved;
+  uint32_t entryCount;
+  uint32_t reserved2;
+  uint64_t firstEntry;
+  uint64_t digest;
+  int64_t lastSeen;
+};
+
+struct CatalogSnapshotFile::NameRecord {
+  uint64_t offset;
+  uint32_t length;
+  uint32_t reserved;
+};
+
+namespace {
+bool addressLess(uint32_t address_a, uint16_t port_a, uint32_t address_b,
+                 uint16_t port_b) {
+  if (address_a != address_b) {
+    return address_a < address_b;
+  }
+  return port_a < port_b;
+}
+
+template <typename T>
+void appendRecords(std::vector<uint8_t> &buffer, const std::vector<T> &records) {
+  auto bytes = reinterpret_cast<const uint8_t *>(records.data());
+  buffer.insert(buffer.end(), bytes, bytes + records.size() * sizeof(T));
+}
+} // namespace
+
+CatalogSnapshotFile::CatalogSnapshotFile(const std::filesystem::path &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open catalog snapshot: " +
+                             std::string(strerror(errno)));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    close(fd);
+    throw std::runtime_error("Failed to stat catalog snapshot: " +
+                             std::string(strerror(errno)));
+  }
+  this->size_ = static_cast<size_t>(file_stat.st_size);
+  if (this->size_ < sizeof(Header)) {
+    close(fd);
+    throw std::runtime_error("Catalog snapshot is truncated");
+  }
+
+  void *mapping = mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Failed to map catalog snapshot: " +
+                             std::string(strerror(errno)));
+  }
+  this->data_ = static_cast<const uint8_t *>(mapping);
+
+  try {
+    this->validate_();
+  } catch (...) {
+    munmap(const_cast<uint8_t *>(this->data_), this->size_);
+    throw;
+  }
+}
+
+CatalogSnapshotFile::~CatalogSnapshotFile() {
+  munmap(const_cast<uint8_t *>(this->data_), this->size_);
+}
+
+void CatalogSnapshotFile::write(const std::filesystem::path &path,
+                                std::vector<NodeToSave> nodes,
+                                std::chrono::system_clock::time_point saved_at) {
+  std::ranges::sort(nodes, [](const NodeToSave &a, const NodeToSave &b) {
+    return addressLess(a.address.sin_addr.s_addr, a.address.sin_port,
+                       b.address.sin_addr.s_addr, b.address.sin_port);
+  });
+
+  std::vector<NodeRecord> node_records;
+  std::vector<Entry> entry_records;
+  std::vector<NameRecord> name_records;
+  std::string name_bytes;
+  std::unordered_map<std::string_view, uint32_t> name_ids;
+  node_records.reserve(nodes.size());
+
+  for (const auto &node : nodes) {
+    node_records.push_back(NodeRecord{
+        .address = node.address.sin_addr.s_addr,
+        .port = node.address.sin_port,
+        .hasDigest = node.catalogDigest.has_value(),
+        .reserved = 0,
+        .entryCount = static_cast<uint32_t>(node.catalog->size()),
+        .reserved2 = 0,
+        .firstEntry = entry_records.size(),
+        .digest = node.catalogDigest.value_or(0),
+        .lastSeen = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        node.lastSeen.time_since_epoch())
+                        .count()});
+    for (const auto &entry : node.catalog->entries()) {
+      auto name = node.catalog->name(entry);
+      auto [id_it, inserted] = name_ids.try_emplace(
+          name, static_cast<uint32_t>(name_records.size()));
+      if (inserted) {
+        name_records.push_back(NameRecord{.offset = name_bytes.size(),
+                                          .length =
+                                              static_cast<uint32_t>(name.size()),
+                                          .reserved = 0});
+        name_bytes.append(name);
+      }
+      entry_records.push_back(Entry{.nameId = id_it->second, .size = entry.size});
+    }
+  }
+
+  Header header{.magic = constants::catalog_snapshot::FILE_MAGIC,
+                .formatVersion = constants::catalog_snapshot::FORMAT_VERSION,
+                .savedAt = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               saved_at.time_since_epoch())
+                               .count(),
+                .nodeCount = node_records.size(),
+                .entryCount = entry_records.size(),
+                .nameCount = name_records.size(),
+                .nameBytes = name_bytes.size()};
+  std::vector<uint8_t> buffer;
+  buffer.reserve(sizeof(header) + node_records.size() * sizeof(NodeRecord) +
+                 name_records.size() * sizeof(NameRecord) +
+                 entry_records.size() * sizeof(Entry) + name_bytes.size());
+  auto header_bytes = reinterpret_cast<const uint8_t *>(&header);
+  buffer.insert(buffer.end(), header_bytes, header_bytes + sizeof(header));
+  appendRecords(buffer, node_records);
+  appendRecords(buffer, name_records);
+  appendRecords(buffer, entry_records);
+  buffer.insert(buffer.end(), name_bytes.begin(), name_bytes.end());
+
+  // Written aside and renamed so readers never see a partial file
+  auto temporary_path = path;
+  temporary_path += ".tmp";
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    if (!file) {
+      throw std::runtime_error("Failed to write catalog snapshot: " +
+                               temporary_path.string());
+    }
+  }
+  std::filesystem::rename(temporary_path, path);
+}
+
+std::chrono::system_clock::time_point CatalogSnapshotFile::savedAt() const {
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::nanoseconds(this->header_().savedAt)));
+}
+
+size_t CatalogSnapshotFile::nodeCount() const {
+  return this->header_().nodeCount;
+}
+
+CatalogSnapshotFile::Node CatalogSnapshotFile::node(size_t position) const {
+  const auto &record = this->nodeRecords_()[position];
+  Node node{.address = {},
+            .lastSeen = std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(record.lastSeen))),
+            .catalogDigest = std::nullopt,
+            .entries = std::span<const Entry>(
+                this->entryRecords_() + record.firstEntry, record.entryCount)};
+  node.address.sin_family = AF_INET;
+  node.address.sin_addr.s_addr = record.address;
+  node.address.sin_port = record.port;
+  if (record.hasDigest) {
+    node.catalogDigest = record.digest;
+  }
+  return node;
+}
+
+std::optional<CatalogSnapshotFile::Node>
+CatalogSnapshotFile::findNode(const struct sockaddr_in &address) const {
+  const auto *begin = this->nodeRecords_();
+  const auto *end = begin + this->nodeCount();
+  const auto *found = std::lower_bound(
+      begin, end, address, [](const NodeRecord &record, const auto &key) {
+        return addressLess(record.address, record.port, key.sin_addr.s_addr,
+                           key.sin_port);
+      });
+  if (found == end || found->address != address.sin_addr.s_addr ||
+      found->port != address.sin_port) {
+    return std::nullopt;
+  }
+  return this->node(found - begin);
+}
+
+std::string_view CatalogSnapshotFile::name(uint32_t name_id) const {
+  const auto &record = this->nameRecords_()[name_id];
+  return std::string_view(this->nameBytes_() + record.offset, record.length);
+}
+
+void CatalogSnapshotFile::validate_() const {
+  // Records are read in place from the mapping, so their layout is the format
+  static_assert(sizeof(Header) == 48);
+  static_assert(sizeof(NodeRecord) == 40);
+  static_assert(sizeof(Entry) == 12);
+  static_assert(sizeof(NameRecord) == 16);
+
+  const auto &header = this->header_();
+  if (header.magic != constants::catalog_snapshot::FILE_MAGIC ||
+      header.formatVersion != constants::catalog_snapshot::FORMAT_VERSION) {
+    throw std::runtime_error("Not a catalog snapshot of a supported version");
+  }
+
+  // Section sizes are checked one by one so that none of them can overflow
+  size_t remaining = this->size_ - sizeof(Header);
+  auto take = [&remaining](uint64_t count, size_t record_size) {
+    if (count > remaining / record_size) {
+      throw std::runtime_error("Catalog snapshot is truncated");
+    }
+    remaining -= count * record_size;
+  };
+  take(header.nodeCount, sizeof(NodeRecord));
+  take(header.nameCount, sizeof(NameRecord));
+  take(header.entryCount, sizeof(Entry));
+  take(header.nameBytes, 1);
+  if (remaining != 0) {
+    throw std::runtime_error("Catalog snapshot has trailing data");
+  }
+
+  const auto *nodes = this->nodeRecords_();
+  for (uint64_t i = 0; i < header.nodeCount; ++i) {
+    if (nodes[i].firstEntry > header.entryCount ||
+        nodes[i].entryCount > header.entryCount - nodes[i].firstEntry) {
+      throw std::runtime_error("Catalog snapshot node out of range");
+    }
+    if (i > 0 && !addressLess(nodes[i - 1].address, nodes[i - 1].port,
+                              nodes[i].address, nodes[i].port)) {
+      throw std::runtime_error("Catalog snapshot nodes are not sorted");
+    }
+  }
+  const auto *entries = this->entryRecords_();
+  for (uint64_t i = 0; i < header.entryCount; ++i) {
+    if (entries[i].nameId >= header.nameCount) {
+      throw std::runtime_error("Catalog snapshot entry out of range");
+    }
+  }
+  const auto *names = this->nameRecords_();
+  for (uint64_t i = 0; i < header.nameCount; ++i) {
+    if (names[i].offset > header.nameBytes ||
+        names[i].length > header.nameBytes - names[i].offset) {
+      throw std::runtime_error("Catalog snapshot name out of range");
+    }
+  }
+}
+
+const CatalogSnapshotFile::Header &CatalogSnapshotFile::header_() const {
+  return *reinterpret_cast<const Header *>(this->data_);
+}
+
+const CatalogSnapshotFile::NodeRecord *
+CatalogSnapshotFile::nodeRecords_() const {
+  return reinterpret_cast<const NodeRecord *>(this->data_ + sizeof(Header));
+}
+
+const CatalogSnapshotFile::NameRecord *
+CatalogSnapshotFile::nameRecords_() const {
+  return reinterpret_cast<const NameRecord *>(nodeRecords_() +
+                                              this->header_().nodeCount);
+}
+
+const CatalogSnapshotFile::Entry *CatalogSnapshotFile::entryRecords_() const {
+  return reinterpret_cast<const Entry *>(nameRecords_() +
+                                         this->header_().nameCount);
+}
+
+const char *CatalogSnapshotFile::nameBytes_() const {
+  return reinterpret_cast<const char *>(entryRecords_() +
+                                        this->header_().entryCount);
+}
+
+} // namespace p2p
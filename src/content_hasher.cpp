@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <p2p-resource-sync/content_hasher.hpp>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace p2p {
+
+namespace {
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t read64(const uint8_t *bytes) {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint32_t read32(const uint8_t *bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint64_t mixLane(uint64_t accumulator, uint64_t input) {
+  accumulator += input * PRIME64_2;
+  return std::rotl(accumulator, 31) * PRIME64_1;
+}
+
+uint64_t mergeLane(uint64_t accumulator, uint64_t value) {
+  accumulator ^= mixLane(0, value);
+  return accumulator * PRIME64_1 + PRIME64_4;
+}
+} // namespace
+
+// Shared by the tasks hashing the chunks of one file
+struct ContentHasher::Job {
+  int fd;
+  uint64_t size;
+  std::vector<uint64_t> chunk_hashes;
+  std::atomic<uint64_t> remaining;
+  std::atomic<bool> failed{false};
+  Callback on_done;
+
+  ~Job() { close(this->fd); }
+};
+
+ContentHasher::ContentHasher(size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(1U, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < thread_count; ++i) {
+    this->workers_.emplace_back([this]() { this->work_(); });
+  }
+};
+
+ContentHasher::~ContentHasher() {
+  {
+    std::lock_guard lock(this->mutex_);
+    this->stopping_ = true;
+    this->tasks_.clear();
+  }
+  this->tasks_available_.notify_all();
+  this->workers_.clear();
+};
+
+void ContentHasher::hashFile(const std::string &path, Callback on_done) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat file_stat;
+  if (fd < 0 || fstat(fd, &file_stat) < 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    on_done(std::nullopt);
+    return;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  auto job = std::make_shared<Job>();
+  job->fd = fd;
+  job->size = static_cast<uint64_t>(file_stat.st_size);
+  uint64_t chunks = (job->size + constants::content_hash::CHUNK_SIZE - 1) /
+                    constants::content_hash::CHUNK_SIZE;
+  if (chunks == 0) {
+    on_done(hashBytes(nullptr, 0, 0));
+    return;
+  }
+  job->chunk_hashes.resize(chunks);
+  job->remaining = chunks;
+  job->on_done = std::move(on_done);
+
+  {
+    std::lock_guard lock(this->mutex_);
+    for (uint64_t chunk = 0; chunk < chunks; ++chunk) {
+      this->tasks_.push_back(Task{.job = job, .chunk = chunk});
+    }
+  }
+  this->tasks_available_.notify_all();
+};
+
+uint64_t ContentHasher::hashBytes(const void *data, size_t length,
+                                  uint64_t seed) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  const uint8_t *end = bytes + length;
+  uint64_t hash;
+
+  if (length >= 32) {
+    // Four independent lanes, so consecutive multiplies do not wait on
+    // each other
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    const uint8_t *limit = end - 32;
+    do {
+      v1 = mixLane(v1, read64(bytes));
+      v2 = mixLane(v2, read64(bytes + 8));
+      v3 = mixLane(v3, read64(bytes + 16));
+      v4 = mixLane(v4, read64(bytes + 24));
+      bytes += 32;
+    } while (bytes <= limit);
+
+    hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) +
+           std::rotl(v4, 18);
+    hash = mergeLane(hash, v1);
+    hash = mergeLane(hash, v2);
+    hash = mergeLane(hash, v3);
+    hash = mergeLane(hash, v4);
+  } else {
+    hash = seed + PRIME64_5;
+  }
+  hash += static_cast<uint64_t>(length);
+
+  for (; bytes + 8 <= end; bytes += 8) {
+    hash ^= mixLane(0, read64(bytes));
+    hash = std::rotl(hash, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (bytes + 4 <= end) {
+    hash ^= static_cast<uint64_t>(read32(bytes)) * PRIME64_1;
+    hash = std::rotl(hash, 23) * PRIME64_2 + PRIME64_3;
+    bytes += 4;
+  }
+  for (; bytes < end; ++bytes) {
+    hash ^= *bytes * PRIME64_5;
+    hash = std::rotl(hash, 11) * PRIME64_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+};
+
+void ContentHasher::work_() {
+  std::vector<char> buffer(constants::content_hash::CHUNK_SIZE);
+  while (true) {
+    Task task;
+    {
+      std::unique_lock lock(this->mutex_);
+      this->tasks_available_.wait(lock, [this]() {
+        return this->stopping_ || !this->tasks_.empty();
+      });
+      if (this->stopping_) {
+        return;
+      }
+      task = std::move(this->tasks_.front());
+      this->tasks_.pop_front();
+    }
+
+    auto &job = *task.job;
+    if (!job.failed) {
+      hashChunk_(job, task.chunk, buffer);
+    }
+    if (job.remaining.fetch_sub(1) != 1) {
+      continue;
+    }
+    if (job.failed) {
+      job.on_done(std::nullopt);
+    } else {
+      job.on_done(hashBytes(job.chunk_hashes.data(),
+                            job.chunk_hashes.size() * sizeof(uint64_t),
+                            job.size));
+    }
+  }
+};
+
+void ContentHasher::hashChunk_(Job &job, uint64_t chunk,
+                               std::vector<char> &buffer) {
+  uint64_t offset = chunk * constants::content_hash::CHUNK_SIZE;
+  size_t length = static_cast<size_t>(std::min<uint64_t>(
+      constants::content_hash::CHUNK_SIZE, job.size - offset));
+  size_t received = 0;
+  while (received < length) {
+    ssize_t result = pread(job.fd, buffer.data() + received, length - received,
+                           static_cast<off_t>(offset + received));
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      // Also when the file shrank meanwhile
+      job.failed = true;
+      return;
+    }
+    received += static_cast<size_t>(result);
+  }
+  job.chunk_hashes[chunk] = hashBytes(buffer.data(), length, chunk);
+};
+
+} // namespace p2p
@@ -0,0 +1,543 @@
+#include "p2p-resource-sync/dht_node.hpp"
+#include "p2p-resource-sync/catalog_codec.hpp"
+#include "p2p-resource-sync/logger.hpp"
+#include <algorithm>
+#include <bit>
+#include <future>
+#include <set>
+#include <string>
+
+namespace p2p {
+
+namespace {
+bool sameAddress(const struct sockaddr_in &a, const struct sockaddr_in &b) {
+  return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+// Records published with INADDR_ANY are served by the host they came from
+ProviderRecord resolveProvider(ProviderRecord provider,
+                               const struct sockaddr_in &origin) {
+  if (provider.address.sin_addr.s_addr == INADDR_ANY) {
+    provider.address.sin_addr = origin.sin_addr;
+  }
+  return provider;
+}
+} // namespace
+
+DhtNode::DhtNode(uint64_t node_id, std::shared_ptr<DhtTransport> transport,
+                 DhtConfig config)
+    : node_id_(node_id), transport_(std::move(transport)), config_(config) {
+  this->transport_->setRequestHandler(
+      [this](const struct sockaddr_in &from, const DhtMessage &request) {
+        return this->handleRequest_(from, request);
+      });
+}
+
+DhtNode::~DhtNode() {
+  if (this->local_manager_) {
+    this->local_manager_->removeChangeListener(this->change_listener_id_);
+  }
+  this->transport_->setRequestHandler(nullptr);
+}
+
+uint64_t DhtNode::keyFor(const std::string &resource_name) {
+  uint64_t key = CatalogCodec::digest(
+      reinterpret_cast<const uint8_t *>(resource_name.data()),
+      resource_name.size());
+  // FNV-1a leaves similar names close together; the MurmurHash3 finalizer
+  // spreads them over the whole id space
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+bool DhtNode::bootstrap(const std::vector<struct sockaddr_in> &seeds) {
+  bool joined = false;
+  for (const auto &seed : seeds) {
+    auto response = this->transport_->call(
+        seed, DhtMessage{.type = DhtMessageType::PING,
+                         .senderId = this->node_id_,
+                         .key = 0,
+                         .resourceName = {},
+                         .contacts = {},
+                         .providers = {}});
+    if (response && response->senderId != this->node_id_) {
+      std::lock_guard lock(this->mutex_);
+      this->addContact_(DhtContact{.id = response->senderId, .address = seed});
+      joined = true;
+    }
+  }
+  if (joined) {
+    // Looking up our own id fills the buckets near us and announces us to
+    // the nodes that should know about us
+    this->lookup_(this->node_id_, DhtMessageType::FIND_NODE, "");
+  }
+  return joined;
+}
+
+void DhtNode::publish(const std::string &resource_name, uint64_t size,
+                      const struct sockaddr_in &provider) {
+  PublishedResource resource{.size = size,
+                             .provider = provider,
+                             .publishedAt = std::chrono::steady_clock::now(),
+                             .due = false};
+  {
+    std::lock_guard lock(this->mutex_);
+    this->published_[resource_name] = resource;
+  }
+  this->publishRecord_(resource_name, resource);
+}
+
+void DhtNode::unpublish(const std::string &resource_name) {
+  std::lock_guard lock(this->mutex_);
+  this->published_.erase(resource_name);
+}
+
+void DhtNode::publishFrom(std::shared_ptr<LocalResourceManager> local_manager,
+                          const struct sockaddr_in &provider) {
+  this->local_manager_ = std::move(local_manager);
+  this->local_provider_ = provider;
+  this->change_listener_id_ =
+      this->local_manager_->addChangeListener([this](uint64_t) {
+        std::lock_guard lock(this->wake_mutex_);
+        this->local_changed_ = true;
+        this->wake_cv_.notify_one();
+      });
+  std::lock_guard lock(this->wake_mutex_);
+  this->local_changed_ = true;
+}
+
+std::vector<ProviderRecord>
+DhtNode::findProviders(const std::string &resource_name) {
+  uint64_t key = keyFor(resource_name);
+  {
+    std::lock_guard lock(this->mutex_);
+    auto now = std::chrono::steady_clock::now();
+    auto cached = this->holder_cache_.find(resource_name);
+    if (cached != this->holder_cache_.end() && cached->second.expiresAt > now) {
+      return cached->second.providers;
+    }
+    auto stored = this->storedProviders_(key, resource_name);
+    if (!stored.empty()) {
+      return stored;
+    }
+  }
+
+  auto result =
+      this->lookup_(key, DhtMessageType::FIND_PROVIDERS, resource_name);
+
+  std::lock_guard lock(this->mutex_);
+  if (!result.providers.empty()) {
+    if (this->holder_cache_.size() >= constants::dht::MAX_CACHED_LOOKUPS) {
+      auto now = std::chrono::steady_clock::now();
+      std::erase_if(this->holder_cache_, [now](const auto &entry) {
+        return entry.second.expiresAt <= now;
+      });
+      if (this->holder_cache_.size() >= constants::dht::MAX_CACHED_LOOKUPS) {
+        this->holder_cache_.erase(this->holder_cache_.begin());
+      }
+    }
+    this->holder_cache_[resource_name] = CachedHolders{
+        .providers = result.providers,
+        .expiresAt =
+            std::chrono::steady_clock::now() + this->config_.holderCacheTtl};
+  }
+  return result.providers;
+}
+
+void DhtNode::refresh() {
+  this->syncPublished_();
+
+  auto now = std::chrono::steady_clock::now();
+  std::vector<std::pair<std::string, PublishedResource>> due;
+  {
+    std::lock_guard lock(this->mutex_);
+    for (auto &[name, resource] : this->published_) {
+      if (resource.due ||
+          now - resource.publishedAt >= this->config_.republishInterval) {
+        resource.due = false;
+        resource.publishedAt = now;
+        due.emplace_back(name, resource);
+      }
+    }
+  }
+  for (const auto &[name, resource] : due) {
+    this->publishRecord_(name, resource);
+  }
+
+  std::lock_guard lock(this->mutex_);
+  for (auto it = this->providers_.begin(); it != this->providers_.end();) {
+    auto &by_name = it->second;
+    for (auto name_it = by_name.begin(); name_it != by_name.end();) {
+      std::erase_if(name_it->second, [now](const StoredProvider &provider) {
+        return provider.expiresAt <= now;
+      });
+      name_it = name_it->second.empty() ? by_name.erase(name_it) : ++name_it;
+    }
+    it = by_name.empty() ? this->providers_.erase(it) : ++it;
+  }
+  std::erase_if(this->holder_cache_, [now](const auto &entry) {
+    return entry.second.expiresAt <= now;
+  });
+}
+
+void DhtNode::run() {
+  this->running_ = true;
+  while (this->running_) {
+    try {
+      this->refresh();
+    } catch (const std::exception &e) {
+      Logger::log<LogLevel::ERROR>("DHT maintenance failed: {}", e.what());
+    }
+    std::unique_lock lock(this->wake_mutex_);
+    this->wake_cv_.wait_for(lock, constants::dht::MAINTENANCE_INTERVAL, [this]() {
+      return !this->running_ || this->local_changed_;
+    });
+  }
+}
+
+void DhtNode::stop() {
+  std::lock_guard lock(this->wake_mutex_);
+  this->running_ = false;
+  this->wake_cv_.notify_all();
+}
+
+size_t DhtNode::getRoutingTableSize() const {
+  std::lock_guard lock(this->mutex_);
+  size_t size = 0;
+  for (const auto &bucket : this->buckets_) {
+    size += bucket.size();
+  }
+  return size;
+}
+
+size_t DhtNode::getStoredProviderCount() const {
+  std::lock_guard lock(this->mutex_);
+  size_t count = 0;
+  for (const auto &[key, by_name] : this->providers_) {
+    for (const auto &[name, providers] : by_name) {
+      count += providers.size();
+    }
+  }
+  return count;
+}
+
+void DhtNode::syncPublished_() {
+  {
+    std::lock_guard lock(this->wake_mutex_);
+    if (!this->local_changed_ || !this->local_manager_) {
+      return;
+    }
+    this->local_changed_ = false;
+  }
+
+  auto resources =
+      CatalogCodec::fromLocalResources(*this->local_manager_);
+  std::lock_guard lock(this->mutex_);
+  // Both are in name order, so one merge pass drops, adds and updates
+  auto it = this->published_.begin();
+  for (const auto &resource : resources) {
+    while (it != this->published_.end() && it->first < resource.name) {
+      it = this->published_.erase(it);
+    }
+    if (it == this->published_.end() || it->first != resource.name) {
+      this->published_.emplace_hint(
+          it, resource.name,
+          PublishedResource{.size = resource.size,
+                            .provider = this->local_provider_,
+                            .publishedAt = {},
+                            .due = true});
+      continue;
+    }
+    if (it->second.size != resource.size) {
+      it->second.size = resource.size;
+      it->second.due = true;
+    }
+    ++it;
+  }
+  this->published_.erase(it, this->published_.end());
+}
+
+void DhtNode::publishRecord_(const std::string &resource_name,
+                             const PublishedResource &resource) {
+  uint64_t key = keyFor(resource_name);
+  ProviderRecord record{.address = resource.provider, .size = resource.size};
+  auto result = this->lookup_(key, DhtMessageType::FIND_NODE, "");
+
+  // Keep a replica ourselves if we are among the closest nodes
+  size_t closer = std::ranges::count_if(result.closest, [&](const auto &c) {
+    return (c.id ^ key) < (this->node_id_ ^ key);
+  });
+  if (closer < this->config_.bucketSize) {
+    std::lock_guard lock(this->mutex_);
+    this->storeProviders_(key, resource_name, {record});
+  }
+
+  size_t stored = 0;
+  for (const auto &contact : result.closest) {
+    if (this->call_(contact, DhtMessage{.type = DhtMessageType::ADD_PROVIDER,
+                                        .senderId = this->node_id_,
+                                        .key = key,
+                                        .resourceName = resource_name,
+                                        .contacts = {},
+                                        .providers = {record}})) {
+      stored++;
+    }
+  }
+  if (stored == 0 && !result.closest.empty()) {
+    Logger::log<LogLevel::ERROR>("Failed to publish provider record for {}",
+                                 resource_name);
+  }
+}
+
+DhtMessage DhtNode::handleRequest_(const struct sockaddr_in &from,
+                                   const DhtMessage &request) {
+  DhtMessage response{.type = DhtMessageType::RESPONSE,
+                      .senderId = this->node_id_,
+                      .key = request.key,
+                      .resourceName = {},
+                      .contacts = {},
+                      .providers = {}};
+  std::lock_guard lock(this->mutex_);
+  if (request.senderId != this->node_id_) {
+    this->addContact_(DhtContact{.id = request.senderId, .address = from});
+  }
+
+  switch (request.type) {
+  case DhtMessageType::FIND_NODE:
+    response.contacts =
+        this->closestContacts_(request.key, this->config_.bucketSize);
+    break;
+  case DhtMessageType::FIND_PROVIDERS:
+    response.providers =
+        this->storedProviders_(request.key, request.resourceName);
+    if (response.providers.size() >
+        constants::dht::MAX_PROVIDERS_PER_RESPONSE) {
+      response.providers.resize(constants::dht::MAX_PROVIDERS_PER_RESPONSE);
+    }
+    response.contacts =
+        this->closestContacts_(request.key, this->config_.bucketSize);
+    break;
+  case DhtMessageType::ADD_PROVIDER: {
+    std::vector<ProviderRecord> providers;
+    for (const auto &provider : request.providers) {
+      providers.push_back(resolveProvider(provider, from));
+    }
+    this->storeProviders_(request.key, request.resourceName, providers);
+    break;
+  }
+  case DhtMessageType::PING:
+  case DhtMessageType::RESPONSE:
+    break;
+  }
+  return response;
+}
+
+DhtNode::LookupResult DhtNode::lookup_(uint64_t key, DhtMessageType type,
+                                       const std::string &resource_name) {
+  struct Candidate {
+    DhtContact contact;
+    bool queried;
+    bool responded;
+  };
+  auto distance = [key](const Candidate &candidate) {
+    return candidate.contact.id ^ key;
+  };
+
+  std::vector<Candidate> shortlist;
+  {
+    std::lock_guard lock(this->mutex_);
+    for (const auto &contact :
+         this->closestContacts_(key, this->config_.bucketSize)) {
+      shortlist.push_back(
+          Candidate{.contact = contact, .queried = false, .responded = false});
+    }
+  }
+  std::set<uint64_t> seen;
+  for (const auto &candidate : shortlist) {
+    seen.insert(candidate.contact.id);
+  }
+
+  LookupResult result;
+  while (true) {
+    std::ranges::sort(shortlist, {}, distance);
+    if (shortlist.size() > this->config_.bucketSize) {
+      shortlist.resize(this->config_.bucketSize);
+    }
+
+    // The lookup ends once the k closest known nodes have all been queried
+    std::vector<size_t> round;
+    for (size_t i = 0; i < shortlist.size() &&
+                       round.size() < this->config_.lookupParallelism;
+         ++i) {
+      if (!shortlist[i].queried) {
+        shortlist[i].queried = true;
+        round.push_back(i);
+      }
+    }
+    if (round.empty()) {
+      break;
+    }
+
+    std::vector<std::future<std::optional<DhtMessage>>> calls;
+    for (size_t index : round) {
+      calls.push_back(std::async(
+          std::launch::async,
+          [this, contact = shortlist[index].contact, key, type,
+           &resource_name]() {
+            return this->call_(contact, DhtMessage{.type = type,
+                                                   .senderId = this->node_id_,
+                                                   .key = key,
+                                                   .resourceName =
+                                                       resource_name,
+                                                   .contacts = {},
+                                                   .providers = {}});
+          }));
+    }
+
+    std::vector<Candidate> discovered;
+    for (size_t i = 0; i < round.size(); ++i) {
+      auto &candidate = shortlist[round[i]];
+      auto response = calls[i].get();
+      if (!response) {
+        continue;
+      }
+      candidate.responded = true;
+      for (const auto &provider : response->providers) {
+        auto resolved = resolveProvider(provider, candidate.contact.address);
+        if (std::ranges::none_of(result.providers, [&](const auto &known) {
+              return sameAddress(known.address, resolved.address);
+            })) {
+          result.providers.push_back(resolved);
+        }
+      }
+      for (const auto &contact : response->contacts) {
+        if (contact.id != this->node_id_ && seen.insert(contact.id).second) {
+          discovered.push_back(Candidate{
+              .contact = contact, .queried = false, .responded = false});
+        }
+      }
+    }
+
+    // Unresponsive nodes drop out of the shortlist
+    std::erase_if(shortlist, [](const Candidate &candidate) {
+      return candidate.queried && !candidate.responded;
+    });
+    shortlist.insert(shortlist.end(), discovered.begin(), discovered.end());
+
+    if (type == DhtMessageType::FIND_PROVIDERS && !result.providers.empty()) {
+      break;
+    }
+  }
+
+  std::ranges::sort(shortlist, {}, distance);
+  for (const auto &candidate : shortlist) {
+    if (candidate.responded) {
+      result.closest.push_back(candidate.contact);
+    }
+  }
+  return result;
+}
+
+std::optional<DhtMessage> DhtNode::call_(const DhtContact &contact,
+                                         DhtMessage request) {
+  request.senderId = this->node_id_;
+  auto response = this->transport_->call(contact.address, request);
+  std::lock_guard lock(this->mutex_);
+  if (response) {
+    this->addContact_(
+        DhtContact{.id = response->senderId, .address = contact.address});
+  } else {
+    this->removeContact_(contact.id);
+  }
+  return response;
+}
+
+size_t DhtNode::bucketIndex_(uint64_t id) const {
+  return 63 - std::countl_zero(this->node_id_ ^ id);
+}
+
+void DhtNode::addContact_(const DhtContact &contact) {
+  if (contact.id == this->node_id_) {
+    return;
+  }
+  auto &bucket = this->buckets_[this->bucketIndex_(contact.id)];
+  auto it = std::ranges::find_if(
+      bucket, [&contact](const DhtContact &c) { return c.id == contact.id; });
+  if (it != bucket.end()) {
+    // Most recently seen contacts live at the back of the bucket
+    bucket.erase(it);
+    bucket.push_back(contact);
+  } else if (bucket.size() < this->config_.bucketSize) {
+    bucket.push_back(contact);
+  }
+  // Full buckets keep their long-lived contacts; failed ones are removed by
+  // call_, which makes room for newcomers
+}
+
+void DhtNode::removeContact_(uint64_t id) {
+  if (id == this->node_id_) {
+    return;
+  }
+  std::erase_if(this->buckets_[this->bucketIndex_(id)],
+                [id](const DhtContact &c) { return c.id == id; });
+}
+
+std::vector<DhtContact> DhtNode::closestContacts_(uint64_t key,
+                                                  size_t count) const {
+  std::vector<DhtContact> contacts;
+  for (const auto &bucket : this->buckets_) {
+    contacts.insert(contacts.end(), bucket.begin(), bucket.end());
+  }
+  count = std::min(count, contacts.size());
+  std::ranges::partial_sort(contacts, contacts.begin() + count, {},
+                            [key](const DhtContact &c) { return c.id ^ key; });
+  contacts.resize(count);
+  return contacts;
+}
+
+void DhtNode::storeProviders_(uint64_t key, const std::string &resource_name,
+                              const std::vector<ProviderRecord> &providers) {
+  auto expires_at = std::chrono::steady_clock::now() + this->config_.providerTtl;
+  auto &stored = this->providers_[key][resource_name];
+  for (const auto &provider : providers) {
+    auto it = std::ranges::find_if(stored, [&](const StoredProvider &s) {
+      return sameAddress(s.record.address, provider.address);
+    });
+    if (it != stored.end()) {
+      *it = StoredProvider{.record = provider, .expiresAt = expires_at};
+    } else {
+      stored.push_back(StoredProvider{.record = provider, .expiresAt = expires_at});
+    }
+  }
+  if (stored.size() > constants::dht::MAX_PROVIDERS_PER_RESPONSE) {
+    // Drop the records that were refreshed least recently
+    std::ranges::sort(stored, std::greater<>(), &StoredProvider::expiresAt);
+    stored.resize(constants::dht::MAX_PROVIDERS_PER_RESPONSE);
+  }
+}
+
+std::vector<ProviderRecord>
+DhtNode::storedProviders_(uint64_t key, const std::string &resource_name) {
+  std::vector<ProviderRecord> records;
+  auto it = this->providers_.find(key);
+  if (it == this->providers_.end()) {
+    return records;
+  }
+  auto name_it = it->second.find(resource_name);
+  if (name_it == it->second.end()) {
+    return records;
+  }
+  auto now = std::chrono::steady_clock::now();
+  for (const auto &provider : name_it->second) {
+    if (provider.expiresAt > now) {
+      records.push_back(provider.record);
+    }
+  }
+  return records;
+}
+
+} // namespace p2p
@@ -0,0 +1,327 @@
+#include "p2p-resource-sync/dht_transport.hpp"
+#include "p2p-resource-sync/logger.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace p2p {
+
+namespace {
+template <typename T> void append(std::vector<uint8_t> &buffer, T value) {
+  size_t offset = buffer.size();
+  buffer.resize(offset + sizeof(T));
+  std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+T read(const uint8_t *data, size_t size, size_t &offset) {
+  if (size - offset < sizeof(T)) {
+    throw std::runtime_error("Truncated DHT message");
+  }
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  offset += sizeof(T);
+  return value;
+}
+
+void appendAddress(std::vector<uint8_t> &buffer,
+                   const struct sockaddr_in &address) {
+  append<uint32_t>(buffer, address.sin_addr.s_addr);
+  append<uint16_t>(buffer, ntohs(address.sin_port));
+}
+
+struct sockaddr_in readAddress(const uint8_t *data, size_t size,
+                               size_t &offset) {
+  struct sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = read<uint32_t>(data, size, offset);
+  address.sin_port = htons(read<uint16_t>(data, size, offset));
+  return address;
+}
+
+std::pair<uint32_t, uint16_t> endpointKey(const struct sockaddr_in &address) {
+  return {address.sin_addr.s_addr, address.sin_port};
+}
+} // namespace
+
+class SimulatedDhtNetwork::Transport : public DhtTransport {
+public:
+  Transport(SimulatedDhtNetwork &network, std::shared_ptr<Endpoint> endpoint,
+            const struct sockaddr_in &address)
+      : network_(network), endpoint_(std::move(endpoint)), address_(address) {};
+
+  void setRequestHandler(RequestHandler handler) override {
+    std::lock_guard lock(this->endpoint_->mutex);
+    this->endpoint_->handler = std::move(handler);
+  }
+
+  std::optional<DhtMessage> call(const struct sockaddr_in &destination,
+                                 const DhtMessage &request) override {
+    {
+      std::lock_guard lock(this->endpoint_->mutex);
+      if (!this->endpoint_->online) {
+        return std::nullopt;
+      }
+    }
+    return this->network_.deliver_(this->address_, destination, request);
+  }
+
+  struct sockaddr_in localAddress() const override { return this->address_; }
+
+private:
+  SimulatedDhtNetwork &network_;
+  std::shared_ptr<Endpoint> endpoint_;
+  const struct sockaddr_in address_;
+};
+
+std::shared_ptr<DhtTransport>
+SimulatedDhtNetwork::createTransport(const struct sockaddr_in &address) {
+  auto endpoint = std::make_shared<Endpoint>();
+  std::lock_guard lock(this->mutex_);
+  if (!this->endpoints_.emplace(endpointKey(address), endpoint).second) {
+    throw std::runtime_error("Simulated DHT address already in use");
+  }
+  return std::make_shared<Transport>(*this, endpoint, address);
+}
+
+void SimulatedDhtNetwork::setOnline(const struct sockaddr_in &address,
+                                    bool online) {
+  std::shared_ptr<Endpoint> endpoint;
+  {
+    std::lock_guard lock(this->mutex_);
+    endpoint = this->endpoints_.at(endpointKey(address));
+  }
+  std::lock_guard lock(endpoint->mutex);
+  endpoint->online = online;
+}
+
+size_t SimulatedDhtNetwork::getMessageCount() const {
+  return this->message_count_;
+}
+
+std::optional<DhtMessage>
+SimulatedDhtNetwork::deliver_(const struct sockaddr_in &from,
+                              const struct sockaddr_in &to,
+                              const DhtMessage &request) {
+  std::shared_ptr<Endpoint> endpoint;
+  {
+    std::lock_guard lock(this->mutex_);
+    auto it = this->endpoints_.find(endpointKey(to));
+    if (it == this->endpoints_.end()) {
+      return std::nullopt;
+    }
+    endpoint = it->second;
+  }
+
+  this->message_count_++;
+  std::lock_guard lock(endpoint->mutex);
+  if (!endpoint->online || !endpoint->handler) {
+    return std::nullopt;
+  }
+  return endpoint->handler(from, request);
+}
+
+UdpDhtTransport::UdpDhtTransport(const std::string &bind_address,
+                                 uint16_t port,
+                                 std::chrono::milliseconds rpc_timeout)
+    : rpc_timeout_(rpc_timeout) {
+  this->local_address_ = {};
+  this->local_address_.sin_family = AF_INET;
+  this->local_address_.sin_port = htons(port);
+  if (inet_pton(AF_INET, bind_address.c_str(),
+                &this->local_address_.sin_addr) != 1) {
+    throw std::runtime_error("Invalid DHT bind address: " + bind_address);
+  }
+
+  this->socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (this->socket_ < 0) {
+    throw std::runtime_error("Failed to create socket: " +
+                             std::string(strerror(errno)));
+  }
+  if (bind(this->socket_,
+           reinterpret_cast<struct sockaddr *>(&this->local_address_),
+           sizeof(this->local_address_)) < 0) {
+    close(this->socket_);
+    throw std::runtime_error("Failed to bind DHT socket: " +
+                             std::string(strerror(errno)));
+  }
+}
+
+UdpDhtTransport::~UdpDhtTransport() { close(this->socket_); }
+
+void UdpDhtTransport::run() {
+  this->running_ = true;
+  std::vector<uint8_t> buffer(constants::dht::MAX_DATAGRAM_SIZE);
+
+  while (this->running_) {
+    struct pollfd descriptor{
+        .fd = this->socket_, .events = POLLIN, .revents = 0};
+    if (poll(&descriptor, 1,
+             constants::dht::RECEIVE_POLL_INTERVAL_MS) <= 0) {
+      continue;
+    }
+    struct sockaddr_in sender_addr;
+    socklen_t sender_addr_len = sizeof(sender_addr);
+    ssize_t received = recvfrom(
+        this->socket_, buffer.data(), buffer.size(), 0,
+        reinterpret_cast<struct sockaddr *>(&sender_addr), &sender_addr_len);
+    if (received > 0) {
+      this->handleDatagram_(buffer.data(), received, sender_addr);
+    }
+  }
+}
+
+void UdpDhtTransport::stop() { this->running_ = false; }
+
+void UdpDhtTransport::setRequestHandler(RequestHandler handler) {
+  std::lock_guard lock(this->handler_mutex_);
+  this->handler_ = std::move(handler);
+}
+
+struct sockaddr_in UdpDhtTransport::localAddress() const {
+  return this->local_address_;
+}
+
+std::optional<DhtMessage>
+UdpDhtTransport::call(const struct sockaddr_in &destination,
+                      const DhtMessage &request) {
+  std::unique_lock lock(this->calls_mutex_);
+  uint32_t nonce = this->next_nonce_++;
+  auto [slot, inserted] = this->pending_calls_.try_emplace(nonce);
+  lock.unlock();
+
+  auto datagram = serializeMessage(nonce, request);
+  if (sendto(this->socket_, datagram.data(), datagram.size(), 0,
+             reinterpret_cast<const struct sockaddr *>(&destination),
+             sizeof(destination)) == -1) {
+    Logger::log<LogLevel::ERROR>("Failed to send DHT request: {}",
+                                 strerror(errno));
+  }
+
+  lock.lock();
+  this->calls_cv_.wait_for(lock, this->rpc_timeout_,
+                           [&slot]() { return slot->second.has_value(); });
+  auto response = std::move(slot->second);
+  this->pending_calls_.erase(slot);
+  return response;
+}
+
+void UdpDhtTransport::handleDatagram_(const uint8_t *data, size_t size,
+                                      const struct sockaddr_in &sender_addr) {
+  std::pair<uint32_t, DhtMessage> parsed;
+  try {
+    parsed = parseMessage(data, size);
+  } catch (const std::exception &e) {
+    Logger::log<LogLevel::ERROR>("Invalid DHT message: {}", e.what());
+    return;
+  }
+  auto &[nonce, message] = parsed;
+
+  if (message.type == DhtMessageType::RESPONSE) {
+    std::lock_guard lock(this->calls_mutex_);
+    auto it = this->pending_calls_.find(nonce);
+    if (it != this->pending_calls_.end()) {
+      it->second = std::move(message);
+      this->calls_cv_.notify_all();
+    }
+    return;
+  }
+
+  DhtMessage response;
+  {
+    std::lock_guard lock(this->handler_mutex_);
+    if (!this->handler_) {
+      return;
+    }
+    response = this->handler_(sender_addr, message);
+  }
+  auto datagram = serializeMessage(nonce, response);
+  if (sendto(this->socket_, datagram.data(), datagram.size(), 0,
+             reinterpret_cast<const struct sockaddr *>(&sender_addr),
+             sizeof(sender_addr)) == -1) {
+    Logger::log<LogLevel::ERROR>("Failed to send DHT response: {}",
+                                 strerror(errno));
+  }
+}
+
+std::vector<uint8_t> UdpDhtTransport::serializeMessage(uint32_t nonce,
+                                                       const DhtMessage &message) {
+  // magic, nonce, type, senderId, key, name length and name, then the
+  // contacts (id and address) and providers (address and size)
+  constexpr size_t address_size = sizeof(uint32_t) + sizeof(uint16_t);
+  std::vector<uint8_t> buffer;
+  buffer.reserve(
+      2 * sizeof(uint32_t) + sizeof(uint8_t) + 2 * sizeof(uint64_t) +
+      sizeof(uint16_t) + message.resourceName.size() + sizeof(uint8_t) +
+      message.contacts.size() * (sizeof(uint64_t) + address_size) +
+      sizeof(uint8_t) +
+      message.providers.size() * (address_size + sizeof(uint64_t)));
+  append<uint32_t>(buffer, constants::dht::MESSAGE_MAGIC);
+  append<uint32_t>(buffer, nonce);
+  append<uint8_t>(buffer, static_cast<uint8_t>(message.type));
+  append<uint64_t>(buffer, message.senderId);
+  append<uint64_t>(buffer, message.key);
+  append<uint16_t>(buffer, static_cast<uint16_t>(message.resourceName.size()));
+  buffer.insert(buffer.end(), message.resourceName.begin(),
+                message.resourceName.end());
+  append<uint8_t>(buffer, static_cast<uint8_t>(message.contacts.size()));
+  for (const auto &contact : message.contacts) {
+    append<uint64_t>(buffer, contact.id);
+    appendAddress(buffer, contact.address);
+  }
+  append<uint8_t>(buffer, static_cast<uint8_t>(message.providers.size()));
+  for (const auto &provider : message.providers) {
+    appendAddress(buffer, provider.address);
+    append<uint64_t>(buffer, provider.size);
+  }
+  return buffer;
+}
+
+std::pair<uint32_t, DhtMessage>
+UdpDhtTransport::parseMessage(const uint8_t *data, size_t size) {
+  size_t offset = 0;
+  if (read<uint32_t>(data, size, offset) != constants::dht::MESSAGE_MAGIC) {
+    throw std::runtime_error("Not a DHT message");
+  }
+  uint32_t nonce = read<uint32_t>(data, size, offset);
+
+  DhtMessage message;
+  auto type = read<uint8_t>(data, size, offset);
+  if (type < static_cast<uint8_t>(DhtMessageType::PING) ||
+      type > static_cast<uint8_t>(DhtMessageType::RESPONSE)) {
+    throw std::runtime_error("Unknown DHT message type");
+  }
+  message.type = static_cast<DhtMessageType>(type);
+  message.senderId = read<uint64_t>(data, size, offset);
+  message.key = read<uint64_t>(data, size, offset);
+
+  auto name_length = read<uint16_t>(data, size, offset);
+  if (size - offset < name_length) {
+    throw std::runtime_error("Truncated DHT message");
+  }
+  message.resourceName.assign(reinterpret_cast<const char *>(data + offset),
+                              name_length);
+  offset += name_length;
+
+  auto contact_count = read<uint8_t>(data, size, offset);
+  for (uint8_t i = 0; i < contact_count; ++i) {
+    DhtContact contact;
+    contact.id = read<uint64_t>(data, size, offset);
+    contact.address = readAddress(data, size, offset);
+    message.contacts.push_back(contact);
+  }
+  auto provider_count = read<uint8_t>(data, size, offset);
+  for (uint8_t i = 0; i < provider_count; ++i) {
+    ProviderRecord provider;
+    provider.address = readAddress(data, size, offset);
+    provider.size = read<uint64_t>(data, size, offset);
+    message.providers.push_back(provider);
+  }
+  return {nonce, std::move(message)};
+}
+
+} // namespace p2p
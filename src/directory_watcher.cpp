@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <p2p-resource-sync/directory_watcher.hpp>
+#include <p2p-resource-sync/logger.hpp>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace p2p {
+
+namespace {
+constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                                IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+bool isBelow(const std::string &path, const std::string &directory) {
+  return path.size() > directory.size() && path.starts_with(directory) &&
+         path[directory.size()] == '/';
+}
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher(
+    std::shared_ptr<LocalResourceManager> resource_manager,
+    const std::filesystem::path &root,
+    std::chrono::milliseconds coalesce_window)
+    : resource_manager_(std::move(resource_manager)),
+      root_(std::filesystem::canonical(root)),
+      coalesce_window_(coalesce_window) {};
+
+DirectoryWatcher::~DirectoryWatcher() {
+  if (this->inotify_fd_ >= 0) {
+    close(this->inotify_fd_);
+  }
+};
+
+void DirectoryWatcher::run() {
+  this->inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (this->inotify_fd_ < 0) {
+    throw std::runtime_error("Failed to initialise inotify: " +
+                             std::string(strerror(errno)));
+  }
+  this->running_ = true;
+
+  // Watched before the files are listed, so nothing written meanwhile is
+  // missed
+  std::vector<std::filesystem::path> files;
+  this->watchTree_(this->root_, files);
+  this->registerFiles_(files);
+  Logger::log<LogLevel::INFO>("Sharing {} files from {}",
+                              this->registered_.size(), this->root_.string());
+
+  // Flush time of the pending burst: a window after its last event, but
+  // no later than MAX_COALESCE_WINDOWS windows after its first
+  std::optional<std::chrono::steady_clock::time_point> flush_at;
+  std::chrono::steady_clock::time_point latest_flush;
+  while (this->running_) {
+    int timeout = constants::directory_watcher::POLL_INTERVAL_MS;
+    if (flush_at) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          *flush_at - std::chrono::steady_clock::now());
+      timeout = std::clamp<int>(remaining.count(), 0, timeout);
+    }
+
+    struct pollfd descriptor{
+        .fd = this->inotify_fd_, .events = POLLIN, .revents = 0};
+    if (poll(&descriptor, 1, timeout) > 0) {
+      this->readEvents_();
+      auto now = std::chrono::steady_clock::now();
+      if (!flush_at) {
+        latest_flush =
+            now + this->coalesce_window_ *
+                      constants::directory_watcher::MAX_COALESCE_WINDOWS;
+      }
+      flush_at = std::min(now + this->coalesce_window_, latest_flush);
+    }
+    if (flush_at && std::chrono::steady_clock::now() >= *flush_at) {
+      this->flush_();
+      flush_at.reset();
+    }
+  }
+};
+
+void DirectoryWatcher::stop() { this->running_ = false; };
+
+const std::filesystem::path &DirectoryWatcher::getRoot() const {
+  return this->root_;
+};
+
+size_t DirectoryWatcher::getWatchedDirectoryCount() const {
+  return this->watched_directory_count_.load();
+};
+
+size_t DirectoryWatcher::getRegisteredResourceCount() const {
+  return this->registered_resource_count_.load();
+};
+
+void DirectoryWatcher::watchTree_(const std::filesystem::path &directory,
+                                  std::vector<std::filesystem::path> &files) {
+  std::vector<std::filesystem::path> directories{directory};
+  while (!directories.empty()) {
+    auto current = std::move(directories.back());
+    directories.pop_back();
+    if (!this->watch_ids_.contains(current.string())) {
+      int watch_id =
+          inotify_add_watch(this->inotify_fd_, current.c_str(), WATCH_MASK);
+      if (watch_id < 0) {
+        Logger::log<LogLevel::ERROR>("Failed to watch {}: {}",
+                                     current.string(), strerror(errno));
+        continue;
+      }
+      this->watches_[watch_id] = current;
+      this->watch_ids_[current.string()] = watch_id;
+    }
+
+    std::error_code error;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(current, error)) {
+      if (entry.is_directory(error) && !entry.is_symlink(error)) {
+        directories.push_back(entry.path());
+      } else if (entry.is_regular_file(error)) {
+        files.push_back(entry.path());
+      }
+    }
+  }
+  this->watched_directory_count_ = this->watches_.size();
+};
+
+void DirectoryWatcher::unwatchTree_(const std::filesystem::path &directory) {
+  const auto prefix = directory.string();
+  for (auto it = this->watch_ids_.begin(); it != this->watch_ids_.end();) {
+    if (it->first == prefix || isBelow(it->first, prefix)) {
+      // Deleted directories drop their watch themselves; this fails then
+      inotify_rm_watch(this->inotify_fd_, it->second);
+      this->watches_.erase(it->second);
+      it = this->watch_ids_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  this->watched_directory_count_ = this->watches_.size();
+
+  auto name_prefix = this->resourceName_(directory);
+  auto first = this->registered_.lower_bound(name_prefix + '/');
+  std::vector<std::string> names;
+  for (auto it = first; it != this->registered_.end() && isBelow(*it, name_prefix);
+       ++it) {
+    names.push_back(*it);
+  }
+  for (const auto &name : names) {
+    this->unregister_(name);
+  }
+};
+
+void DirectoryWatcher::registerFiles_(
+    const std::vector<std::filesystem::path> &files) {
+  std::vector<NewResource> resources;
+  resources.reserve(files.size());
+  for (const auto &file : files) {
+    resources.push_back(
+        NewResource{.name = this->resourceName_(file), .path = file.string()});
+  }
+  auto results = this->resource_manager_->addResources(resources);
+
+  for (size_t i = 0; i < resources.size(); ++i) {
+    if (!results[i].error) {
+      this->registered_.insert(std::move(resources[i].name));
+      continue;
+    }
+    Logger::log<LogLevel::ERROR>("Not sharing {}: {}", resources[i].path,
+                                 *results[i].error);
+    // A file that can no longer be shared drops its previous registration
+    this->unregister_(resources[i].name);
+  }
+  this->registered_resource_count_ = this->registered_.size();
+};
+
+void DirectoryWatcher::readEvents_() {
+  alignas(struct inotify_event)
+      char buffer[constants::directory_watcher::EVENT_BUFFER_SIZE];
+  while (true) {
+    ssize_t length = read(this->inotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0) {
+      return;
+    }
+    for (ssize_t offset = 0; offset < length;) {
+      const auto *event =
+          reinterpret_cast<const struct inotify_event *>(buffer + offset);
+      offset += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        this->overflowed_ = true;
+        continue;
+      }
+      if (event->mask & IN_IGNORED) {
+        if (auto watch = this->watches_.find(event->wd);
+            watch != this->watches_.end()) {
+          this->watch_ids_.erase(watch->second.string());
+          this->watches_.erase(watch);
+          this->watched_directory_count_ = this->watches_.size();
+        }
+        continue;
+      }
+      auto watch = this->watches_.find(event->wd);
+      if (watch == this->watches_.end() || event->len == 0) {
+        continue;
+      }
+
+      auto path = watch->second / event->name;
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          this->added_directories_.insert(path);
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+          this->removed_directories_.insert(path);
+          this->added_directories_.erase(path);
+        }
+      } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE |
+                                IN_MOVED_FROM)) {
+        // Files still being written are picked up on IN_CLOSE_WRITE
+        this->changed_files_.insert(path);
+      }
+    }
+  }
+};
+
+void DirectoryWatcher::flush_() {
+  if (this->overflowed_) {
+    this->rescan_();
+    return;
+  }
+
+  // Removals go first, so a renamed file is never listed twice
+  for (const auto &directory : this->removed_directories_) {
+    this->unwatchTree_(directory);
+  }
+  std::vector<std::filesystem::path> files;
+  for (const auto &file : this->changed_files_) {
+    std::error_code error;
+    if (std::filesystem::is_regular_file(file, error)) {
+      files.push_back(file);
+    } else {
+      this->unregister_(this->resourceName_(file));
+    }
+  }
+  for (const auto &directory : this->added_directories_) {
+    if (std::filesystem::is_directory(directory)) {
+      this->watchTree_(directory, files);
+    }
+  }
+  this->registerFiles_(files);
+
+  this->removed_directories_.clear();
+  this->added_directories_.clear();
+  this->changed_files_.clear();
+};
+
+void DirectoryWatcher::rescan_() {
+  Logger::log<LogLevel::INFO>("Event queue overflowed, rescanning {}",
+                              this->root_.string());
+  this->overflowed_ = false;
+  this->removed_directories_.clear();
+  this->added_directories_.clear();
+  this->changed_files_.clear();
+
+  for (auto it = this->watch_ids_.begin(); it != this->watch_ids_.end();) {
+    if (!std::filesystem::is_directory(it->first)) {
+      inotify_rm_watch(this->inotify_fd_, it->second);
+      this->watches_.erase(it->second);
+      it = this->watch_ids_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  std::vector<std::filesystem::path> files;
+  this->watchTree_(this->root_, files);
+
+  std::set<std::string> present;
+  for (const auto &file : files) {
+    present.insert(this->resourceName_(file));
+  }
+  std::vector<std::string> gone;
+  std::ranges::set_difference(this->registered_, present,
+                              std::back_inserter(gone));
+  for (const auto &name : gone) {
+    this->unregister_(name);
+  }
+  this->registerFiles_(files);
+};
+
+void DirectoryWatcher::unregister_(const std::string &resource_name) {
+  if (this->registered_.erase(resource_name) > 0) {
+    this->resource_manager_->removeResource(resource_name);
+  }
+  this->registered_resource_count_ = this->registered_.size();
+};
+
+std::string
+DirectoryWatcher::resourceName_(const std::filesystem::path &file) const {
+  return file.lexically_relative(this->root_).generic_string();
+};
+
+} // namespace p2p
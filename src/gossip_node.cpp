@@ -0,0 +1,686 @@
+#include "p2p-resource-sync/gossip_node.hpp"
+#include "p2p-resource-sync/catalog_codec.hpp"
+#include "p2p-resource-sync/logger.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cmath>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace p2p {
+
+namespace {
+// nodeId, address, gossipPort, servicePort, incarnation, state, catalogDigest
+constexpr size_t MEMBER_WIRE_SIZE = sizeof(uint32_t) + sizeof(uint32_t) +
+                                    sizeof(uint16_t) + sizeof(uint16_t) +
+                                    sizeof(uint64_t) + sizeof(uint8_t) +
+                                    sizeof(uint64_t);
+// magic, type, sequence, flags
+constexpr size_t HEADER_WIRE_SIZE = sizeof(uint32_t) + sizeof(uint8_t) +
+                                    sizeof(uint32_t) + sizeof(uint8_t);
+constexpr uint8_t FLAG_REPLY_REQUESTED = 0x1;
+constexpr uint8_t FLAG_HAS_TARGET = 0x2;
+
+template <typename T> void append(std::vector<uint8_t> &buffer, T value) {
+  size_t offset = buffer.size();
+  buffer.resize(offset + sizeof(T));
+  std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+T read(const uint8_t *data, size_t size, size_t &offset) {
+  if (size - offset < sizeof(T)) {
+    throw std::runtime_error("Truncated gossip message");
+  }
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  offset += sizeof(T);
+  return value;
+}
+
+void appendMember(std::vector<uint8_t> &buffer, const GossipMember &member) {
+  append<uint32_t>(buffer, member.nodeId);
+  append<uint32_t>(buffer, member.gossipAddress.sin_addr.s_addr);
+  append<uint16_t>(buffer, ntohs(member.gossipAddress.sin_port));
+  append<uint16_t>(buffer, member.servicePort);
+  append<uint64_t>(buffer, member.incarnation);
+  append<uint8_t>(buffer, static_cast<uint8_t>(member.state));
+  append<uint64_t>(buffer, member.catalogDigest);
+}
+
+GossipMember readMember(const uint8_t *data, size_t size, size_t &offset) {
+  GossipMember member{};
+  member.nodeId = read<uint32_t>(data, size, offset);
+  member.gossipAddress.sin_family = AF_INET;
+  member.gossipAddress.sin_addr.s_addr = read<uint32_t>(data, size, offset);
+  member.gossipAddress.sin_port = htons(read<uint16_t>(data, size, offset));
+  member.servicePort = read<uint16_t>(data, size, offset);
+  member.incarnation = read<uint64_t>(data, size, offset);
+  auto state = read<uint8_t>(data, size, offset);
+  if (state > static_cast<uint8_t>(MemberState::DEAD)) {
+    throw std::runtime_error("Invalid member state");
+  }
+  member.state = static_cast<MemberState>(state);
+  member.catalogDigest = read<uint64_t>(data, size, offset);
+  return member;
+}
+
+struct sockaddr_in serviceAddress(const GossipMember &member) {
+  struct sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr = member.gossipAddress.sin_addr;
+  address.sin_port = htons(member.servicePort);
+  return address;
+}
+
+uint64_t nowTimestamp() {
+  return std::chrono::system_clock::now().time_since_epoch().count();
+}
+} // namespace
+
+GossipNode::GossipNode(std::shared_ptr<LocalResourceManager> local_manager,
+                       std::shared_ptr<RemoteResourceManager> remote_manager,
+                       uint32_t node_id, const std::string &bind_address,
+                       uint16_t gossip_port, uint16_t service_port,
+                       GossipConfig config)
+    : local_manager_(std::move(local_manager)),
+      remote_manager_(std::move(remote_manager)), node_id_(node_id),
+      service_port_(service_port), config_(config),
+      random_engine_(std::random_device{}() ^ node_id) {
+  this->fetch_function_ = [this](const struct in_addr &host, uint16_t port) {
+    return this->catalog_fetcher_.fetch(host, port);
+  };
+  this->initializeSocket_(bind_address, gossip_port);
+  std::lock_guard lock(this->mutex_);
+  this->updateSelfDigest_();
+}
+
+GossipNode::~GossipNode() {
+  close(this->socket_);
+  // Waits for outstanding catalog fetches before members go away
+  this->pending_fetches_.clear();
+}
+
+void GossipNode::initializeSocket_(const std::string &bind_address,
+                                   uint16_t port) {
+  this->self_address_ = {};
+  this->self_address_.sin_family = AF_INET;
+  this->self_address_.sin_port = htons(port);
+  if (inet_pton(AF_INET, bind_address.c_str(),
+                &this->self_address_.sin_addr) != 1) {
+    throw std::runtime_error("Invalid gossip bind address: " + bind_address);
+  }
+
+  this->socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (this->socket_ < 0) {
+    throw std::runtime_error("Failed to create socket: " +
+                             std::string(strerror(errno)));
+  }
+  if (bind(this->socket_,
+           reinterpret_cast<struct sockaddr *>(&this->self_address_),
+           sizeof(this->self_address_)) < 0) {
+    close(this->socket_);
+    throw std::runtime_error("Failed to bind gossip socket: " +
+                             std::string(strerror(errno)));
+  }
+}
+
+void GossipNode::setCatalogFetchFunction(CatalogFetchFunction fetch) {
+  std::lock_guard lock(this->mutex_);
+  this->fetch_function_ = std::move(fetch);
+}
+
+void GossipNode::join(const std::vector<struct sockaddr_in> &seeds) {
+  std::lock_guard lock(this->mutex_);
+  for (const auto &seed : seeds) {
+    this->sendMessage_(MessageType::PING, this->next_sequence_++, seed);
+  }
+}
+
+std::vector<GossipMember> GossipNode::getMembers() const {
+  std::lock_guard lock(this->mutex_);
+  std::vector<GossipMember> members;
+  members.reserve(this->members_.size());
+  for (const auto &[id, record] : this->members_) {
+    members.push_back(record.member);
+  }
+  return members;
+}
+
+size_t GossipNode::getAliveMemberCount() const {
+  std::lock_guard lock(this->mutex_);
+  return std::ranges::count_if(this->members_, [](const auto &entry) {
+    return entry.second.member.state == MemberState::ALIVE;
+  });
+}
+
+void GossipNode::run() {
+  this->running_ = true;
+  auto tick = std::max(std::chrono::milliseconds(1),
+                       std::min(this->config_.pingTimeout,
+                                this->config_.protocolPeriod) /
+                           4);
+  auto next_period = std::chrono::steady_clock::now();
+  std::vector<uint8_t> buffer(constants::gossip::MAX_DATAGRAM_SIZE);
+
+  while (this->running_) {
+    struct pollfd descriptor{
+        .fd = this->socket_, .events = POLLIN, .revents = 0};
+    if (poll(&descriptor, 1, static_cast<int>(tick.count())) > 0) {
+      while (true) {
+        struct sockaddr_in sender_addr;
+        socklen_t sender_addr_len = sizeof(sender_addr);
+        ssize_t received =
+            recvfrom(this->socket_, buffer.data(), buffer.size(), MSG_DONTWAIT,
+                     reinterpret_cast<struct sockaddr *>(&sender_addr),
+                     &sender_addr_len);
+        if (received <= 0) {
+          break;
+        }
+        std::lock_guard lock(this->mutex_);
+        this->handleDatagram_(buffer.data(), received, sender_addr);
+      }
+    }
+
+    std::lock_guard lock(this->mutex_);
+    try {
+      this->expireProbes_();
+      if (std::chrono::steady_clock::now() >= next_period) {
+        this->runProtocolPeriod_();
+        next_period += this->config_.protocolPeriod;
+      }
+    } catch (const std::exception &e) {
+      Logger::log<LogLevel::ERROR>("Gossip error: {}", e.what());
+    }
+  }
+}
+
+void GossipNode::stop() { this->running_ = false; }
+
+void GossipNode::runProtocolPeriod_() {
+  auto now = std::chrono::steady_clock::now();
+  this->updateSelfDigest_();
+
+  for (auto it = this->members_.begin(); it != this->members_.end();) {
+    auto &record = it->second;
+    auto age = now - record.stateChangedAt;
+    if (record.member.state == MemberState::SUSPECT &&
+        age >= this->config_.suspicionTimeout) {
+      this->markMember_(record, MemberState::DEAD);
+    } else if (record.member.state == MemberState::DEAD &&
+               age >= constants::gossip::DEAD_MEMBER_RETENTION) {
+      this->pending_updates_.erase(it->first);
+      it = this->members_.erase(it);
+      continue;
+    }
+    ++it;
+  }
+
+  this->probeNextMember_();
+  if (this->periods_++ % this->config_.syncIntervalPeriods == 0) {
+    this->sendSync_();
+  }
+  this->feedRemoteManager_();
+}
+
+void GossipNode::expireProbes_() {
+  auto now = std::chrono::steady_clock::now();
+
+  for (auto it = this->pending_probes_.begin();
+       it != this->pending_probes_.end();) {
+    auto &[sequence, probe] = *it;
+    auto member_it = this->members_.find(probe.targetId);
+    if (member_it == this->members_.end() ||
+        member_it->second.member.state == MemberState::DEAD) {
+      it = this->pending_probes_.erase(it);
+      continue;
+    }
+
+    if (!probe.indirect && now - probe.sentAt >= this->config_.pingTimeout) {
+      // Direct probe failed, ask other members to probe on our behalf
+      auto helpers = this->randomMembers_(this->config_.indirectProbes,
+                                          {probe.targetId});
+      for (uint32_t helper : helpers) {
+        this->sendMessage_(MessageType::PING_REQ, sequence,
+                           this->members_.at(helper).member.gossipAddress,
+                           member_it->second.member);
+      }
+      probe.indirect = true;
+      probe.sentAt = now;
+    } else if (probe.indirect &&
+               now - probe.sentAt >= this->config_.protocolPeriod) {
+      if (member_it->second.member.state == MemberState::ALIVE) {
+        this->markMember_(member_it->second, MemberState::SUSPECT);
+      }
+      it = this->pending_probes_.erase(it);
+      continue;
+    }
+    ++it;
+  }
+
+  std::erase_if(this->relayed_probes_, [this, now](const auto &entry) {
+    return now - entry.second.sentAt >= this->config_.protocolPeriod;
+  });
+}
+
+void GossipNode::probeNextMember_() {
+  // Round-robin over a shuffled member list bounds detection time (SWIM 4.3)
+  for (size_t attempts = 0; attempts <= this->members_.size(); ++attempts) {
+    if (this->probe_index_ >= this->probe_order_.size()) {
+      this->probe_order_.clear();
+      for (const auto &[id, record] : this->members_) {
+        if (record.member.state != MemberState::DEAD) {
+          this->probe_order_.push_back(id);
+        }
+      }
+      std::ranges::shuffle(this->probe_order_, this->random_engine_);
+      this->probe_index_ = 0;
+      if (this->probe_order_.empty()) {
+        return;
+      }
+    }
+
+    uint32_t target = this->probe_order_[this->probe_index_++];
+    auto it = this->members_.find(target);
+    if (it == this->members_.end() ||
+        it->second.member.state == MemberState::DEAD) {
+      continue;
+    }
+    bool already_probing = std::ranges::any_of(
+        this->pending_probes_,
+        [target](const auto &entry) { return entry.second.targetId == target; });
+    if (already_probing) {
+      return;
+    }
+
+    uint32_t sequence = this->next_sequence_++;
+    this->pending_probes_[sequence] =
+        PendingProbe{.targetId = target,
+                     .sentAt = std::chrono::steady_clock::now(),
+                     .indirect = false};
+    this->sendMessage_(MessageType::PING, sequence,
+                       it->second.member.gossipAddress);
+    return;
+  }
+}
+
+void GossipNode::sendSync_() {
+  auto peers = this->randomMembers_(1, {});
+  if (peers.empty()) {
+    return;
+  }
+  this->sendMessage_(MessageType::SYNC, this->next_sequence_++,
+                     this->members_.at(peers[0]).member.gossipAddress,
+                     std::nullopt, true);
+}
+
+void GossipNode::updateSelfDigest_() {
+  uint64_t version = this->local_manager_->getVersion();
+  if (this->digest_version_ == version) {
+    return;
+  }
+
+  std::vector<uint8_t> entries = CatalogCodec::serializeEntries(
+      CatalogCodec::fromLocalResources(*this->local_manager_));
+  uint64_t digest = CatalogCodec::digest(entries.data(), entries.size());
+  if (this->digest_version_ && digest != this->catalog_digest_) {
+    // A new incarnation makes the changed digest override older state
+    this->incarnation_++;
+    this->enqueueUpdate_(this->node_id_);
+  }
+  this->catalog_digest_ = digest;
+  this->digest_version_ = version;
+}
+
+void GossipNode::feedRemoteManager_() {
+  uint64_t timestamp = nowTimestamp();
+  for (const auto &[id, record] : this->members_) {
+    if (record.member.state == MemberState::DEAD) {
+      continue;
+    }
+    if (!this->remote_manager_->refreshNode(serviceAddress(record.member),
+                                            record.member.catalogDigest,
+                                            timestamp)) {
+      this->scheduleCatalogFetch_(record.member);
+    }
+  }
+}
+
+void GossipNode::scheduleCatalogFetch_(const GossipMember &member) {
+  std::erase_if(this->pending_fetches_, [](const std::future<void> &fetch) {
+    return fetch.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+  });
+  if (this->fetches_in_flight_.size() >=
+          constants::gossip::MAX_CONCURRENT_FETCHES ||
+      !this->fetches_in_flight_.insert(member.nodeId).second) {
+    return;
+  }
+
+  this->pending_fetches_.push_back(std::async(
+      std::launch::async, [this, member, fetch = this->fetch_function_]() {
+        char member_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(member.gossipAddress.sin_addr), member_ip,
+                  INET_ADDRSTRLEN);
+        std::optional<FetchedCatalog> catalog;
+        try {
+          catalog = fetch(member.gossipAddress.sin_addr, member.servicePort);
+        } catch (const std::exception &e) {
+          Logger::log<LogLevel::ERROR>("Catalog fetch from member {} failed: {}",
+                                       member_ip, e.what());
+        }
+        std::lock_guard lock(this->mutex_);
+        this->fetches_in_flight_.erase(member.nodeId);
+        auto it = this->members_.find(member.nodeId);
+        // Do not resurrect a member declared dead while fetching
+        if (catalog && it != this->members_.end() &&
+            it->second.member.state != MemberState::DEAD) {
+          this->remote_manager_->addOrUpdateNodeResources(
+              serviceAddress(member), std::move(catalog->resources),
+              nowTimestamp(), catalog->digest);
+        }
+      }));
+}
+
+void GossipNode::handleDatagram_(const uint8_t *data, size_t size,
+                                 const struct sockaddr_in &sender_addr) {
+  try {
+    auto message = parseMessage_(data, size);
+    if (message) {
+      this->handleMessage_(*message, sender_addr);
+    }
+  } catch (const std::exception &e) {
+    Logger::log<LogLevel::ERROR>("Invalid gossip message: {}", e.what());
+  }
+}
+
+void GossipNode::handleMessage_(const Message &message,
+                                const struct sockaddr_in &sender_addr) {
+  GossipMember sender = message.sender;
+  sender.gossipAddress = sender_addr;
+  sender.state = MemberState::ALIVE;
+  if (sender.nodeId == this->node_id_) {
+    return;
+  }
+  this->applyUpdate_(sender);
+  if (this->members_.at(sender.nodeId).member.state != MemberState::ALIVE) {
+    // Let a member we gave up on learn about it and refute
+    this->enqueueUpdate_(sender.nodeId);
+  }
+  for (auto update : message.updates) {
+    if (update.nodeId == sender.nodeId) {
+      // Members may not know their own routable address
+      update.gossipAddress = sender_addr;
+    }
+    this->applyUpdate_(update);
+  }
+
+  switch (message.type) {
+  case MessageType::PING:
+    this->sendMessage_(MessageType::ACK, message.sequence, sender_addr);
+    break;
+  case MessageType::PING_REQ: {
+    if (!message.target) {
+      break;
+    }
+    uint32_t sequence = this->next_sequence_++;
+    this->relayed_probes_[sequence] =
+        RelayedProbe{.requester = sender_addr,
+                     .requesterSequence = message.sequence,
+                     .sentAt = std::chrono::steady_clock::now()};
+    this->sendMessage_(MessageType::PING, sequence,
+                       message.target->gossipAddress);
+    break;
+  }
+  case MessageType::ACK: {
+    this->pending_probes_.erase(message.sequence);
+    auto relayed = this->relayed_probes_.find(message.sequence);
+    if (relayed != this->relayed_probes_.end()) {
+      this->sendMessage_(MessageType::ACK, relayed->second.requesterSequence,
+                         relayed->second.requester);
+      this->relayed_probes_.erase(relayed);
+    }
+    break;
+  }
+  case MessageType::SYNC:
+    if (message.replyRequested) {
+      this->sendMessage_(MessageType::SYNC, message.sequence, sender_addr);
+    }
+    break;
+  }
+}
+
+bool GossipNode::applyUpdate_(const GossipMember &update) {
+  if (update.nodeId == this->node_id_) {
+    if (update.state != MemberState::ALIVE &&
+        update.incarnation >= this->incarnation_) {
+      // Refute suspicion about ourselves with a newer incarnation
+      this->incarnation_ = update.incarnation + 1;
+      this->enqueueUpdate_(this->node_id_);
+      return true;
+    }
+    return false;
+  }
+
+  auto it = this->members_.find(update.nodeId);
+  if (it == this->members_.end()) {
+    if (update.state == MemberState::DEAD) {
+      return false;
+    }
+    this->members_[update.nodeId] =
+        MemberRecord{.member = update,
+                     .stateChangedAt = std::chrono::steady_clock::now()};
+    this->enqueueUpdate_(update.nodeId);
+    return true;
+  }
+
+  auto &record = it->second;
+  auto &known = record.member;
+  switch (update.state) {
+  case MemberState::ALIVE:
+    if (update.incarnation > known.incarnation) {
+      bool revived = known.state != MemberState::ALIVE;
+      known = update;
+      if (revived) {
+        record.stateChangedAt = std::chrono::steady_clock::now();
+      }
+      this->enqueueUpdate_(update.nodeId);
+      return true;
+    }
+    return false;
+  case MemberState::SUSPECT:
+    if ((known.state == MemberState::ALIVE &&
+         update.incarnation >= known.incarnation) ||
+        (known.state == MemberState::SUSPECT &&
+         update.incarnation > known.incarnation)) {
+      known.incarnation = update.incarnation;
+      this->markMember_(record, MemberState::SUSPECT);
+      return true;
+    }
+    return false;
+  case MemberState::DEAD:
+    if (known.state != MemberState::DEAD &&
+        update.incarnation >= known.incarnation) {
+      known.incarnation = update.incarnation;
+      this->markMember_(record, MemberState::DEAD);
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+
+void GossipNode::markMember_(MemberRecord &record, MemberState state) {
+  record.member.state = state;
+  record.stateChangedAt = std::chrono::steady_clock::now();
+  this->enqueueUpdate_(record.member.nodeId);
+
+  char member_ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &(record.member.gossipAddress.sin_addr), member_ip,
+            INET_ADDRSTRLEN);
+  if (state == MemberState::DEAD) {
+    Logger::log<LogLevel::INFO>("Gossip member {} at {} declared dead",
+                                record.member.nodeId, member_ip);
+    this->remote_manager_->removeNode(serviceAddress(record.member));
+  } else if (state == MemberState::SUSPECT) {
+    Logger::log<LogLevel::INFO>("Gossip member {} at {} suspected",
+                                record.member.nodeId, member_ip);
+  }
+}
+
+void GossipNode::enqueueUpdate_(uint32_t node_id) {
+  this->pending_updates_[node_id] = this->retransmitLimit_();
+}
+
+size_t GossipNode::retransmitLimit_() const {
+  double cluster_size = static_cast<double>(this->members_.size() + 2);
+  return constants::gossip::RETRANSMIT_MULTIPLIER *
+         static_cast<size_t>(std::ceil(std::log2(cluster_size)));
+}
+
+GossipMember GossipNode::self_() const {
+  return GossipMember{.nodeId = this->node_id_,
+                      .gossipAddress = this->self_address_,
+                      .servicePort = this->service_port_,
+                      .incarnation = this->incarnation_,
+                      .state = MemberState::ALIVE,
+                      .catalogDigest = this->catalog_digest_};
+}
+
+std::vector<GossipMember> GossipNode::takePiggybackUpdates_(size_t limit) {
+  // Least disseminated updates go first
+  std::vector<std::pair<size_t, uint32_t>> candidates;
+  for (const auto &[id, remaining] : this->pending_updates_) {
+    candidates.emplace_back(remaining, id);
+  }
+  std::ranges::sort(candidates, std::greater<>());
+
+  std::vector<GossipMember> updates;
+  for (const auto &[remaining, id] : candidates) {
+    if (updates.size() >= limit) {
+      break;
+    }
+    if (id == this->node_id_) {
+      updates.push_back(this->self_());
+    } else if (auto it = this->members_.find(id); it != this->members_.end()) {
+      updates.push_back(it->second.member);
+    }
+    if (remaining <= 1) {
+      this->pending_updates_.erase(id);
+    } else {
+      this->pending_updates_[id] = remaining - 1;
+    }
+  }
+  return updates;
+}
+
+std::vector<uint32_t>
+GossipNode::randomMembers_(size_t count, const std::set<uint32_t> &excluded) {
+  std::vector<uint32_t> candidates;
+  for (const auto &[id, record] : this->members_) {
+    if (record.member.state != MemberState::DEAD && !excluded.contains(id)) {
+      candidates.push_back(id);
+    }
+  }
+  std::vector<uint32_t> chosen;
+  std::ranges::sample(candidates, std::back_inserter(chosen), count,
+                      this->random_engine_);
+  return chosen;
+}
+
+void GossipNode::sendMessage_(MessageType type, uint32_t sequence,
+                              const struct sockaddr_in &destination,
+                              const std::optional<GossipMember> &target,
+                              bool reply_requested,
+                              std::vector<GossipMember> extra_updates) {
+  Message message{.type = type,
+                  .sequence = sequence,
+                  .sender = this->self_(),
+                  .target = target,
+                  .replyRequested = reply_requested,
+                  .updates = std::move(extra_updates)};
+
+  if (type == MessageType::SYNC) {
+    // Anti-entropy: push a random sample of the full membership
+    std::vector<uint32_t> sample =
+        this->randomMembers_(constants::gossip::MAX_SYNC_MEMBERS, {});
+    for (uint32_t id : sample) {
+      message.updates.push_back(this->members_.at(id).member);
+    }
+  } else {
+    auto piggyback = this->takePiggybackUpdates_(
+        this->config_.maxPiggybackUpdates -
+        std::min(this->config_.maxPiggybackUpdates, message.updates.size()));
+    message.updates.insert(message.updates.end(), piggyback.begin(),
+                           piggyback.end());
+  }
+
+  std::vector<uint8_t> buffer = this->serializeMessage_(message);
+  if (sendto(this->socket_, buffer.data(), buffer.size(), 0,
+             reinterpret_cast<const struct sockaddr *>(&destination),
+             sizeof(destination)) == -1) {
+    Logger::log<LogLevel::ERROR>("Failed to send gossip message: {}",
+                                 strerror(errno));
+  }
+}
+
+std::vector<uint8_t>
+GossipNode::serializeMessage_(const Message &message) const {
+  std::vector<uint8_t> buffer;
+  buffer.reserve(HEADER_WIRE_SIZE +
+                 MEMBER_WIRE_SIZE * (message.updates.size() + 2) + 1);
+
+  uint8_t flags = (message.replyRequested ? FLAG_REPLY_REQUESTED : 0) |
+                  (message.target ? FLAG_HAS_TARGET : 0);
+  append<uint32_t>(buffer, constants::gossip::MESSAGE_MAGIC);
+  append<uint8_t>(buffer, static_cast<uint8_t>(message.type));
+  append<uint32_t>(buffer, message.sequence);
+  append<uint8_t>(buffer, flags);
+  appendMember(buffer, message.sender);
+  if (message.target) {
+    appendMember(buffer, *message.target);
+  }
+  append<uint8_t>(buffer, static_cast<uint8_t>(message.updates.size()));
+  for (const auto &update : message.updates) {
+    appendMember(buffer, update);
+  }
+  return buffer;
+}
+
+std::optional<GossipNode::Message>
+GossipNode::parseMessage_(const uint8_t *data, size_t size) {
+  size_t offset = 0;
+  if (size < HEADER_WIRE_SIZE ||
+      read<uint32_t>(data, size, offset) != constants::gossip::MESSAGE_MAGIC) {
+    return std::nullopt;
+  }
+
+  Message message;
+  auto type = read<uint8_t>(data, size, offset);
+  if (type < static_cast<uint8_t>(MessageType::PING) ||
+      type > static_cast<uint8_t>(MessageType::SYNC)) {
+    throw std::runtime_error("Unknown gossip message type");
+  }
+  message.type = static_cast<MessageType>(type);
+  message.sequence = read<uint32_t>(data, size, offset);
+  auto flags = read<uint8_t>(data, size, offset);
+  message.replyRequested = flags & FLAG_REPLY_REQUESTED;
+  message.sender = readMember(data, size, offset);
+  if (flags & FLAG_HAS_TARGET) {
+    message.target = readMember(data, size, offset);
+  }
+
+  auto update_count = read<uint8_t>(data, size, offset);
+  message.updates.reserve(update_count);
+  for (uint8_t i = 0; i < update_count; ++i) {
+    message.updates.push_back(readMember(data, size, offset));
+  }
+  return message;
+}
+
+} // namespace p2p
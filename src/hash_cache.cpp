@@ -0,0 +1,147 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <p2p-resource-sync/constants.hpp>
+#include <p2p-resource-sync/hash_cache.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace p2p {
+
+namespace {
+struct FileHeader {
+  uint32_t magic;
+  uint32_t formatVersion;
+  uint64_t entryCount;
+};
+
+// Followed by pathLength bytes of path
+struct EntryRecord {
+  uint64_t size;
+  int64_t modified;
+  uint64_t hash;
+  uint32_t pathLength;
+  uint32_t reserved;
+};
+
+template <typename T> void append(std::vector<char> &buffer, const T &value) {
+  auto bytes = reinterpret_cast<const char *>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+} // namespace
+
+std::optional<uint64_t> HashCache::lookup(const std::string &path,
+                                          uint64_t size,
+                                          int64_t modified) const {
+  std::lock_guard lock(this->mutex_);
+  auto entry = this->entries_.find(path);
+  if (entry == this->entries_.end() || entry->second.size != size ||
+      entry->second.modified != modified) {
+    return std::nullopt;
+  }
+  return entry->second.hash;
+};
+
+void HashCache::store(const std::string &path, uint64_t size,
+                      int64_t modified, uint64_t hash) {
+  std::lock_guard lock(this->mutex_);
+  this->entries_[path] =
+      Entry{.size = size, .modified = modified, .hash = hash};
+  this->dirty_ = true;
+};
+
+void HashCache::erase(const std::string &path) {
+  std::lock_guard lock(this->mutex_);
+  this->dirty_ |= this->entries_.erase(path) > 0;
+};
+
+size_t HashCache::size() const {
+  std::lock_guard lock(this->mutex_);
+  return this->entries_.size();
+};
+
+void HashCache::load(const std::filesystem::path &file) {
+  std::ifstream input(file, std::ios::binary);
+  if (!input) {
+    throw std::runtime_error("Failed to open hash cache: " + file.string());
+  }
+  std::vector<char> buffer((std::istreambuf_iterator<char>(input)),
+                           std::istreambuf_iterator<char>());
+
+  FileHeader header;
+  if (buffer.size() < sizeof(header)) {
+    throw std::runtime_error("Hash cache is truncated");
+  }
+  std::memcpy(&header, buffer.data(), sizeof(header));
+  if (header.magic != constants::content_hash::CACHE_FILE_MAGIC ||
+      header.formatVersion != constants::content_hash::CACHE_FORMAT_VERSION) {
+    throw std::runtime_error("Unsupported hash cache format");
+  }
+
+  std::unordered_map<std::string, Entry> entries;
+  size_t offset = sizeof(header);
+  for (uint64_t i = 0; i < header.entryCount; ++i) {
+    EntryRecord record;
+    if (buffer.size() - offset < sizeof(record)) {
+      throw std::runtime_error("Hash cache is truncated");
+    }
+    std::memcpy(&record, buffer.data() + offset, sizeof(record));
+    offset += sizeof(record);
+    if (buffer.size() - offset < record.pathLength) {
+      throw std::runtime_error("Hash cache is truncated");
+    }
+    entries.insert_or_assign(
+        std::string(buffer.data() + offset, record.pathLength),
+        Entry{.size = record.size,
+              .modified = record.modified,
+              .hash = record.hash});
+    offset += record.pathLength;
+  }
+
+  std::lock_guard lock(this->mutex_);
+  this->entries_ = std::move(entries);
+  this->dirty_ = false;
+};
+
+void HashCache::save(const std::filesystem::path &file) {
+  std::lock_guard save_lock(this->save_mutex_);
+  std::vector<char> buffer;
+  {
+    std::lock_guard lock(this->mutex_);
+    if (!this->dirty_) {
+      return;
+    }
+    append(buffer,
+           FileHeader{.magic = constants::content_hash::CACHE_FILE_MAGIC,
+                      .formatVersion =
+                          constants::content_hash::CACHE_FORMAT_VERSION,
+                      .entryCount = this->entries_.size()});
+    for (const auto &[path, entry] : this->entries_) {
+      append(buffer, EntryRecord{.size = entry.size,
+                                 .modified = entry.modified,
+                                 .hash = entry.hash,
+                                 .pathLength =
+                                     static_cast<uint32_t>(path.size()),
+                                 .reserved = 0});
+      buffer.insert(buffer.end(), path.begin(), path.end());
+    }
+    this->dirty_ = false;
+  }
+
+  // Written aside and renamed so a crash never leaves a partial file
+  auto temporary_path = file;
+  temporary_path += ".tmp";
+  {
+    std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    if (!output) {
+      std::lock_guard lock(this->mutex_);
+      this->dirty_ = true;
+      throw std::runtime_error("Failed to write hash cache: " +
+                               temporary_path.string());
+    }
+  }
+  std::filesystem::rename(temporary_path, file);
+};
+
+} // namespace p2p
@@ -1,16 +1,340 @@
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <p2p-resource-sync/constants.hpp>
 #include <p2p-resource-sync/local_resource_manager.hpp>
 #include <p2p-resource-sync/logger.hpp>
+#include <p2p-resource-sync/resource_index.hpp>
 
 namespace p2p {
+namespace {
+// First resource named after name
+auto upperBound(const std::vector<std::shared_ptr<const ResourceInfo>> &resources,
+                std::string_view name) {
+  return std::ranges::upper_bound(
+      resources, name, {},
+      [](const auto &resource) -> std::string_view { return resource->name; });
+}
+} // namespace
+
+const ResourceInfo *LocalCatalog::find(std::string_view name) const {
+  auto it = std::ranges::lower_bound(
+      this->resources, name, {},
+      [](const auto &resource) -> std::string_view { return resource->name; });
+  if (it == this->resources.end() || (*it)->name != name) {
+    return nullptr;
+  }
+  return it->get();
+};
+
+LocalResourceManager::LocalResourceManager(uint64_t max_resource_size)
+    : max_resource_size_(max_resource_size) {};
+
+LocalResourceManager::~LocalResourceManager() {
+  // Stopped first, so nothing completes into a destroyed manager
+  this->refresher_thread_ = {};
+  this->verifier_thread_ = {};
+  this->hasher_.reset();
+  this->saveHashCache_();
+};
+
+void LocalResourceManager::enableContentHashing(
+    const std::filesystem::path &cache_path, size_t thread_count) {
+  this->hash_cache_path_ = cache_path;
+  if (!cache_path.empty() && std::filesystem::exists(cache_path)) {
+    try {
+      this->hash_cache_.load(cache_path);
+    } catch (const std::exception &e) {
+      Logger::log<LogLevel::ERROR>("Ignoring hash cache: {}", e.what());
+    }
+  }
+  this->hasher_ = std::make_unique<ContentHasher>(thread_count);
+  this->hashUnhashed_();
+};
+
+void LocalResourceManager::enablePersistence(
+    const std::filesystem::path &index_path) {
+  std::unique_ptr<ResourceIndex> index;
+  try {
+    index = std::make_unique<ResourceIndex>(index_path);
+  } catch (const std::exception &e) {
+    Logger::log<LogLevel::ERROR>("Discarding resource index: {}", e.what());
+    std::filesystem::remove(index_path);
+    index = std::make_unique<ResourceIndex>(index_path);
+  }
+
+  size_t restored = index->restored().size();
+  {
+    std::unique_lock lock(mutex_);
+    // Resources added before persistence was enabled take precedence
+    for (const auto &[name, resource] : index->restored()) {
+      if (!resources_.contains(name)) {
+        resources_.emplace(name, std::make_shared<const ResourceInfo>(resource));
+      }
+    }
+    index->releaseRestored();
+    this->index_ = std::move(index);
+    this->publish_();
+    if (resources_.size() != restored ||
+        this->index_->needsCompaction(resources_.size())) {
+      try {
+        this->index_->compact(*this->currentSnapshot_());
+      } catch (const std::exception &e) {
+        Logger::log<LogLevel::ERROR>("Failed to compact resource index: {}",
+                                     e.what());
+      }
+    }
+  }
+  Logger::log<LogLevel::INFO>("Restored {} resources from {}", restored,
+                              index_path.string());
+  notifyChange_();
+
+  if (this->hasher_) {
+    this->hashUnhashed_();
+  }
+  this->verifier_thread_ = std::jthread(
+      [this](std::stop_token stop) { this->verifyResources_(stop); });
+};
+
 bool LocalResourceManager::addResource(const std::string &new_resource_name,
                                        const std::string &new_resource_path) {
-  if (!std::filesystem::exists(new_resource_path)) {
-    throw ResourceNotFoundError(new_resource_path);
+  auto resource = this->validate_(new_resource_name, new_resource_path);
+
+  bool inserted;
+  {
+    std::unique_lock lock(mutex_);
+
+    // Re-adding an unchanged file, e.g. when a shared directory is scanned
+    // again after a restart, changes nothing
+    if (!this->changes_(resource)) {
+      return false;
+    }
+
+    Logger::log<LogLevel::INFO>("Adding new resource: {}", new_resource_name);
+    inserted = resources_
+                   .insert_or_assign(
+                       new_resource_name,
+                       std::make_shared<const ResourceInfo>(resource.info))
+                   .second;
+    this->publish_();
+    this->persistAdd_(resource.info);
+  }
+  notifyChange_();
+  if (this->hasher_ && resource.modified && !resource.info.contentHash) {
+    this->hashResource_(resource.info);
+  }
+  return inserted;
+};
+
+std::vector<ResourceAddResult>
+LocalResourceManager::addResources(const std::vector<NewResource> &resources) {
+  std::vector<ResourceAddResult> results(resources.size());
+  std::vector<std::optional<ValidatedResource>> validated(resources.size());
+  size_t thread_count = std::clamp<size_t>(
+      resources.size() /
+          constants::local_resource_manager::MIN_FILES_PER_VALIDATION_THREAD,
+      1,
+      std::min<size_t>(
+          std::max(1U, std::thread::hardware_concurrency()),
+          constants::local_resource_manager::MAX_VALIDATION_THREADS));
+  auto validate_every = [&](size_t first) {
+    for (size_t i = first; i < resources.size(); i += thread_count) {
+      try {
+        validated[i] = this->validate_(resources[i].name, resources[i].path);
+      } catch (const std::exception &e) {
+        results[i].error = e.what();
+      }
+    }
+  };
+  {
+    std::vector<std::jthread> threads;
+    for (size_t first = 1; first < thread_count; ++first) {
+      threads.emplace_back(validate_every, first);
+    }
+    validate_every(0);
+  }
+
+  std::vector<const ResourceInfo *> added;
+  {
+    std::unique_lock lock(mutex_);
+    for (size_t i = 0; i < resources.size(); ++i) {
+      if (!validated[i] || !this->changes_(*validated[i])) {
+        continue;
+      }
+      const auto &info = validated[i]->info;
+      results[i].inserted =
+          resources_
+              .insert_or_assign(info.name,
+                                std::make_shared<const ResourceInfo>(info))
+              .second;
+      added.push_back(&info);
+    }
+    if (added.empty()) {
+      return results;
+    }
+    // Published before persisting, so a compaction triggered by one of the
+    // records below writes out the whole batch
+    this->publish_();
+    for (const auto *info : added) {
+      this->persistAdd_(*info);
+    }
+  }
+  Logger::log<LogLevel::INFO>("Added {} resources in one batch",
+                              added.size());
+  notifyChange_();
+  if (this->hasher_) {
+    for (const auto &resource : validated) {
+      if (resource && resource->modified && !resource->info.contentHash) {
+        this->hashResource_(resource->info);
+      }
+    }
+  }
+  return results;
+};
+
+std::optional<std::string>
+LocalResourceManager::getResourcePath(const std::string &name) const {
+  auto snapshot = this->getSnapshot();
+  if (auto resource = snapshot->find(name)) {
+    return resource->path;
+  }
+  return std::nullopt;
+};
+
+bool LocalResourceManager::removeResource(const std::string &name) {
+  {
+    std::unique_lock lock(mutex_);
+
+    auto it = resources_.find(name);
+    if (it == resources_.end()) {
+      return false;
+    }
+    Logger::log<LogLevel::INFO>("Removing resource: {}", name);
+    resources_.erase(it);
+    this->publish_();
+    this->persistRemove_(name);
+  }
+  notifyChange_();
+  return true;
+};
+
+std::map<std::string, ResourceInfo>
+LocalResourceManager::getAllResources() const {
+  auto snapshot = this->getSnapshot();
+  std::map<std::string, ResourceInfo> resources;
+  for (const auto &resource : snapshot->resources) {
+    resources.emplace_hint(resources.end(), resource->name, *resource);
+  }
+  return resources;
+};
+
+LocalResourcePage
+LocalResourceManager::getResourcePage(const std::optional<std::string> &after,
+                                      size_t limit) const {
+  LocalResourcePage page;
+  auto snapshot = this->getSnapshot();
+  const auto &resources = snapshot->resources;
+
+  auto it = after ? upperBound(resources, *after) : resources.begin();
+  page.resources.reserve(
+      std::min(limit, static_cast<size_t>(resources.end() - it)));
+  for (; it != resources.end() && page.resources.size() < limit; ++it) {
+    page.resources.push_back(**it);
+  }
+  if (it != resources.end() && !page.resources.empty()) {
+    page.nextCursor = page.resources.back().name;
+  }
+  return page;
+};
+
+LocalCatalogSnapshot LocalResourceManager::getSnapshot() const {
+  if (auto snapshot = this->snapshot_.load(std::memory_order_acquire)) {
+    return snapshot;
+  }
+  std::unique_lock lock(mutex_);
+  return this->currentSnapshot_();
+};
+
+void LocalResourceManager::forEachResource(
+    const ResourceVisitor &visitor) const {
+  std::optional<std::string> cursor;
+  do {
+    // A fresh snapshot per page, so the visitor's own changes are seen
+    auto snapshot = this->getSnapshot();
+    const auto &resources = snapshot->resources;
+    auto it = cursor ? upperBound(resources, *cursor) : resources.begin();
+    cursor.reset();
+    for (size_t visited = 0; it != resources.end(); ++it, ++visited) {
+      if (visited == constants::local_resource_manager::ITERATION_PAGE_SIZE) {
+        cursor = (*std::prev(it))->name;
+        break;
+      }
+      visitor(**it);
+    }
+  } while (cursor);
+};
+
+std::optional<ResourceInfo>
+LocalResourceManager::getResourceInfo(const std::string &name) const {
+  auto snapshot = this->getSnapshot();
+  if (auto resource = snapshot->find(name)) {
+    return *resource;
+  }
+  return std::nullopt;
+};
+
+bool LocalResourceManager::checkFile(const ResourceInfo &resource,
+                                     const struct stat &file_stat) {
+  auto modified = std::chrono::file_clock::from_sys(
+      std::chrono::sys_time<std::chrono::nanoseconds>(
+          std::chrono::seconds(file_stat.st_mtim.tv_sec) +
+          std::chrono::nanoseconds(file_stat.st_mtim.tv_nsec)));
+  if (static_cast<uint64_t>(file_stat.st_size) == resource.size &&
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          modified.time_since_epoch())
+              .count() == resource.fileModified) {
+    return true;
+  }
+  this->refreshResource(resource.name);
+  return false;
+};
+
+void LocalResourceManager::refreshResource(const std::string &name) {
+  {
+    std::lock_guard lock(refresh_mutex_);
+    if (!this->refresher_thread_.joinable()) {
+      this->refresher_thread_ = std::jthread(
+          [this](std::stop_token stop) { this->refreshResources_(stop); });
+    }
+    this->refresh_queue_.insert(name);
+  }
+  this->refresh_cv_.notify_one();
+};
+
+uint64_t LocalResourceManager::getVersion() const {
+  return version_.load(std::memory_order_acquire);
+};
+
+size_t LocalResourceManager::addChangeListener(ChangeListener listener) {
+  std::lock_guard lock(listeners_mutex_);
+  size_t listener_id = next_listener_id_++;
+  listeners_.emplace(listener_id, std::move(listener));
+  return listener_id;
+};
+
+void LocalResourceManager::removeChangeListener(size_t listener_id) {
+  std::lock_guard lock(listeners_mutex_);
+  listeners_.erase(listener_id);
+};
+
+LocalResourceManager::ValidatedResource
+LocalResourceManager::validate_(const std::string &name,
+                                const std::string &path) const {
+  if (!std::filesystem::exists(path)) {
+    throw ResourceNotFoundError(path);
   }
 
-  if (new_resource_name.length() >
+  if (name.length() >
       constants::local_resource_manager::MAX_RESOURCE_NAME_LENGTH) {
     throw ResourceError(
         "Resource name exceeds maximum length of " +
@@ -18,7 +342,7 @@ bool LocalResourceManager::addResource(const std::string &new_resource_name,
             constants::local_resource_manager::MAX_RESOURCE_NAME_LENGTH));
   }
 
-  if (new_resource_path.length() >
+  if (path.length() >
       constants::local_resource_manager::MAX_RESOURCE_PATH_LENGTH) {
     throw ResourceError(
         "Resource path exceeds maximum length of " +
@@ -26,80 +350,248 @@ bool LocalResourceManager::addResource(const std::string &new_resource_name,
             constants::local_resource_manager::MAX_RESOURCE_PATH_LENGTH));
   }
 
-  auto file_size = std::filesystem::file_size(new_resource_path);
-  if (file_size > constants::local_resource_manager::MAX_RESOURCE_SIZE) {
-    throw ResourceError(
-        "Resource size exceeds maximum allowed size of " +
-        std::to_string(constants::local_resource_manager::MAX_RESOURCE_SIZE) +
-        " bytes");
+  uint64_t file_size = std::filesystem::file_size(path);
+  if (file_size > this->max_resource_size_) {
+    throw ResourceError("Resource size exceeds maximum allowed size of " +
+                        std::to_string(this->max_resource_size_) + " bytes");
   }
 
-  std::unique_lock lock(mutex_);
+  auto modified = modificationTime_(path);
+  ValidatedResource resource{.info = {.name = name,
+                                      .path = path,
+                                      .size = file_size,
+                                      .lastModified = std::time(nullptr),
+                                      .fileModified = modified.value_or(0),
+                                      .contentHash = std::nullopt},
+                             .modified = modified};
+  if (this->hasher_ && modified) {
+    resource.info.contentHash =
+        this->hash_cache_.lookup(path, file_size, *modified);
+  }
+  return resource;
+};
 
-  if (resources_.size() >= constants::local_resource_manager::MAX_RESOURCES &&
-      resources_.find(new_resource_name) == resources_.end()) {
-    throw ResourceError(
-        "Maximum number of resources (" +
-        std::to_string(constants::local_resource_manager::MAX_RESOURCES) +
-        ") reached");
+bool LocalResourceManager::changes_(const ValidatedResource &resource) const {
+  auto existing = resources_.find(resource.info.name);
+  return existing == resources_.end() || !resource.modified ||
+         existing->second->path != resource.info.path ||
+         existing->second->size != resource.info.size ||
+         existing->second->fileModified != *resource.modified;
+};
+
+void LocalResourceManager::hashUnhashed_() {
+  std::vector<ResourceInfo> unhashed;
+  {
+    std::unique_lock lock(mutex_);
+    for (auto &[name, resource] : resources_) {
+      if (resource->contentHash) {
+        continue;
+      }
+      auto hash = this->hash_cache_.lookup(resource->path, resource->size,
+                                           resource->fileModified);
+      if (!hash) {
+        unhashed.push_back(*resource);
+        continue;
+      }
+      auto hashed = *resource;
+      hashed.contentHash = hash;
+      resource = std::make_shared<const ResourceInfo>(std::move(hashed));
+      // Not a catalog change, so the version stays the same
+      this->snapshot_.store(nullptr, std::memory_order_release);
+      this->persistAdd_(*resource);
+    }
   }
+  for (const auto &resource : unhashed) {
+    this->hashResource_(resource);
+  }
+};
 
-  ResourceInfo resource_info{.name = new_resource_name,
-                             .path = new_resource_path,
-                             .size = file_size,
-                             .lastModified = std::time(nullptr)};
+void LocalResourceManager::hashResource_(const ResourceInfo &resource) {
+  this->hashes_pending_++;
+  this->hasher_->hashFile(resource.path, [this, resource](
+                                             std::optional<uint64_t> hash) {
+    std::error_code error;
+    if (!hash) {
+      Logger::log<LogLevel::ERROR>("Failed to hash {}", resource.path);
+    } else if (modificationTime_(resource.path) == resource.fileModified &&
+               std::filesystem::file_size(resource.path, error) ==
+                   resource.size) {
+      // Not modified while it was read
+      this->hash_cache_.store(resource.path, resource.size,
+                              resource.fileModified, *hash);
+      std::unique_lock lock(mutex_);
+      auto it = resources_.find(resource.name);
+      if (it != resources_.end() && it->second->path == resource.path &&
+          it->second->size == resource.size &&
+          it->second->fileModified == resource.fileModified) {
+        auto hashed = *it->second;
+        hashed.contentHash = hash;
+        it->second = std::make_shared<const ResourceInfo>(std::move(hashed));
+        this->snapshot_.store(nullptr, std::memory_order_release);
+        this->persistAdd_(*it->second);
+      }
+    }
+    // Saved once a batch is done rather than after every file
+    if (--this->hashes_pending_ == 0) {
+      this->saveHashCache_();
+    }
+  });
+};
 
-  Logger::log(LogLevel::INFO, "Adding new resource: " + new_resource_name);
-  return resources_.insert_or_assign(new_resource_name, resource_info).second;
+void LocalResourceManager::publish_() {
+  version_.fetch_add(1, std::memory_order_release);
+  this->snapshot_.store(nullptr, std::memory_order_release);
 };
 
-std::optional<std::string>
-LocalResourceManager::getResourcePath(const std::string &name) const {
-  std::shared_lock lock(mutex_);
+LocalCatalogSnapshot LocalResourceManager::currentSnapshot_() const {
+  auto snapshot = this->snapshot_.load(std::memory_order_acquire);
+  if (snapshot) {
+    return snapshot;
+  }
+  auto catalog = std::make_shared<LocalCatalog>();
+  catalog->version = version_.load(std::memory_order_acquire);
+  catalog->resources.reserve(resources_.size());
+  for (const auto &[name, resource] : resources_) {
+    catalog->resources.push_back(resource);
+  }
+  snapshot = std::move(catalog);
+  this->snapshot_.store(snapshot, std::memory_order_release);
+  return snapshot;
+};
 
-  if (auto it = resources_.find(name); it != resources_.end()) {
-    return it->second.path;
+void LocalResourceManager::persistAdd_(const ResourceInfo &resource) {
+  if (!this->index_) {
+    return;
+  }
+  try {
+    this->index_->recordAdd(resource);
+    if (this->index_->needsCompaction(resources_.size())) {
+      this->index_->compact(*this->currentSnapshot_());
+    }
+  } catch (const std::exception &e) {
+    Logger::log<LogLevel::ERROR>("Failed to record {} in resource index: {}",
+                                 resource.name, e.what());
   }
-  return std::nullopt;
 };
 
-bool LocalResourceManager::removeResource(const std::string &name) {
-  std::unique_lock lock(mutex_);
+void LocalResourceManager::persistRemove_(const std::string &name) {
+  if (!this->index_) {
+    return;
+  }
+  try {
+    this->index_->recordRemove(name);
+    if (this->index_->needsCompaction(resources_.size())) {
+      this->index_->compact(*this->currentSnapshot_());
+    }
+  } catch (const std::exception &e) {
+    Logger::log<LogLevel::ERROR>(
+        "Failed to record removal of {} in resource index: {}", name,
+        e.what());
+  }
+};
 
-  auto it = resources_.find(name);
-  if (it != resources_.end()) {
-    Logger::log(LogLevel::INFO, "Removing resource: " + name);
-    return resources_.erase(name);
+void LocalResourceManager::verifyResources_(std::stop_token stop) {
+  size_t stale = 0;
+  auto snapshot = this->getSnapshot();
+  for (const auto &resource : snapshot->resources) {
+    if (stop.stop_requested()) {
+      return;
+    }
+    if (this->refresh_(*resource)) {
+      stale++;
+    }
+  }
+
+  if (stale > 0) {
+    Logger::log<LogLevel::INFO>("Updated {} resources whose files changed",
+                                stale);
   }
-  return false;
 };
 
-std::map<std::string, ResourceInfo>
-LocalResourceManager::getAllResources() const {
-  std::shared_lock lock(mutex_);
+void LocalResourceManager::refreshResources_(std::stop_token stop) {
+  while (true) {
+    std::string name;
+    {
+      std::unique_lock lock(refresh_mutex_);
+      if (!this->refresh_cv_.wait(lock, stop, [this]() {
+            return !this->refresh_queue_.empty();
+          })) {
+        return;
+      }
+      name = std::move(
+          this->refresh_queue_.extract(this->refresh_queue_.begin()).value());
+    }
+    auto snapshot = this->getSnapshot();
+    if (auto resource = snapshot->find(name);
+        resource && this->refresh_(*resource)) {
+      Logger::log<LogLevel::INFO>("Updated resource whose file changed: {}",
+                                  name);
+    }
+  }
+};
 
-  return resources_;
+bool LocalResourceManager::refresh_(const ResourceInfo &resource) {
+  std::error_code error;
+  bool exists = std::filesystem::is_regular_file(resource.path, error);
+  uint64_t size = exists ? std::filesystem::file_size(resource.path, error) : 0;
+  if (exists && size == resource.size &&
+      modificationTime_(resource.path) == resource.fileModified) {
+    return false;
+  }
+  try {
+    if (exists) {
+      this->addResource(resource.name, resource.path);
+      return true;
+    }
+  } catch (const std::exception &e) {
+    Logger::log<LogLevel::ERROR>("Not sharing {}: {}", resource.path,
+                                 e.what());
+  }
+  this->removeResource(resource.name);
+  return true;
 };
 
-std::optional<ResourceInfo>
-LocalResourceManager::getResourceInfo(const std::string &name) const {
-  std::shared_lock lock(mutex_);
+void LocalResourceManager::saveHashCache_() {
+  if (this->hash_cache_path_.empty()) {
+    return;
+  }
+  try {
+    this->hash_cache_.save(this->hash_cache_path_);
+  } catch (const std::exception &e) {
+    Logger::log<LogLevel::ERROR>("Failed to save hash cache: {}", e.what());
+  }
+};
 
-  auto it = resources_.find(name);
-  if (it != resources_.end()) {
-    return it->second;
+std::optional<int64_t>
+LocalResourceManager::modificationTime_(const std::string &path) {
+  std::error_code error;
+  auto modified = std::filesystem::last_write_time(path, error);
+  if (error) {
+    return std::nullopt;
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             modified.time_since_epoch())
+      .count();
+};
+
+void LocalResourceManager::notifyChange_() {
+  // Listeners run under listeners_mutex_ so that a removed listener is
+  // guaranteed not to be running once removeChangeListener returns.
+  std::lock_guard lock(listeners_mutex_);
+  uint64_t version = getVersion();
+  for (const auto &[id, listener] : listeners_) {
+    listener(version);
   }
-  return std::nullopt;
 };
 
 std::ostream &operator<<(std::ostream &os,
                          const LocalResourceManager &manager) {
   os << "LocalResourceManager{\n";
-  const auto resources = manager.getAllResources();
-  for (const auto &[name, info] : resources) {
-    os << "  " << name << ": path='" << info.path << "', size=" << info.size
-       << ", lastModified=" << info.lastModified << "\n";
-  }
+  manager.forEachResource([&os](const ResourceInfo &info) {
+    os << "  " << info.name << ": path='" << info.path
+       << "', size=" << info.size << ", lastModified=" << info.lastModified
+       << "\n";
+  });
   os << "}";
   return os;
 }
@@ -1,19 +1,300 @@
 #include "p2p-resource-sync/logger.hpp"
+#include "p2p-resource-sync/constants.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
 
 namespace p2p {
 
+namespace {
+// Formats timestamps, redoing the date and time only when the second changes
+class TimestampFormatter {
+public:
+  void append(std::string &output, std::chrono::system_clock::time_point time) {
+    auto since_epoch = time.time_since_epoch();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    auto ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch -
+                                                              seconds)
+            .count();
+    std::time_t second = seconds.count();
+    if (second != this->second_) {
+      struct tm local;
+      localtime_r(&second, &local);
+      this->length_ = std::strftime(this->text_, sizeof(this->text_),
+                                    "%Y-%m-%d %H:%M:%S", &local);
+      this->second_ = second;
+    }
+    output.append(this->text_, this->length_);
+    char millis[] = {'.', static_cast<char>('0' + ms / 100),
+                     static_cast<char>('0' + ms / 10 % 10),
+                     static_cast<char>('0' + ms % 10)};
+    output.append(millis, sizeof(millis));
+  }
+
+private:
+  std::time_t second_{-1};
+  char text_[32];
+  size_t length_{0};
+};
+} // namespace
+
+/**
+ * Bounded multi-producer, single-consumer queue in front of a writer thread.
+ * Every slot carries a sequence number telling producers and the writer
+ * whose turn it is, so neither side takes a lock; producers only contend on
+ * claiming a position.
+ */
+class Logger::Writer {
+public:
+  Writer() : slots_(constants::logger::QUEUE_CAPACITY) {
+    static_assert((constants::logger::QUEUE_CAPACITY &
+                   (constants::logger::QUEUE_CAPACITY - 1)) == 0);
+    for (size_t i = 0; i < this->slots_.size(); ++i) {
+      this->slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    this->thread_ = std::thread([this]() { this->run_(); });
+  }
+
+  void push(LogLevel level, std::string &&message) {
+    auto time = std::chrono::system_clock::now();
+    if (this->stopping_.load(std::memory_order_acquire)) {
+      // The writer is gone at exit; later messages are written directly
+      TimestampFormatter formatter;
+      std::string line;
+      appendLine_(line, formatter, time, level, message);
+      fputs(line.c_str(), stderr);
+      fflush(stderr);
+      return;
+    }
+    while (!this->tryPush_(level, time, message)) {
+      if (this->policy.load(std::memory_order_relaxed) ==
+          LogOverflowPolicy::DROP) {
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      this->wake_();
+      std::this_thread::yield();
+    }
+    this->wake_();
+  }
+
+  void flush() {
+    size_t target = this->enqueue_position_.load(std::memory_order_acquire);
+    size_t written = this->written_.load(std::memory_order_acquire);
+    while (written < target && !this->stopping_.load()) {
+      this->wake_();
+      this->written_.wait(written, std::memory_order_acquire);
+      written = this->written_.load(std::memory_order_acquire);
+    }
+  }
+
+  void stop() {
+    this->stopping_.store(true, std::memory_order_release);
+    this->sleeping_.store(false);
+    this->sleeping_.notify_one();
+    this->thread_.join();
+    // Anything pushed while the writer was finishing
+    std::string batch;
+    while (this->drain_(batch) > 0) {
+    }
+  }
+
+  std::atomic<LogOverflowPolicy> policy{LogOverflowPolicy::BLOCK};
+  std::atomic<uint64_t> dropped{0};
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    std::chrono::system_clock::time_point time;
+    std::string message;
+  };
+
+  bool tryPush_(LogLevel level, std::chrono::system_clock::time_point time,
+                std::string &message) {
+    size_t position = this->enqueue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = this->slots_[position & (this->slots_.size() - 1)];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+      if (difference == 0) {
+        if (this->enqueue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          slot.level = level;
+          slot.time = time;
+          slot.message = std::move(message);
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        // Still holds a message from one lap ago
+        return false;
+      } else {
+        position = this->enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void wake_() {
+    // Pairs with the fence in run_(): either the writer sees the message or
+    // this sees the writer asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->sleeping_.load(std::memory_order_relaxed) &&
+        this->sleeping_.exchange(false)) {
+      this->sleeping_.notify_one();
+    }
+  }
+
+  bool empty_() const {
+    const Slot &slot =
+        this->slots_[this->dequeue_position_ & (this->slots_.size() - 1)];
+    return slot.sequence.load(std::memory_order_acquire) !=
+           this->dequeue_position_ + 1;
+  }
+
+  void run_() {
+    std::string batch;
+    while (true) {
+      if (this->drain_(batch) > 0) {
+        continue;
+      }
+      if (this->stopping_.load(std::memory_order_acquire)) {
+        return;
+      }
+      this->sleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!this->empty_() || this->stopping_.load()) {
+        this->sleeping_.store(false, std::memory_order_relaxed);
+        continue;
+      }
+      this->sleeping_.wait(true);
+    }
+  }
+
+  // Writes up to MAX_BATCH_SIZE queued messages with a single write
+  size_t drain_(std::string &batch) {
+    batch.clear();
+    size_t count = 0;
+    while (count < constants::logger::MAX_BATCH_SIZE && !this->empty_()) {
+      Slot &slot =
+          this->slots_[this->dequeue_position_ & (this->slots_.size() - 1)];
+      appendLine_(batch, this->formatter_, slot.time, slot.level,
+                  slot.message);
+      slot.message.clear();
+      slot.sequence.store(this->dequeue_position_ + this->slots_.size(),
+                          std::memory_order_release);
+      this->dequeue_position_++;
+      count++;
+    }
+    uint64_t dropped_now = this->dropped.load(std::memory_order_relaxed);
+    if (dropped_now != this->reported_dropped_) {
+      appendLine_(batch, this->formatter_, std::chrono::system_clock::now(),
+                  LogLevel::ERROR,
+                  "Dropped " +
+                      std::to_string(dropped_now - this->reported_dropped_) +
+                      " log messages");
+      this->reported_dropped_ = dropped_now;
+    }
+    if (!batch.empty()) {
+      fwrite(batch.data(), 1, batch.size(), stderr);
+      fflush(stderr);
+    }
+    if (count > 0) {
+      this->written_.fetch_add(count, std::memory_order_release);
+      this->written_.notify_all();
+    }
+    return count;
+  }
+
+  static void appendLine_(std::string &output, TimestampFormatter &formatter,
+                          std::chrono::system_clock::time_point time,
+                          LogLevel level, const std::string &message) {
+    formatter.append(output, time);
+    output += " [Node ";
+    output += std::to_string(node_id);
+    output += "] [";
+    output += levelToString(level);
+    output += "] ";
+    output += message;
+    output += '\n';
+  }
+
+  std::vector<Slot> slots_;
+  alignas(64) std::atomic<size_t> enqueue_position_{0};
+  // Owned by the writer thread, like formatter_ and reported_dropped_
+  alignas(64) size_t dequeue_position_{0};
+  TimestampFormatter formatter_;
+  uint64_t reported_dropped_{0};
+  // Messages written so far, waited on by flush()
+  std::atomic<size_t> written_{0};
+  std::atomic<bool> sleeping_{false};
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+};
+
 uint32_t Logger::node_id = 0;
 
-void Logger::log(LogLevel level, const std::string &message) {
-  std::string timestamp = getCurrentTimestamp();
-  std::string output = timestamp + " [Node " + std::to_string(node_id) + "] [" +
-                       levelToString(level) + "] " + message + "\n";
-  fputs(output.c_str(), stderr);
-  fflush(stderr);
+void Logger::log(LogLevel level, std::string message) {
+  if (level < MIN_LOG_LEVEL) {
+    return;
+  }
+  writer_().push(level, std::move(message));
+}
+
+void Logger::setOverflowPolicy(LogOverflowPolicy policy) {
+  writer_().policy.store(policy, std::memory_order_relaxed);
+}
+
+void Logger::flush() { writer_().flush(); }
+
+uint64_t Logger::getDroppedCount() {
+  return writer_().dropped.load(std::memory_order_relaxed);
 }
 
+Logger::Writer &Logger::writer_() {
+  // Never destroyed, so that statics logging from their destructors find it;
+  // the queue is drained at exit instead
+  static Writer *writer = []() {
+    auto *created = new Writer();
+    std::atexit([]() { writer_().stop(); });
+    return created;
+  }();
+  return *writer;
+}
+
+bool Logger::copyToPlaceholder_(std::string &output,
+                                std::string_view &format) {
+  while (true) {
+    size_t brace = format.find_first_of("{}");
+    if (brace == std::string_view::npos || brace + 1 == format.size()) {
+      output += format;
+      format = {};
+      return false;
+    }
+    output += format.substr(0, brace);
+    char current = format[brace];
+    char next = format[brace + 1];
+    if (current == '{' && next == '}') {
+      format.remove_prefix(brace + 2);
+      return true;
+    }
+    // {{ and }} are escapes; a lone brace is kept as it is
+    output += current;
+    format.remove_prefix(brace + (next == current ? 2 : 1));
+  }
+};
+
 const char *Logger::levelToString(LogLevel level) {
   switch (level) {
+  case LogLevel::TRACE:
+    return "TRACE";
+  case LogLevel::DEBUG:
+    return "DEBUG";
   case LogLevel::INFO:
     return "INFO";
   case LogLevel::ERROR:
@@ -23,18 +304,4 @@ const char *Logger::levelToString(LogLevel level) {
   }
 }
 
-std::string Logger::getCurrentTimestamp() {
-  auto now = std::chrono::system_clock::now();
-  auto time = std::chrono::system_clock::to_time_t(now);
-  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now.time_since_epoch()) %
-            1000;
-
-  std::ostringstream timestamp;
-  timestamp << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S") << '.'
-            << std::setfill('0') << std::setw(3) << ms.count();
-
-  return timestamp.str();
-}
-
 } // namespace p2p
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <p2p-resource-sync/constants.hpp>
+#include <p2p-resource-sync/name_index.hpp>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace p2p {
+
+bool NameIndex::insert(const std::string &name) {
+  std::unique_lock lock(this->mutex_);
+  if (this->ids_.contains(name)) {
+    return false;
+  }
+
+  uint32_t id;
+  if (this->free_ids_.empty()) {
+    id = static_cast<uint32_t>(this->entries_.size());
+    this->entries_.emplace_back();
+  } else {
+    id = this->free_ids_.back();
+    this->free_ids_.pop_back();
+  }
+
+  auto &entry = this->entries_[id];
+  entry.name = name;
+  entry.folded = fold_(name);
+  auto trigrams = trigrams_(entry.folded);
+  entry.trigramCount = trigrams.size();
+  entry.live = true;
+
+  for (auto trigram : trigrams) {
+    this->postings_[trigram].insert(id);
+  }
+  this->sorted_.emplace(entry.folded, id);
+  this->ids_.emplace(name, id);
+  return true;
+};
+
+bool NameIndex::erase(const std::string &name) {
+  std::unique_lock lock(this->mutex_);
+  auto id_it = this->ids_.find(name);
+  if (id_it == this->ids_.end()) {
+    return false;
+  }
+  uint32_t id = id_it->second;
+  this->ids_.erase(id_it);
+
+  auto &entry = this->entries_[id];
+  for (auto trigram : trigrams_(entry.folded)) {
+    auto posting_it = this->postings_.find(trigram);
+    posting_it->second.erase(id);
+    if (posting_it->second.empty()) {
+      this->postings_.erase(posting_it);
+    }
+  }
+  this->sorted_.erase({entry.folded, id});
+  entry = Entry{.name = {}, .folded = {}, .trigramCount = 0, .live = false};
+  this->free_ids_.push_back(id);
+  return true;
+};
+
+size_t NameIndex::size() const {
+  std::shared_lock lock(this->mutex_);
+  return this->ids_.size();
+};
+
+std::vector<NameIndex::Match> NameIndex::search(std::string_view query,
+                                                size_t limit) const {
+  std::string folded_query = fold_(query);
+  if (folded_query.empty() || limit == 0) {
+    return {};
+  }
+
+  std::shared_lock lock(this->mutex_);
+  std::unordered_map<uint32_t, Match> matches;
+  auto add_containing = [&](uint32_t id) {
+    const auto &entry = this->entries_[id];
+    auto position = entry.folded.find(folded_query);
+    if (position == std::string::npos) {
+      return;
+    }
+    // Ranked by how much of the name the query covers
+    double coverage = static_cast<double>(folded_query.size()) /
+                      static_cast<double>(entry.folded.size());
+    MatchKind kind = coverage == 1.0  ? MatchKind::EXACT
+                     : position == 0 ? MatchKind::PREFIX
+                                     : MatchKind::SUBSTRING;
+    double base = kind == MatchKind::SUBSTRING ? 1.0 : 2.0;
+    matches.emplace(id, Match{.name = entry.name,
+                              .kind = kind,
+                              .score = base + coverage});
+  };
+
+  // Prefix matches are a contiguous range of the sorted names
+  for (auto it = this->sorted_.lower_bound({folded_query, 0});
+       it != this->sorted_.end() && it->first.starts_with(folded_query) &&
+       matches.size() < constants::name_index::MAX_CANDIDATES;
+       ++it) {
+    add_containing(it->second);
+  }
+
+  auto query_trigrams = trigrams_(folded_query);
+  if (query_trigrams.empty()) {
+    // Too short for the trigram index, scan every name
+    for (uint32_t id = 0; id < this->entries_.size() &&
+                          matches.size() < constants::name_index::MAX_CANDIDATES;
+         ++id) {
+      const auto &entry = this->entries_[id];
+      if (entry.live && containsSubstring(entry.folded, folded_query)) {
+        add_containing(id);
+      }
+    }
+  } else {
+    // Every substring match is in each of the query's posting lists, so
+    // verifying the shortest one is enough
+    const std::unordered_set<uint32_t> *shortest = nullptr;
+    for (auto trigram : query_trigrams) {
+      auto posting_it = this->postings_.find(trigram);
+      if (posting_it == this->postings_.end()) {
+        shortest = nullptr;
+        break;
+      }
+      if (!shortest || posting_it->second.size() < shortest->size()) {
+        shortest = &posting_it->second;
+      }
+    }
+    if (shortest) {
+      for (auto id : *shortest) {
+        if (matches.size() >= constants::name_index::MAX_CANDIDATES) {
+          break;
+        }
+        if (!matches.contains(id) &&
+            containsSubstring(this->entries_[id].folded, folded_query)) {
+          add_containing(id);
+        }
+      }
+    }
+
+    if (matches.size() < limit) {
+      // Fuzzy matches: Dice coefficient over the trigram sets
+      std::unordered_map<uint32_t, size_t> shared_trigrams;
+      for (auto trigram : query_trigrams) {
+        auto posting_it = this->postings_.find(trigram);
+        if (posting_it == this->postings_.end()) {
+          continue;
+        }
+        for (auto id : posting_it->second) {
+          shared_trigrams[id]++;
+        }
+      }
+      for (const auto &[id, shared] : shared_trigrams) {
+        if (matches.contains(id)) {
+          continue;
+        }
+        const auto &entry = this->entries_[id];
+        double similarity =
+            2.0 * static_cast<double>(shared) /
+            static_cast<double>(query_trigrams.size() + entry.trigramCount);
+        if (similarity >= constants::name_index::FUZZY_MIN_SIMILARITY) {
+          matches.emplace(id, Match{.name = entry.name,
+                                    .kind = MatchKind::FUZZY,
+                                    .score = similarity});
+        }
+      }
+    }
+  }
+
+  std::vector<Match> ranked;
+  ranked.reserve(matches.size());
+  for (auto &[id, match] : matches) {
+    ranked.push_back(std::move(match));
+  }
+  auto better = [](const Match &a, const Match &b) {
+    if (a.score != b.score) {
+      return a.score > b.score;
+    }
+    return a.name < b.name;
+  };
+  if (ranked.size() > limit) {
+    std::ranges::partial_sort(ranked, ranked.begin() + limit, better);
+    ranked.resize(limit);
+  } else {
+    std::ranges::sort(ranked, better);
+  }
+  return ranked;
+};
+
+bool NameIndex::containsSubstring(std::string_view haystack,
+                                  std::string_view needle) {
+  if (needle.empty()) {
+    return true;
+  }
+  if (needle.size() > haystack.size()) {
+    return false;
+  }
+
+  size_t position = 0;
+#if defined(__SSE2__)
+  // Compares the first and last needle characters against 16 candidate
+  // positions at once and only verifies positions where both match
+  const size_t last = needle.size() - 1;
+  const __m128i first_char = _mm_set1_epi8(needle.front());
+  const __m128i last_char = _mm_set1_epi8(needle.back());
+  for (; position + last + 16 <= haystack.size(); position += 16) {
+    __m128i block_first = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(haystack.data() + position));
+    __m128i block_last = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(haystack.data() + position + last));
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first_char, block_first),
+                      _mm_cmpeq_epi8(last_char, block_last))));
+    while (mask != 0) {
+      size_t candidate = position + std::countr_zero(mask);
+      if (needle.size() <= 2 ||
+          std::memcmp(haystack.data() + candidate + 1, needle.data() + 1,
+                      needle.size() - 2) == 0) {
+        return true;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  return haystack.substr(position).find(needle) != std::string_view::npos;
+};
+
+std::string NameIndex::fold_(std::string_view text) {
+  std::string folded(text);
+  std::ranges::transform(folded, folded.begin(), [](unsigned char c) {
+    return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+  });
+  return folded;
+};
+
+std::vector<uint32_t> NameIndex::trigrams_(std::string_view folded) {
+  std::vector<uint32_t> trigrams;
+  if (folded.size() < 3) {
+    return trigrams;
+  }
+  trigrams.reserve(folded.size() - 2);
+  for (size_t i = 0; i + 3 <= folded.size(); ++i) {
+    trigrams.push_back(static_cast<uint32_t>(
+        static_cast<unsigned char>(folded[i]) << 16 |
+        static_cast<unsigned char>(folded[i + 1]) << 8 |
+        static_cast<unsigned char>(folded[i + 2])));
+  }
+  std::ranges::sort(trigrams);
+  auto duplicates = std::ranges::unique(trigrams);
+  trigrams.erase(duplicates.begin(), duplicates.end());
+  return trigrams;
+};
+
+} // namespace p2p
@@ -0,0 +1,73 @@
+#include <p2p-resource-sync/constants.hpp>
+#include <p2p-resource-sync/name_pool.hpp>
+#include <stdexcept>
+
+namespace p2p {
+
+NamePool::NamePool()
+    : chunks_(std::make_unique<std::atomic<Entry *>[]>(
+          constants::name_pool::MAX_CHUNKS)) {};
+
+NamePool::~NamePool() {
+  for (size_t chunk = 0; chunk < constants::name_pool::MAX_CHUNKS; ++chunk) {
+    delete[] this->chunks_[chunk].load();
+  }
+};
+
+uint32_t NamePool::acquire(std::string_view name) {
+  std::lock_guard lock(this->mutex_);
+  if (auto it = this->ids_.find(name); it != this->ids_.end()) {
+    this->entry_(it->second).references++;
+    return it->second;
+  }
+
+  uint32_t id;
+  if (!this->free_ids_.empty()) {
+    id = this->free_ids_.back();
+    this->free_ids_.pop_back();
+  } else {
+    id = this->next_id_;
+    size_t chunk = id / constants::name_pool::CHUNK_SIZE;
+    if (chunk >= constants::name_pool::MAX_CHUNKS) {
+      throw std::runtime_error("Name pool exhausted");
+    }
+    if (id % constants::name_pool::CHUNK_SIZE == 0) {
+      this->chunks_[chunk].store(new Entry[constants::name_pool::CHUNK_SIZE],
+                                 std::memory_order_release);
+    }
+    this->next_id_++;
+  }
+
+  auto &entry = this->entry_(id);
+  entry.name.assign(name);
+  entry.references = 1;
+  this->ids_.emplace(entry.name, id);
+  return id;
+};
+
+void NamePool::release(uint32_t id) {
+  std::lock_guard lock(this->mutex_);
+  auto &entry = this->entry_(id);
+  if (--entry.references > 0) {
+    return;
+  }
+  this->ids_.erase(entry.name);
+  entry.name = std::string();
+  this->free_ids_.push_back(id);
+};
+
+std::string_view NamePool::name(uint32_t id) const {
+  return this->entry_(id).name;
+};
+
+size_t NamePool::size() const {
+  std::lock_guard lock(this->mutex_);
+  return this->ids_.size();
+};
+
+NamePool::Entry &NamePool::entry_(uint32_t id) const {
+  return this->chunks_[id / constants::name_pool::CHUNK_SIZE].load(
+      std::memory_order_acquire)[id % constants::name_pool::CHUNK_SIZE];
+};
+
+} // namespace p2p
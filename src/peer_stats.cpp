@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <p2p-resource-sync/peer_stats.hpp>
+#include <tuple>
+
+namespace p2p {
+
+namespace {
+double blend(double average, double sample) {
+  return average +
+         constants::peer_stats::EWMA_WEIGHT * (sample - average);
+}
+} // namespace
+
+PeerStatsTable::PeerStatsTable(double exploration_rate)
+    : exploration_rate_(exploration_rate),
+      random_engine_(std::random_device{}()) {};
+
+void PeerStatsTable::transferStarted(const struct sockaddr_in &peer) {
+  std::lock_guard lock(this->mutex_);
+  this->stats_[key_(peer)].activeTransfers++;
+};
+
+void PeerStatsTable::recordAttempt(const struct sockaddr_in &peer,
+                                   const TransferSample &sample) {
+  std::lock_guard lock(this->mutex_);
+  auto &stats = this->stats_[key_(peer)];
+  bool first = stats.attempts++ == 0;
+
+  double failed = sample.succeeded ? 0.0 : 1.0;
+  stats.failureRate = first ? failed : blend(stats.failureRate, failed);
+
+  if (sample.rtt) {
+    auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(*sample.rtt);
+    stats.rtt = stats.rtt.count() == 0
+                    ? rtt
+                    : std::chrono::microseconds(static_cast<int64_t>(blend(
+                          stats.rtt.count(), static_cast<double>(rtt.count()))));
+  }
+
+  double seconds = std::chrono::duration<double>(sample.duration).count();
+  if (sample.bytes > 0 && seconds > 0) {
+    double throughput = static_cast<double>(sample.bytes) / seconds;
+    stats.throughputBytesPerSecond =
+        stats.throughputBytesPerSecond == 0
+            ? throughput
+            : blend(stats.throughputBytesPerSecond, throughput);
+  }
+};
+
+void PeerStatsTable::transferFinished(const struct sockaddr_in &peer) {
+  std::lock_guard lock(this->mutex_);
+  auto stats_it = this->stats_.find(key_(peer));
+  if (stats_it != this->stats_.end() && stats_it->second.activeTransfers > 0) {
+    stats_it->second.activeTransfers--;
+  }
+};
+
+std::optional<PeerStats>
+PeerStatsTable::get(const struct sockaddr_in &peer) const {
+  std::lock_guard lock(this->mutex_);
+  auto stats_it = this->stats_.find(key_(peer));
+  if (stats_it == this->stats_.end()) {
+    return std::nullopt;
+  }
+  return stats_it->second;
+};
+
+void PeerStatsTable::retain(
+    const std::function<bool(const struct sockaddr_in &)> &keep) {
+  std::lock_guard lock(this->mutex_);
+  std::erase_if(this->stats_, [&keep](const auto &entry) {
+    struct sockaddr_in peer {};
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = static_cast<uint32_t>(entry.first >> 16);
+    peer.sin_port = static_cast<uint16_t>(entry.first);
+    return entry.second.activeTransfers == 0 && !keep(peer);
+  });
+};
+
+std::vector<struct sockaddr_in>
+PeerStatsTable::rank(const std::vector<Candidate> &candidates) const {
+  struct Ranked {
+    struct sockaddr_in address;
+    bool deprioritised;
+    bool unhealthy;
+    double cost;
+  };
+
+  std::lock_guard lock(this->mutex_);
+  std::vector<Ranked> ranked;
+  ranked.reserve(candidates.size());
+  for (const auto &candidate : candidates) {
+    auto stats_it = this->stats_.find(key_(candidate.address));
+    const PeerStats *stats =
+        stats_it == this->stats_.end() ? nullptr : &stats_it->second;
+    ranked.push_back(Ranked{
+        .address = candidate.address,
+        .deprioritised = candidate.deprioritised,
+        .unhealthy = stats && stats->attempts > 0 &&
+                     stats->failureRate >=
+                         constants::peer_stats::UNHEALTHY_FAILURE_RATE,
+        .cost = this->expectedCost_(stats, candidate.size)});
+  }
+  std::ranges::stable_sort(ranked, [](const Ranked &a, const Ranked &b) {
+    return std::tie(a.deprioritised, a.unhealthy, a.cost) <
+           std::tie(b.deprioritised, b.unhealthy, b.cost);
+  });
+
+  // Only peers as eligible as the best one are explored
+  size_t eligible = std::ranges::count_if(ranked, [&ranked](const Ranked &r) {
+    return r.deprioritised == ranked.front().deprioritised &&
+           r.unhealthy == ranked.front().unhealthy;
+  });
+  if (eligible > 1 &&
+      std::bernoulli_distribution(this->exploration_rate_)(
+          this->random_engine_)) {
+    size_t explored = std::uniform_int_distribution<size_t>(
+        1, eligible - 1)(this->random_engine_);
+    std::rotate(ranked.begin(), ranked.begin() + explored,
+                ranked.begin() + explored + 1);
+  }
+
+  std::vector<struct sockaddr_in> addresses;
+  addresses.reserve(ranked.size());
+  for (const auto &entry : ranked) {
+    addresses.push_back(entry.address);
+  }
+  return addresses;
+};
+
+void PeerStatsTable::setExplorationRate(double exploration_rate) {
+  std::lock_guard lock(this->mutex_);
+  this->exploration_rate_ = exploration_rate;
+};
+
+uint64_t PeerStatsTable::key_(const struct sockaddr_in &peer) {
+  return static_cast<uint64_t>(peer.sin_addr.s_addr) << 16 | peer.sin_port;
+};
+
+double PeerStatsTable::expectedCost_(const PeerStats *stats,
+                                     uint64_t size) const {
+  if (!stats || stats->throughputBytesPerSecond == 0) {
+    return 0.0;
+  }
+  double seconds = std::chrono::duration<double>(stats->rtt).count() +
+                   static_cast<double>(size) / stats->throughputBytesPerSecond;
+  double success = std::max(1.0 - stats->failureRate,
+                            constants::peer_stats::MIN_SUCCESS_PROBABILITY);
+  return seconds / success * (1 + stats->activeTransfers);
+};
+
+} // namespace p2p
@@ -4,14 +4,36 @@
 #include <cstdint>
 #include <mutex>
 #include <netinet/in.h>
+#include <p2p-resource-sync/catalog_snapshot.hpp>
+#include <p2p-resource-sync/constants.hpp>
 #include <p2p-resource-sync/logger.hpp>
 #include <p2p-resource-sync/remote_resource_manager.hpp>
-#include <shared_mutex>
 #include <string>
 #include <vector>
 
 namespace p2p {
 
+CompactCatalog::CompactCatalog(std::shared_ptr<NamePool> pool,
+                               const std::vector<Resource> &resources)
+    : pool_(std::move(pool)) {
+  this->entries_.reserve(resources.size());
+  for (const auto &resource : resources) {
+    this->entries_.push_back(Entry{.nameId = this->pool_->acquire(resource.name),
+                                   .size = resource.size});
+  }
+};
+
+CompactCatalog::~CompactCatalog() {
+  for (const auto &entry : this->entries_) {
+    this->pool_->release(entry.nameId);
+  }
+};
+
+Resource CompactCatalog::resourceAt(size_t position) const {
+  const auto &entry = this->entries_[position];
+  return Resource{.name = std::string(this->name(entry)), .size = entry.size};
+};
+
 bool RemoteResourceManager::SockAddrCompare::operator()(
     const struct sockaddr_in &a, const struct sockaddr_in &b) const {
   if (a.sin_addr.s_addr != b.sin_addr.s_addr)
@@ -19,85 +41,747 @@ bool RemoteResourceManager::SockAddrCompare::operator()(
   return a.sin_port < b.sin_port;
 }
 
+RemoteResourceManager::IndexShard &
+RemoteResourceManager::SnapshotBuilder::shardFor(
+    std::string_view resource_name) {
+  size_t shard = shardIndex_(resource_name);
+  if (!this->copied[shard]) {
+    this->copied[shard] = std::make_shared<IndexShard>(*this->index[shard]);
+    this->index[shard] = this->copied[shard];
+  }
+  return *this->copied[shard];
+}
+
+RemoteResourceManager::RemoteResourceManager(std::chrono::seconds interval)
+    : name_pool_(std::make_shared<NamePool>()), cleanup_interval_(interval) {
+  auto empty_shard = std::make_shared<const IndexShard>();
+  this->snapshot_.store(std::make_shared<const Snapshot>(Snapshot{
+      .version = 0,
+      .nodes = {},
+      .index = std::vector<std::shared_ptr<const IndexShard>>(
+          constants::remote_resource_manager::INDEX_SHARDS, empty_shard)}));
+};
+
 std::vector<std::pair<struct sockaddr_in, Resource>>
 RemoteResourceManager::getAllResources() const {
-  std::shared_lock lock(this->mutex_);
+  auto snapshot = this->snapshot_.load();
   std::vector<std::pair<struct sockaddr_in, Resource>> resources;
-  for (const auto &[node_addr, node_data] : this->nodes_) {
-    for (const auto &resource : node_data.resources) {
-      resources.emplace_back(node_addr, resource);
+  for (const auto &[node_addr, node_data] : snapshot->nodes) {
+    for (size_t i = 0; i < node_data.resources->size(); ++i) {
+      resources.emplace_back(node_addr, node_data.resources->resourceAt(i));
     }
   }
   return resources;
 };
 
-void RemoteResourceManager::addOrUpdateNodeResources(
-    const struct sockaddr_in &node_address,
-    const std::vector<Resource> &resources, uint64_t timestamp) {
-  std::unique_lock lock(this->mutex_);
+void RemoteResourceManager::forEachResource(
+    const ResourceVisitor &visitor) const {
+  auto snapshot = this->snapshot_.load();
+  for (const auto &[node_addr, node_data] : snapshot->nodes) {
+    const auto &catalog = *node_data.resources;
+    for (const auto &entry : catalog.entries()) {
+      visitor(node_addr, catalog.name(entry), entry.size);
+    }
+  }
+};
 
-  auto it = this->nodes_.find(node_address);
-  if (it != this->nodes_.end()) {
-    auto incoming_time = std::chrono::system_clock::time_point(
-        std::chrono::nanoseconds(timestamp));
+RemoteResourcePage RemoteResourceManager::getResourcePage(
+    const std::optional<RemoteResourceCursor> &from, size_t limit) const {
+  auto snapshot = this->snapshot_.load();
+  RemoteResourcePage page;
 
-    if (incoming_time <= it->second.lastAnnouncementTime) {
-      return;
+  size_t position = from ? nodePosition_(snapshot->nodes, from->node) : 0;
+  size_t offset = 0;
+  if (position < snapshot->nodes.size() && from &&
+      !SockAddrCompare{}(from->node, snapshot->nodes[position].address)) {
+    offset = from->offset;
+  }
+  for (; position < snapshot->nodes.size(); ++position, offset = 0) {
+    const auto &[node_addr, node_data] = snapshot->nodes[position];
+    for (; offset < node_data.resources->size(); ++offset) {
+      if (page.resources.size() == limit) {
+        page.nextCursor =
+            RemoteResourceCursor{.node = node_addr, .offset = offset};
+        return page;
+      }
+      page.resources.emplace_back(node_addr,
+                                  node_data.resources->resourceAt(offset));
     }
   }
+  return page;
+};
+
+SharedCatalog
+RemoteResourceManager::internCatalog_(const std::vector<Resource> &resources,
+                                      std::optional<uint64_t> catalog_digest) {
+  auto catalog =
+      std::make_shared<const CompactCatalog>(this->name_pool_, resources);
+  if (!catalog_digest) {
+    return catalog;
+  }
+
+  std::lock_guard lock(this->catalog_pool_mutex_);
+  auto &pooled = this->catalog_pool_[*catalog_digest];
+  // Names are interned, so equal entries mean equal catalogs
+  if (auto existing = pooled.lock();
+      existing && existing->entries() == catalog->entries()) {
+    return existing;
+  }
+  pooled = catalog;
+  return catalog;
+};
+
+void RemoteResourceManager::addOrUpdateNodeResources(
+    const struct sockaddr_in &node_address, std::vector<Resource> resources,
+    uint64_t timestamp, std::optional<uint64_t> catalog_digest) {
+  auto incoming_time = std::chrono::system_clock::time_point(
+      std::chrono::nanoseconds(timestamp));
+  // Built before queueing so the writer only swaps pointers
+  SharedCatalog catalog = this->internCatalog_(resources, catalog_digest);
+
+  std::vector<PendingUpdate> updates;
+  updates.push_back(PendingUpdate{.kind = PendingUpdate::Kind::UPSERT,
+                                  .address = node_address,
+                                  .catalog = std::move(catalog),
+                                  .time = incoming_time,
+                                  .digest = catalog_digest,
+                                  .provisional = false});
+  this->submit_(std::move(updates));
+};
+
+bool RemoteResourceManager::refreshNode(const struct sockaddr_in &node_address,
+                                        uint64_t catalog_digest,
+                                        uint64_t timestamp) {
+  auto snapshot = this->snapshot_.load();
+
+  const auto *node = findNode_(snapshot->nodes, node_address);
+  if (!node || node->catalogDigest != catalog_digest) {
+    return false;
+  }
+
+  auto incoming_time = std::chrono::system_clock::time_point(
+      std::chrono::nanoseconds(timestamp));
+  auto &last_time = *node->lastAnnouncementTime;
+  auto current_time = last_time.load();
+  while (incoming_time > current_time &&
+         !last_time.compare_exchange_weak(current_time, incoming_time)) {
+  }
 
-  this->nodes_[node_address] =
-      RemoteNode{.resources = resources,
-                 .lastAnnouncementTime = std::chrono::system_clock::time_point(
-                     std::chrono::nanoseconds(timestamp))};
+  if (node->provisional) {
+    std::vector<PendingUpdate> updates;
+    updates.push_back(PendingUpdate{.kind = PendingUpdate::Kind::CONFIRM,
+                                    .address = node_address,
+                                    .catalog = nullptr,
+                                    .time = incoming_time,
+                                    .digest = catalog_digest,
+                                    .provisional = false});
+    this->submit_(std::move(updates));
+  }
+  return true;
 };
 
 bool RemoteResourceManager::hasResource(
     const struct sockaddr_in &node_address,
     const std::string &resource_name) const {
-  std::shared_lock lock(this->mutex_);
+  auto snapshot = this->snapshot_.load();
+  const auto *holders = findHolders_(*snapshot, resource_name);
+  return holders && std::ranges::binary_search(*holders, node_address,
+                                               SockAddrCompare{},
+                                               &ResourceHolder::address);
+};
 
-  auto node_it = nodes_.find(node_address);
-  if (node_it == nodes_.end())
-    return false;
+std::vector<ResourceHolder> RemoteResourceManager::findResourceHolders(
+    const std::string &resource_name) const {
+  auto snapshot = this->snapshot_.load();
+  const auto *holders = findHolders_(*snapshot, resource_name);
+  return holders ? *holders : std::vector<ResourceHolder>{};
+};
 
-  auto resource_it = std::ranges::find_if(
-      node_it->second.resources, [&resource_name](const Resource &res) {
-        return res.name == resource_name;
-      });
-  return resource_it != node_it->second.resources.end();
+std::vector<ResourceMatch>
+RemoteResourceManager::searchResources(const std::string &query,
+                                       size_t limit) const {
+  auto names = this->name_index_.search(query, limit);
+  // Loaded after searching, so names found are at most as old as the snapshot
+  auto snapshot = this->snapshot_.load();
+  std::vector<ResourceMatch> matches;
+  matches.reserve(names.size());
+  for (auto &match : names) {
+    const auto *holders = findHolders_(*snapshot, match.name);
+    if (!holders) {
+      continue;
+    }
+    matches.push_back(ResourceMatch{.name = std::move(match.name),
+                                    .kind = match.kind,
+                                    .score = match.score,
+                                    .holders = *holders});
+  }
+  return matches;
 };
 
 std::vector<struct sockaddr_in> RemoteResourceManager::findNodesWithResource(
     const std::string &resource_name) const {
-  std::shared_lock lock(this->mutex_);
   std::vector<struct sockaddr_in> found_nodes;
-
-  for (const auto &[node_addr, node_info] : this->nodes_) {
-    auto resource_it = std::ranges::find_if(
-        node_info.resources, [&resource_name](const Resource &res) {
-          return res.name == resource_name;
-        });
-    if (resource_it != node_info.resources.end())
-      found_nodes.push_back(node_addr);
+  {
+    auto snapshot = this->snapshot_.load();
+    if (const auto *holders = findHolders_(*snapshot, resource_name)) {
+      found_nodes.reserve(holders->size());
+      for (const auto &holder : *holders) {
+        found_nodes.push_back(holder.address);
+      }
+      // Nodes restored from a snapshot may be gone, so they are tried last
+      std::ranges::stable_partition(found_nodes, [&snapshot](const auto &n) {
+        return !findNode_(snapshot->nodes, n)->provisional;
+      });
+    }
   }
 
+  if (auto lookup = this->provider_lookup_.load()) {
+    for (const auto &provider : (*lookup)(resource_name)) {
+      auto known = std::ranges::any_of(found_nodes, [&provider](const auto &n) {
+        return n.sin_addr.s_addr == provider.sin_addr.s_addr &&
+               n.sin_port == provider.sin_port;
+      });
+      if (!known) {
+        found_nodes.push_back(provider);
+      }
+    }
+  }
   return found_nodes;
 };
 
+std::vector<struct sockaddr_in>
+RemoteResourceManager::rankHolders(const std::string &resource_name) const {
+  auto nodes = this->findNodesWithResource(resource_name);
+  auto snapshot = this->snapshot_.load();
+  const auto *holders = findHolders_(*snapshot, resource_name);
+
+  std::vector<PeerStatsTable::Candidate> candidates;
+  candidates.reserve(nodes.size());
+  for (const auto &node_address : nodes) {
+    // Providers found through the lookup only may not be in the snapshot
+    uint64_t size = 0;
+    if (holders) {
+      auto holder_it =
+          std::ranges::lower_bound(*holders, node_address, SockAddrCompare{},
+                                   &ResourceHolder::address);
+      if (holder_it != holders->end() &&
+          !SockAddrCompare{}(node_address, holder_it->address)) {
+        size = holder_it->size;
+      }
+    }
+    const auto *node = findNode_(snapshot->nodes, node_address);
+    candidates.push_back(
+        PeerStatsTable::Candidate{.address = node_address,
+                                  .size = size,
+                                  .deprioritised = node && node->provisional});
+  }
+  return this->peer_stats_.rank(candidates);
+};
+
+void RemoteResourceManager::recordTransferStart(
+    const struct sockaddr_in &node_address) {
+  this->peer_stats_.transferStarted(node_address);
+};
+
+void RemoteResourceManager::recordTransferAttempt(
+    const struct sockaddr_in &node_address, const TransferSample &sample) {
+  this->peer_stats_.recordAttempt(node_address, sample);
+};
+
+void RemoteResourceManager::recordTransferEnd(
+    const struct sockaddr_in &node_address) {
+  this->peer_stats_.transferFinished(node_address);
+};
+
+std::optional<PeerStats> RemoteResourceManager::getPeerStats(
+    const struct sockaddr_in &node_address) const {
+  return this->peer_stats_.get(node_address);
+};
+
+void RemoteResourceManager::setExplorationRate(double exploration_rate) {
+  this->peer_stats_.setExplorationRate(exploration_rate);
+};
+
+void RemoteResourceManager::setProviderLookup(ProviderLookup lookup) {
+  this->provider_lookup_.store(
+      lookup ? std::make_shared<const ProviderLookup>(std::move(lookup))
+             : nullptr);
+};
+
+size_t RemoteResourceManager::getNodeCount() const {
+  return this->snapshot_.load()->nodes.size();
+};
+
+bool RemoteResourceManager::isProvisional(
+    const struct sockaddr_in &node_address) const {
+  auto snapshot = this->snapshot_.load();
+  const auto *node = findNode_(snapshot->nodes, node_address);
+  return node && node->provisional;
+};
+
+void RemoteResourceManager::saveSnapshot(
+    const std::filesystem::path &path) const {
+  // The catalogs are kept alive by the snapshot until the write is done
+  auto snapshot = this->snapshot_.load();
+  std::vector<CatalogSnapshotFile::NodeToSave> nodes;
+  nodes.reserve(snapshot->nodes.size());
+  for (const auto &[node_addr, node_data] : snapshot->nodes) {
+    nodes.push_back(CatalogSnapshotFile::NodeToSave{
+        .address = node_addr,
+        .lastSeen = node_data.lastAnnouncementTime->load(),
+        .catalogDigest = node_data.catalogDigest,
+        .catalog = node_data.resources.get()});
+  }
+  CatalogSnapshotFile::write(path, std::move(nodes),
+                             std::chrono::system_clock::now());
+};
+
+size_t RemoteResourceManager::loadSnapshot(const std::filesystem::path &path) {
+  CatalogSnapshotFile file(path);
+  auto now = std::chrono::system_clock::now();
+
+  std::vector<PendingUpdate> updates;
+  for (size_t i = 0; i < file.nodeCount(); ++i) {
+    auto node = file.node(i);
+    if (now - node.lastSeen >
+        constants::remote_resource_manager::MAX_SNAPSHOT_AGE) {
+      continue;
+    }
+    std::vector<Resource> resources;
+    resources.reserve(node.entries.size());
+    for (const auto &entry : node.entries) {
+      resources.push_back(Resource{.name = std::string(file.name(entry.nameId)),
+                                   .size = entry.size});
+    }
+    // Stamped with the load time: unless the node announces itself, it
+    // expires one cleanup interval from now
+    updates.push_back(PendingUpdate{
+        .kind = PendingUpdate::Kind::UPSERT,
+        .address = node.address,
+        .catalog = this->internCatalog_(resources, node.catalogDigest),
+        .time = now,
+        .digest = node.catalogDigest,
+        .provisional = true});
+  }
+
+  size_t restored = updates.size();
+  if (!updates.empty()) {
+    this->submit_(std::move(updates));
+  }
+  Logger::log<LogLevel::INFO>("Restored {} nodes from {}", restored,
+                              path.string());
+  return restored;
+};
+
+void RemoteResourceManager::enablePersistence(std::filesystem::path path,
+                                              std::chrono::seconds interval) {
+  if (std::filesystem::exists(path)) {
+    try {
+      this->loadSnapshot(path);
+    } catch (const std::exception &e) {
+      Logger::log<LogLevel::ERROR>("Failed to load catalog snapshot: {}",
+                                   e.what());
+    }
+  }
+  this->snapshot_path_ = std::move(path);
+  this->snapshot_interval_ = interval;
+};
+
+std::vector<struct sockaddr_in>
+RemoteResourceManager::getNodeAddresses() const {
+  auto snapshot = this->snapshot_.load();
+  std::vector<struct sockaddr_in> addresses;
+  addresses.reserve(snapshot->nodes.size());
+  for (const auto &[node_addr, node_info] : snapshot->nodes) {
+    addresses.push_back(node_addr);
+  }
+  return addresses;
+};
+
+uint64_t RemoteResourceManager::getSnapshotVersion() const {
+  return this->snapshot_.load()->version;
+};
+
+void RemoteResourceManager::removeNode(const struct sockaddr_in &node_address) {
+  std::vector<PendingUpdate> updates;
+  updates.push_back(PendingUpdate{.kind = PendingUpdate::Kind::REMOVE,
+                                  .address = node_address,
+                                  .catalog = nullptr,
+                                  .time = {},
+                                  .digest = std::nullopt,
+                                  .provisional = false});
+  this->submit_(std::move(updates));
+};
+
 void RemoteResourceManager::cleanupStaleNodes() {
-  std::unique_lock lock(this->mutex_);
   auto now = std::chrono::system_clock::now();
-  for (auto it = nodes_.begin(); it != nodes_.end();) {
-    if (now - it->second.lastAnnouncementTime >= this->cleanup_interval_) {
+  std::vector<PendingUpdate> updates;
+  std::vector<ExpiryEntry> rearmed;
+  {
+    std::lock_guard lock(this->expiry_mutex_);
+    // Loaded under the expiry lock: entries are armed only after the
+    // snapshot containing their node is published
+    auto snapshot = this->snapshot_.load();
+    while (!this->expiry_heap_.empty() &&
+           this->expiry_heap_.top().deadline <= now) {
+      auto entry = this->expiry_heap_.top();
+      this->expiry_heap_.pop();
+
+      const auto *node = findNode_(snapshot->nodes, entry.address);
+      auto last_seen = entry.lastSeen.lock();
+      if (!node || node->lastAnnouncementTime != last_seen) {
+        continue;
+      }
+      auto deadline = last_seen->load() + this->cleanup_interval_;
+      if (deadline > now) {
+        entry.deadline = deadline;
+        rearmed.push_back(std::move(entry));
+        continue;
+      }
+      // Rechecked when applied, the node may announce in the meantime
+      updates.push_back(
+          PendingUpdate{.kind = PendingUpdate::Kind::REMOVE_IF_STALE,
+                        .address = entry.address,
+                        .catalog = nullptr,
+                        .time = now,
+                        .digest = std::nullopt,
+                        .provisional = false});
+    }
+    for (auto &entry : rearmed) {
+      this->expiry_heap_.push(std::move(entry));
+    }
+  }
+  if (updates.empty()) {
+    return;
+  }
+  this->submit_(std::move(updates));
+
+  {
+    std::lock_guard pool_lock(this->catalog_pool_mutex_);
+    std::erase_if(this->catalog_pool_,
+                  [](const auto &entry) { return entry.second.expired(); });
+  }
+  auto snapshot = this->snapshot_.load();
+  this->peer_stats_.retain([&snapshot](const struct sockaddr_in &peer) {
+    return findNode_(snapshot->nodes, peer) != nullptr;
+  });
+};
+
+void RemoteResourceManager::run() {
+  this->running_ = true;
+  auto next_save = std::chrono::system_clock::now() + this->snapshot_interval_;
+  while (this->running_) {
+    this->cleanupStaleNodes();
+    if (this->snapshot_path_ && std::chrono::system_clock::now() >= next_save) {
+      this->persist_();
+      next_save = std::chrono::system_clock::now() + this->snapshot_interval_;
+    }
+
+    std::unique_lock lock(this->expiry_mutex_);
+    auto wake_at = this->expiry_heap_.empty()
+                       ? std::chrono::system_clock::now() +
+                             this->cleanup_interval_
+                       : this->expiry_heap_.top().deadline;
+    if (this->snapshot_path_) {
+      wake_at = std::min(wake_at, next_save);
+    }
+    // Woken early when a node with an earlier deadline is armed
+    this->expiry_cv_.wait_until(lock, wake_at, [this, wake_at]() {
+      return !this->running_ || (!this->expiry_heap_.empty() &&
+                                 this->expiry_heap_.top().deadline < wake_at);
+    });
+  }
+  if (this->snapshot_path_) {
+    this->persist_();
+  }
+};
+
+void RemoteResourceManager::stop() {
+  std::lock_guard lock(this->expiry_mutex_);
+  this->running_ = false;
+  this->expiry_cv_.notify_all();
+};
+
+void RemoteResourceManager::persist_() const {
+  try {
+    this->saveSnapshot(*this->snapshot_path_);
+  } catch (const std::exception &e) {
+    Logger::log<LogLevel::ERROR>("Failed to save catalog snapshot: {}",
+                                 e.what());
+  }
+};
+
+void RemoteResourceManager::armExpiry_(std::vector<ExpiryEntry> entries) {
+  if (entries.empty()) {
+    return;
+  }
+  std::lock_guard lock(this->expiry_mutex_);
+  auto earliest = this->expiry_heap_.empty()
+                      ? std::chrono::system_clock::time_point::max()
+                      : this->expiry_heap_.top().deadline;
+  for (auto &entry : entries) {
+    this->expiry_heap_.push(std::move(entry));
+  }
+  if (this->expiry_heap_.top().deadline < earliest) {
+    this->expiry_cv_.notify_all();
+  }
+};
+
+void RemoteResourceManager::submit_(std::vector<PendingUpdate> updates) {
+  uint64_t ticket;
+  {
+    std::lock_guard lock(this->pending_mutex_);
+    ticket = ++this->next_ticket_;
+    std::ranges::move(updates, std::back_inserter(this->pending_));
+  }
+
+  // Flat combining: the writer holding the lock applies everything queued
+  // so far, including the updates of writers waiting behind it
+  std::shared_ptr<const Snapshot> previous;
+  std::unique_lock writer_lock(this->writer_mutex_);
+  if (this->applied_ticket_.load() >= ticket) {
+    return;
+  }
+
+  std::vector<PendingUpdate> batch;
+  uint64_t last_ticket;
+  {
+    std::lock_guard lock(this->pending_mutex_);
+    batch.swap(this->pending_);
+    last_ticket = this->next_ticket_;
+  }
+
+  previous = this->snapshot_.load();
+  SnapshotBuilder builder{.nodes = previous->nodes,
+                          .index = previous->index,
+                          .copied = std::vector<std::shared_ptr<IndexShard>>(
+                              previous->index.size()),
+                          .expiring = {},
+                          .nameChanges = {}};
+  for (auto &update : batch) {
+    this->applyUpdate_(builder, update);
+  }
+  this->snapshot_.store(std::make_shared<const Snapshot>(
+      Snapshot{.version = previous->version + 1,
+               .nodes = std::move(builder.nodes),
+               .index = std::move(builder.index)}));
+  this->applied_ticket_.store(last_ticket);
+  this->armExpiry_(std::move(builder.expiring));
+  for (const auto &[added, name] : builder.nameChanges) {
+    if (added) {
+      this->name_index_.insert(name);
+    } else {
+      this->name_index_.erase(name);
+    }
+  }
+  writer_lock.unlock();
+  // Replaced snapshots and catalogs are released here, outside the lock
+};
+
+void RemoteResourceManager::applyUpdate_(SnapshotBuilder &builder,
+                                         PendingUpdate &update) {
+  size_t position = nodePosition_(builder.nodes, update.address);
+  bool known = position < builder.nodes.size() &&
+               !SockAddrCompare{}(update.address,
+                                  builder.nodes[position].address);
+
+  switch (update.kind) {
+  case PendingUpdate::Kind::UPSERT: {
+    if (known && update.provisional) {
+      return;
+    }
+    if (!known) {
+      reindexNode_(builder, update.address, nullptr, update.catalog.get());
+      auto last_seen = std::make_shared<TimestampCell>(update.time);
+      builder.expiring.push_back(
+          ExpiryEntry{.deadline = update.time + this->cleanup_interval_,
+                      .address = update.address,
+                      .lastSeen = last_seen});
+      builder.nodes.insert(
+          builder.nodes.begin() + position,
+          NodeEntry{.address = update.address,
+                    .node = RemoteNode{.resources = update.catalog,
+                                       .lastAnnouncementTime = last_seen,
+                                       .catalogDigest = update.digest,
+                                       .provisional = update.provisional}});
+      return;
+    }
+
+    auto &node = builder.nodes[position].node;
+    auto &last_time = *node.lastAnnouncementTime;
+    auto current_time = last_time.load();
+    // A restored node carries the load time, not one the node sent, so any
+    // announcement replaces it
+    do {
+      if (update.time <= current_time && !node.provisional) {
+        return;
+      }
+    } while (update.time > current_time &&
+             !last_time.compare_exchange_weak(current_time, update.time));
+
+    if (node.resources != update.catalog) {
+      reindexNode_(builder, update.address, node.resources.get(),
+                   update.catalog.get());
+    }
+    // Replaces the value in the copied array only; published snapshots keep
+    // the previous one
+    node = RemoteNode{.resources = update.catalog,
+                      .lastAnnouncementTime = node.lastAnnouncementTime,
+                      .catalogDigest = update.digest,
+                      .provisional = false};
+    return;
+  }
+  case PendingUpdate::Kind::CONFIRM:
+    if (known && builder.nodes[position].node.catalogDigest == update.digest) {
+      builder.nodes[position].node.provisional = false;
+    }
+    return;
+  case PendingUpdate::Kind::REMOVE_IF_STALE:
+    if (!known) {
+      return;
+    }
+    if (auto deadline =
+            builder.nodes[position].node.lastAnnouncementTime->load() +
+            this->cleanup_interval_;
+        deadline > update.time) {
+      // Announced since its entry came due; its entry was already popped
+      builder.expiring.push_back(ExpiryEntry{
+          .deadline = deadline,
+          .address = update.address,
+          .lastSeen = builder.nodes[position].node.lastAnnouncementTime});
+      return;
+    }
+    {
       char node_ip[INET_ADDRSTRLEN];
-      inet_ntop(AF_INET, &(it->first.sin_addr), node_ip, INET_ADDRSTRLEN);
-      Logger::log(LogLevel::INFO,
-                  "Cleaning data from node " + std::string(node_ip));
-      it = this->nodes_.erase(it);
+      inet_ntop(AF_INET, &(update.address.sin_addr), node_ip,
+                INET_ADDRSTRLEN);
+      Logger::log<LogLevel::INFO>("Cleaning data from node {}", node_ip);
+    }
+    [[fallthrough]];
+  case PendingUpdate::Kind::REMOVE:
+    if (!known) {
+      return;
+    }
+    reindexNode_(builder, update.address,
+                 builder.nodes[position].node.resources.get(), nullptr);
+    builder.nodes.erase(builder.nodes.begin() + position);
+    return;
+  }
+};
+
+void RemoteResourceManager::reindexNode_(SnapshotBuilder &builder,
+                                         const struct sockaddr_in &node_address,
+                                         const CompactCatalog *previous,
+                                         const CompactCatalog *next) {
+  using Entry = CompactCatalog::Entry;
+  static const std::vector<Entry> empty;
+  const auto &old_entries = previous ? previous->entries() : empty;
+  const auto &new_entries = next ? next->entries() : empty;
+
+  auto index = [&](std::string_view name, uint64_t size) {
+    auto [holders_it, inserted] = builder.shardFor(name).try_emplace(name);
+    if (inserted) {
+      builder.nameChanges.emplace_back(true, std::string(name));
+    }
+    auto &holders = holders_it->second;
+    auto holder_it = std::ranges::lower_bound(
+        holders, node_address, SockAddrCompare{}, &ResourceHolder::address);
+    if (holder_it != holders.end() &&
+        !SockAddrCompare{}(node_address, holder_it->address)) {
+      holder_it->size = size;
     } else {
-      ++it;
+      holders.insert(holder_it,
+                     ResourceHolder{.address = node_address, .size = size});
+    }
+  };
+  auto unindex = [&](std::string_view name) {
+    auto &shard = builder.shardFor(name);
+    auto holders_it = shard.find(name);
+    if (holders_it == shard.end()) {
+      return;
+    }
+    auto &holders = holders_it->second;
+    auto holder_it = std::ranges::lower_bound(
+        holders, node_address, SockAddrCompare{}, &ResourceHolder::address);
+    if (holder_it != holders.end() &&
+        !SockAddrCompare{}(node_address, holder_it->address)) {
+      holders.erase(holder_it);
+    }
+    if (holders.empty()) {
+      shard.erase(holders_it);
+      builder.nameChanges.emplace_back(false, std::string(name));
+    }
+  };
+
+  // Diffing needs strictly increasing names; anything else is reindexed fully
+  auto strictly_sorted = [](const CompactCatalog *catalog) {
+    return !catalog ||
+           std::ranges::adjacent_find(
+               catalog->entries(), [catalog](const Entry &a, const Entry &b) {
+                 return !(catalog->name(a) < catalog->name(b));
+               }) == catalog->entries().end();
+  };
+  if (!strictly_sorted(previous) || !strictly_sorted(next)) {
+    for (const auto &entry : old_entries) {
+      unindex(previous->name(entry));
+    }
+    for (const auto &entry : new_entries) {
+      index(next->name(entry), entry.size);
+    }
+    return;
+  }
+
+  auto old_it = old_entries.begin();
+  auto new_it = new_entries.begin();
+  while (old_it != old_entries.end() || new_it != new_entries.end()) {
+    if (old_it != old_entries.end() && new_it != new_entries.end() &&
+        old_it->nameId == new_it->nameId) {
+      if (old_it->size != new_it->size) {
+        index(next->name(*new_it), new_it->size);
+      }
+      ++old_it;
+      ++new_it;
+    } else if (new_it == new_entries.end() ||
+               (old_it != old_entries.end() &&
+                previous->name(*old_it) < next->name(*new_it))) {
+      unindex(previous->name(*old_it));
+      ++old_it;
+    } else {
+      index(next->name(*new_it), new_it->size);
+      ++new_it;
     }
   }
 };
+
+size_t RemoteResourceManager::shardIndex_(std::string_view resource_name) {
+  return std::hash<std::string_view>{}(resource_name) %
+         constants::remote_resource_manager::INDEX_SHARDS;
+};
+
+size_t RemoteResourceManager::nodePosition_(const NodeMap &nodes,
+                                            const struct sockaddr_in &address) {
+  return std::ranges::lower_bound(nodes, address, SockAddrCompare{},
+                                  &NodeEntry::address) -
+         nodes.begin();
+};
+
+const RemoteNode *
+RemoteResourceManager::findNode_(const NodeMap &nodes,
+                                 const struct sockaddr_in &address) {
+  size_t position = nodePosition_(nodes, address);
+  if (position == nodes.size() ||
+      SockAddrCompare{}(address, nodes[position].address)) {
+    return nullptr;
+  }
+  return &nodes[position].node;
+};
+
+const RemoteResourceManager::HolderList *
+RemoteResourceManager::findHolders_(const Snapshot &snapshot,
+                                    std::string_view resource_name) {
+  const auto &shard = *snapshot.index[shardIndex_(resource_name)];
+  auto holders_it = shard.find(resource_name);
+  return holders_it == shard.end() ? nullptr : &holders_it->second;
+};
+
 } // namespace p2p
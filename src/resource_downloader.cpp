@@ -1,11 +1,14 @@
 #include "p2p-resource-sync/constants.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <netdb.h>
+#include <optional>
 #include <p2p-resource-sync/logger.hpp>
 #include <p2p-resource-sync/resource_downloader.hpp>
 #include <stdexcept>
@@ -58,7 +61,7 @@ int ResourceDownloader::initialize_socket_(const std::string &host,
     close(sock);
     throw std::runtime_error("Error connecting to server");
   }
-  Logger::log(LogLevel::INFO, "Successfully connected to " + host + " bytes");
+  Logger::log<LogLevel::DEBUG>("Successfully connected to {}:{}", host, port);
   return sock;
 }
 
@@ -96,28 +99,37 @@ void ResourceDownloader::send_resource_request_(
 
     total_sent += bytes_sent;
   }
-  Logger::log(LogLevel::INFO, "Download request sent");
+  Logger::log<LogLevel::DEBUG>("Download request sent");
 }
 
-std::pair<bool, uint64_t>
-ResourceDownloader::receive_initial_response_(int sock) const {
-  uint8_t status;
-  ssize_t received = recv(sock, &status, sizeof(status), 0);
-  if (received <= 0) {
-    throw std::runtime_error("Failed to receive status");
+void ResourceDownloader::receive_exactly_(int sock, void *buffer,
+                                          size_t length) const {
+  size_t received_total = 0;
+  while (received_total < length) {
+    ssize_t received = recv(sock, static_cast<char *>(buffer) + received_total,
+                            length - received_total, 0);
+    if (received <= 0) {
+      throw std::runtime_error("Failed to receive response header");
+    }
+    received_total += received;
   }
+}
 
+std::tuple<bool, uint64_t, uint64_t>
+ResourceDownloader::receive_initial_response_(int sock) const {
+  uint8_t status;
+  receive_exactly_(sock, &status, sizeof(status));
   if (status == 0) {
-    return {false, 0};
+    return {false, 0, 0};
   }
 
+  // Read in full even when it arrives split across segments
   uint64_t file_size;
-  received = recv(sock, &file_size, sizeof(file_size), 0);
-  if (received <= 0) {
-    throw std::runtime_error("Failed to receive file size");
-  }
-  Logger::log(LogLevel::INFO, "Received initial response");
-  return {true, file_size};
+  uint64_t file_version;
+  receive_exactly_(sock, &file_size, sizeof(file_size));
+  receive_exactly_(sock, &file_version, sizeof(file_version));
+  Logger::log<LogLevel::DEBUG>("Received initial response");
+  return {true, file_size, file_version};
 }
 
 uint64_t ResourceDownloader::receive_file_(int sock, uint64_t offset,
@@ -125,16 +137,28 @@ uint64_t ResourceDownloader::receive_file_(int sock, uint64_t offset,
                                            uint64_t file_size) const {
   std::filesystem::path file_path =
       std::filesystem::path(download_dir_) / resource_name;
+  // Resources shared from a directory are named by their relative path
+  std::filesystem::create_directories(file_path.parent_path());
 
+  // Resuming writes in place after the first offset bytes, dropping
+  // anything a previous attempt left past them
+  if (offset > 0) {
+    if (!std::filesystem::exists(file_path) ||
+        std::filesystem::file_size(file_path) < offset) {
+      throw std::runtime_error("Partial download shorter than resume offset");
+    }
+    std::filesystem::resize_file(file_path, offset);
+  }
   std::ofstream file(file_path,
                      std::ios::binary |
-                         (offset > 0 ? std::ios::app : std::ios::trunc));
+                         (offset > 0 ? std::ios::in | std::ios::out
+                                     : std::ios::trunc));
   if (!file) {
     throw std::runtime_error("Failed to create output file");
   }
 
   if (offset > 0) {
-    file.seekp(offset);
+    file.seekp(static_cast<std::streamoff>(offset));
   }
 
   uint64_t total_received = offset;
@@ -147,13 +171,11 @@ uint64_t ResourceDownloader::receive_file_(int sock, uint64_t offset,
 
     ssize_t received = recv(sock, buffer, to_receive, 0);
     if (received <= 0) {
-      Logger::log(LogLevel::INFO, "Connection lost or recv timeout, received " +
-                                      std::to_string(total_received) +
-                                      " bytes");
+      Logger::log<LogLevel::INFO>(
+          "Connection lost or recv timeout, received {} bytes", total_received);
       return total_received;
     }
-    Logger::log(LogLevel::INFO,
-                "Successfully received " + std::to_string(received) + " bytes");
+    Logger::log<LogLevel::TRACE>("Successfully received {} bytes", received);
 
     file.write(buffer, received);
     if (!file) {
@@ -177,48 +199,113 @@ std::pair<uint64_t, uint64_t>
 ResourceDownloader::downloadResource(const std::string &peer_addr,
                                      int peer_port, uint64_t offset,
                                      const std::string &resource_name) const {
+  return this->download_(peer_addr, peer_port, offset, resource_name, nullptr);
+}
+
+std::pair<uint64_t, uint64_t> ResourceDownloader::downloadResource(
+    const struct sockaddr_in &node_address, int peer_port, uint64_t offset,
+    const std::string &resource_name) const {
+  char peer_ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &(node_address.sin_addr), peer_ip, INET_ADDRSTRLEN);
+  if (!this->peer_stats_sink_) {
+    return this->download_(peer_ip, peer_port, offset, resource_name, nullptr);
+  }
+
+  this->peer_stats_sink_->recordTransferStart(node_address);
+  try {
+    auto result = this->download_(peer_ip, peer_port, offset, resource_name,
+                                  &node_address);
+    this->peer_stats_sink_->recordTransferEnd(node_address);
+    return result;
+  } catch (...) {
+    this->peer_stats_sink_->recordTransferEnd(node_address);
+    throw;
+  }
+}
+
+void ResourceDownloader::setPeerStatsSink(
+    std::shared_ptr<RemoteResourceManager> remote_manager) {
+  this->peer_stats_sink_ = std::move(remote_manager);
+}
+
+std::pair<uint64_t, uint64_t>
+ResourceDownloader::download_(const std::string &peer_addr, int peer_port,
+                              uint64_t offset,
+                              const std::string &resource_name,
+                              const struct sockaddr_in *node_address) const {
+  std::filesystem::path name_path(resource_name);
+  if (resource_name.empty() || name_path.is_absolute() ||
+      std::ranges::find(name_path, "..") != name_path.end()) {
+    throw std::runtime_error("Invalid resource name: " + resource_name);
+  }
   std::cout << "Downloading " << resource_name << " from " << peer_addr
             << std::endl;
   uint64_t current_offset = offset;
   uint64_t file_size = 0;
+  std::optional<uint64_t> file_version;
 
   for (int attempt = 0; attempt < constants::resource_downloader::MAX_RETRIES;
        attempt++) {
     if (attempt > 0) {
-      Logger::log(
-          LogLevel::INFO,
-          "Retrying download (attempt " + std::to_string(attempt + 1) + "/" +
-              std::to_string(constants::resource_downloader::MAX_RETRIES) +
-              ") from offset " + std::to_string(current_offset));
+      Logger::log<LogLevel::INFO>(
+          "Retrying download (attempt {}/{}) from offset {}", attempt + 1,
+          constants::resource_downloader::MAX_RETRIES, current_offset);
     }
 
+    auto attempt_start = std::chrono::steady_clock::now();
+    TransferSample sample{.bytes = 0,
+                          .duration = {},
+                          .rtt = std::nullopt,
+                          .succeeded = false};
+    auto record = [&]() {
+      if (node_address) {
+        this->peer_stats_sink_->recordTransferAttempt(*node_address, sample);
+      }
+    };
+
     try {
       int sock = initialize_socket_(peer_addr, peer_port);
       send_resource_request_(sock, current_offset, resource_name);
 
-      auto [exists, size] = receive_initial_response_(sock);
+      auto [exists, size, version] = receive_initial_response_(sock);
+      auto transfer_start = std::chrono::steady_clock::now();
+      sample.rtt = transfer_start - attempt_start;
       if (!exists) {
         close(sock);
+        record();
         return {0, 0};
       }
+      if (file_version && *file_version != version && current_offset > 0) {
+        // Resuming would splice two versions of the file together
+        close(sock);
+        Logger::log<LogLevel::INFO>(
+            "Resource {} changed during download, restarting", resource_name);
+        current_offset = 0;
+        file_version = version;
+        continue;
+      }
+      file_version = version;
 
       file_size = size;
+      uint64_t attempt_offset = current_offset;
       current_offset =
           receive_file_(sock, current_offset, resource_name, file_size);
       close(sock);
 
+      sample.bytes = current_offset - attempt_offset;
+      sample.duration = std::chrono::steady_clock::now() - transfer_start;
+      sample.succeeded = current_offset == file_size;
+      record();
       if (current_offset == file_size) {
         return {current_offset, file_size};
       }
-      Logger::log(LogLevel::INFO, "Download incomplete (attempt " +
-                                      std::to_string(attempt + 1) + "): " +
-                                      std::to_string(current_offset) + "/" +
-                                      std::to_string(file_size) + " bytes");
+      Logger::log<LogLevel::INFO>("Download incomplete (attempt {}): {}/{} bytes",
+                                  attempt + 1, current_offset, file_size);
 
     } catch (const std::exception &e) {
-      Logger::log(LogLevel::ERROR, "Error during download (attempt " +
-                                       std::to_string(attempt + 1) +
-                                       "): " + e.what());
+      record();
+      Logger::log<LogLevel::ERROR>("Error during download (attempt {}): {}",
+                                   attempt + 1, e.what());
       throw;
     }
   }
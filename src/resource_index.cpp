@@ -0,0 +1,265 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <p2p-resource-sync/constants.hpp>
+#include <p2p-resource-sync/content_hasher.hpp>
+#include <p2p-resource-sync/resource_index.hpp>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace p2p {
+
+namespace {
+struct FileHeader {
+  uint32_t magic;
+  uint32_t formatVersion;
+};
+
+enum class RecordKind : uint8_t { ADD = 1, REMOVE = 2 };
+
+void writeAll(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      throw std::runtime_error("Failed to write resource index: " +
+                               std::string(strerror(errno)));
+    }
+    data += written;
+    length -= static_cast<size_t>(written);
+  }
+}
+} // namespace
+
+// Followed by nameLength bytes of name, then the path
+struct ResourceIndex::RecordHeader {
+  // XXH64 of the rest of the record
+  uint64_t checksum;
+  uint32_t payloadLength;
+  RecordKind kind;
+  uint8_t hasContentHash;
+  uint16_t nameLength;
+  uint64_t size;
+  int64_t lastModified;
+  int64_t fileModified;
+  uint64_t contentHash;
+};
+
+ResourceIndex::ResourceIndex(const std::filesystem::path &path) : path_(path) {
+  this->fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (this->fd_ < 0) {
+    throw std::runtime_error("Failed to open resource index: " +
+                             std::string(strerror(errno)));
+  }
+  try {
+    this->replay_();
+  } catch (...) {
+    close(this->fd_);
+    throw;
+  }
+};
+
+ResourceIndex::~ResourceIndex() {
+  if (this->fd_ >= 0) {
+    close(this->fd_);
+  }
+};
+
+const std::map<std::string, ResourceInfo> &ResourceIndex::restored() const {
+  return this->restored_;
+};
+
+void ResourceIndex::releaseRestored() { this->restored_.clear(); };
+
+void ResourceIndex::recordAdd(const ResourceInfo &resource) {
+  std::vector<char> record;
+  encodeAdd_(record, resource);
+  this->append_(record);
+};
+
+void ResourceIndex::recordRemove(const std::string &name) {
+  std::vector<char> record;
+  encodeRemove_(record, name);
+  this->append_(record);
+};
+
+bool ResourceIndex::needsCompaction(size_t live_resources) const {
+  return this->record_count_ >=
+         constants::resource_index::MIN_COMPACTION_RECORDS +
+             constants::resource_index::COMPACTION_FACTOR * live_resources;
+};
+
+void ResourceIndex::compact(const LocalCatalog &catalog) {
+  std::vector<char> buffer;
+  FileHeader header{.magic = constants::resource_index::FILE_MAGIC,
+                    .formatVersion = constants::resource_index::FORMAT_VERSION};
+  auto header_bytes = reinterpret_cast<const char *>(&header);
+  buffer.insert(buffer.end(), header_bytes, header_bytes + sizeof(header));
+  for (const auto &resource : catalog.resources) {
+    encodeAdd_(buffer, *resource);
+  }
+
+  // Synced before the rename, so the log is always either the old or the
+  // complete new one
+  auto temporary_path = this->path_;
+  temporary_path += ".tmp";
+  int fd = open(temporary_path.c_str(),
+                O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to compact resource index: " +
+                             std::string(strerror(errno)));
+  }
+  try {
+    writeAll(fd, buffer.data(), buffer.size());
+    if (fdatasync(fd) < 0) {
+      throw std::runtime_error("Failed to sync resource index: " +
+                               std::string(strerror(errno)));
+    }
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  std::filesystem::rename(temporary_path, this->path_);
+  close(this->fd_);
+  this->fd_ = fd;
+  lseek(this->fd_, 0, SEEK_END);
+  this->record_count_ = catalog.resources.size();
+};
+
+size_t ResourceIndex::getRecordCount() const { return this->record_count_; };
+
+void ResourceIndex::replay_() {
+  struct stat file_stat;
+  if (fstat(this->fd_, &file_stat) < 0) {
+    throw std::runtime_error("Failed to stat resource index: " +
+                             std::string(strerror(errno)));
+  }
+  std::vector<char> buffer(static_cast<size_t>(file_stat.st_size));
+  size_t loaded = 0;
+  while (loaded < buffer.size()) {
+    ssize_t result = pread(this->fd_, buffer.data() + loaded,
+                           buffer.size() - loaded, static_cast<off_t>(loaded));
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      throw std::runtime_error("Failed to read resource index: " +
+                               std::string(strerror(errno)));
+    }
+    loaded += static_cast<size_t>(result);
+  }
+
+  if (buffer.empty()) {
+    FileHeader header{
+        .magic = constants::resource_index::FILE_MAGIC,
+        .formatVersion = constants::resource_index::FORMAT_VERSION};
+    writeAll(this->fd_, reinterpret_cast<const char *>(&header),
+             sizeof(header));
+    return;
+  }
+  FileHeader header;
+  if (buffer.size() < sizeof(header)) {
+    throw std::runtime_error("Resource index is truncated");
+  }
+  std::memcpy(&header, buffer.data(), sizeof(header));
+  if (header.magic != constants::resource_index::FILE_MAGIC ||
+      header.formatVersion != constants::resource_index::FORMAT_VERSION) {
+    throw std::runtime_error("Unsupported resource index format");
+  }
+
+  size_t offset = sizeof(header);
+  while (buffer.size() - offset >= sizeof(RecordHeader)) {
+    RecordHeader record;
+    std::memcpy(&record, buffer.data() + offset, sizeof(record));
+    size_t record_length = sizeof(record) + record.payloadLength;
+    if (buffer.size() - offset < record_length ||
+        record.nameLength > record.payloadLength ||
+        ContentHasher::hashBytes(
+            buffer.data() + offset + sizeof(record.checksum),
+            record_length - sizeof(record.checksum)) != record.checksum) {
+      break;
+    }
+
+    const char *payload = buffer.data() + offset + sizeof(record);
+    std::string name(payload, record.nameLength);
+    if (record.kind == RecordKind::ADD) {
+      this->restored_.insert_or_assign(
+          name,
+          ResourceInfo{
+              .name = name,
+              .path = std::string(payload + record.nameLength,
+                                  record.payloadLength - record.nameLength),
+              .size = record.size,
+              .lastModified = static_cast<std::time_t>(record.lastModified),
+              .fileModified = record.fileModified,
+              .contentHash = record.hasContentHash
+                                 ? std::optional<uint64_t>(record.contentHash)
+                                 : std::nullopt});
+    } else {
+      this->restored_.erase(name);
+    }
+    offset += record_length;
+    this->record_count_++;
+  }
+
+  // Drops the record a crash left half-written
+  if (offset < buffer.size() && ftruncate(this->fd_, offset) < 0) {
+    throw std::runtime_error("Failed to truncate resource index: " +
+                             std::string(strerror(errno)));
+  }
+  lseek(this->fd_, static_cast<off_t>(offset), SEEK_SET);
+};
+
+void ResourceIndex::append_(const std::vector<char> &record) {
+  writeAll(this->fd_, record.data(), record.size());
+  this->record_count_++;
+};
+
+void ResourceIndex::encodeAdd_(std::vector<char> &buffer,
+                               const ResourceInfo &resource) {
+  // No padding, which would be checksummed uninitialised
+  static_assert(sizeof(RecordHeader) == 48);
+  RecordHeader record{
+      .checksum = 0,
+      .payloadLength =
+          static_cast<uint32_t>(resource.name.size() + resource.path.size()),
+      .kind = RecordKind::ADD,
+      .hasContentHash = resource.contentHash.has_value(),
+      .nameLength = static_cast<uint16_t>(resource.name.size()),
+      .size = resource.size,
+      .lastModified = static_cast<int64_t>(resource.lastModified),
+      .fileModified = resource.fileModified,
+      .contentHash = resource.contentHash.value_or(0)};
+  size_t start = buffer.size();
+  auto record_bytes = reinterpret_cast<const char *>(&record);
+  buffer.insert(buffer.end(), record_bytes, record_bytes + sizeof(record));
+  buffer.insert(buffer.end(), resource.name.begin(), resource.name.end());
+  buffer.insert(buffer.end(), resource.path.begin(), resource.path.end());
+
+  uint64_t checksum = ContentHasher::hashBytes(
+      buffer.data() + start + sizeof(record.checksum),
+      buffer.size() - start - sizeof(record.checksum));
+  std::memcpy(buffer.data() + start, &checksum, sizeof(checksum));
+};
+
+void ResourceIndex::encodeRemove_(std::vector<char> &buffer,
+                                  const std::string &name) {
+  RecordHeader record{};
+  record.payloadLength = static_cast<uint32_t>(name.size());
+  record.kind = RecordKind::REMOVE;
+  record.nameLength = static_cast<uint16_t>(name.size());
+  size_t start = buffer.size();
+  auto record_bytes = reinterpret_cast<const char *>(&record);
+  buffer.insert(buffer.end(), record_bytes, record_bytes + sizeof(record));
+  buffer.insert(buffer.end(), name.begin(), name.end());
+
+  uint64_t checksum = ContentHasher::hashBytes(
+      buffer.data() + start + sizeof(record.checksum),
+      buffer.size() - start - sizeof(record.checksum));
+  std::memcpy(buffer.data() + start, &checksum, sizeof(checksum));
+};
+
+} // namespace p2p
@@ -3,10 +3,11 @@
 #include <atomic>
 #include <csignal>
 #include <errno.h>
-#include <filesystem>
-#include <fstream>
+#include <fcntl.h>
 #include <iostream>
 #include <netinet/in.h>
+#include <p2p-resource-sync/catalog_codec.hpp>
+#include <p2p-resource-sync/content_hasher.hpp>
 #include <p2p-resource-sync/logger.hpp>
 #include <p2p-resource-sync/protocol.hpp>
 #include <p2p-resource-sync/tcp_server.hpp>
@@ -27,6 +28,22 @@ void TcpServer::stop() {
   }
 }
 
+bool TcpServer::waitUntilListening(std::chrono::milliseconds timeout) {
+  std::unique_lock lock(this->listen_mutex_);
+  this->listen_cv_.wait_for(lock, timeout, [this]() {
+    return this->listen_state_ != ListenState::STARTING;
+  });
+  return this->listen_state_ == ListenState::LISTENING;
+}
+
+void TcpServer::setListenState_(ListenState state) {
+  {
+    std::lock_guard lock(this->listen_mutex_);
+    this->listen_state_ = state;
+  }
+  this->listen_cv_.notify_all();
+}
+
 int TcpServer::initializeSocket_(int port, int max_clients) {
   int sock = socket(AF_INET, SOCK_STREAM, 0);
   if (sock == -1) {
@@ -65,7 +82,7 @@ void TcpServer::simulatePeriodicDrop(size_t frequency) {
 }
 
 void TcpServer::sendChunk_(int client_socket, const char *data, size_t length,
-                           size_t &total_sent) {
+                           uint64_t &total_sent) {
   size_t bytes_sent = 0;
   while (bytes_sent < length) {
     ssize_t sent =
@@ -80,82 +97,81 @@ void TcpServer::sendChunk_(int client_socket, const char *data, size_t length,
   }
 }
 
+void TcpServer::receiveExactly_(int client_socket, void *buffer,
+                                size_t length) {
+  size_t received_total = 0;
+  while (received_total < length) {
+    ssize_t received =
+        recv(client_socket, static_cast<char *>(buffer) + received_total,
+             length - received_total, 0);
+    if (received <= 0) {
+      throw std::runtime_error("Failed to receive request data");
+    }
+    received_total += received;
+  }
+}
+
 void TcpServer::handleClient_(int client_socket) {
   try {
     uint32_t messageLength;
-    if (recv(client_socket, &messageLength, sizeof(messageLength), 0) <= 0) {
-      throw std::runtime_error("Failed to receive message length");
+    receiveExactly_(client_socket, &messageLength, sizeof(messageLength));
+    if (messageLength < sizeof(ResourceRequest) ||
+        messageLength > sizeof(ResourceRequest) +
+                            constants::local_resource_manager::
+                                MAX_RESOURCE_NAME_LENGTH) {
+      throw std::runtime_error("Invalid request length");
     }
 
     auto request = std::unique_ptr<ResourceRequest>(
         static_cast<ResourceRequest *>(operator new(messageLength)));
     request->messageLength = messageLength;
-    size_t remaining = messageLength - sizeof(messageLength);
-    size_t offset = sizeof(messageLength);
-    while (remaining > 0) {
-      ssize_t received =
-          recv(client_socket, reinterpret_cast<char *>(request.get()) + offset,
-               remaining, 0);
-      if (received <= 0) {
-        throw std::runtime_error("Failed to receive request data");
-      }
-      remaining -= received;
-      offset += received;
+    receiveExactly_(client_socket,
+                    reinterpret_cast<char *>(request.get()) +
+                        sizeof(messageLength),
+                    messageLength - sizeof(messageLength));
+
+    if (request->resourceNameLength == protocol::CATALOG_REQUEST_NAME_LENGTH) {
+      sendCatalog_(client_socket);
+      close(client_socket);
+      return;
+    }
+    if (request->resourceNameLength > messageLength - sizeof(ResourceRequest)) {
+      throw std::runtime_error("Invalid resource name length");
     }
 
-    auto resource_path = resource_manager_->getResourcePath(
-        std::string(request->resourceName, request->resourceNameLength));
+    std::string name(request->resourceName, request->resourceNameLength);
+    auto catalog = resource_manager_->getSnapshot();
+    const ResourceInfo *resource = catalog->find(name);
 
-    if (!resource_path) {
+    if (!resource) {
       uint8_t status = 0;
       if (send(client_socket, &status, sizeof(status), 0) <= 0) {
         throw std::runtime_error("Failed to send error status");
       }
+      close(client_socket);
       return;
     }
 
-    std::ifstream file(*resource_path, std::ios::binary);
-    if (!file) {
+    int fd = open(resource->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      resource_manager_->refreshResource(name);
       throw std::runtime_error("Failed to open resource file");
     }
-
-    file.seekg(request->offset);
-    if (!file) {
-      throw std::runtime_error("Invalid offset");
-    }
-
-    uint8_t status = 1;
-    if (send(client_socket, &status, sizeof(status), 0) <= 0) {
-      throw std::runtime_error("Failed to send success status");
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+      close(fd);
+      throw std::runtime_error("Failed to stat resource file");
     }
-
-    auto size = std::filesystem::file_size(*resource_path);
-    if (send(client_socket, &size, sizeof(size), 0) <= 0) {
-      throw std::runtime_error("Failed to send file size");
-    }
-
-    size_t total_sent = 0;
-    char buffer[constants::tcp_server::BUFFER_SIZE];
-
-    int counter = 0;
-    while (file.read(buffer, sizeof(buffer))) {
-      sendChunk_(client_socket, buffer, sizeof(buffer), total_sent);
-      if (should_simulate_periodic_drop_ &&
-          counter % constants::tcp_server::DEFAULT_DROP_FREQUENCY ==
-              constants::tcp_server::DEFAULT_DROP_FREQUENCY) {
-        Logger::log(LogLevel::INFO,
-                    "Simulating periodic connection drop after " +
-                        std::to_string(total_sent) + " bytes");
-        shutdown(client_socket, SHUT_RDWR);
-        throw std::runtime_error("Simulated periodic connection drop");
-      }
-      counter++;
-    }
-
-    auto lastChunkSize = file.gcount();
-    if (lastChunkSize > 0) {
-      sendChunk_(client_socket, buffer, lastChunkSize, total_sent);
+    // Once per request rather than per chunk; the catalog catches up in the
+    // background, while this request is served what is on disk
+    resource_manager_->checkFile(*resource, file_stat);
+    try {
+      this->sendFile_(client_socket, fd, request->offset, file_stat);
+    } catch (const std::exception &) {
+      close(fd);
+      throw;
     }
+    close(fd);
 
   } catch (const std::exception &e) {
     close(client_socket);
@@ -164,6 +180,87 @@ void TcpServer::handleClient_(int client_socket) {
   close(client_socket);
 }
 
+void TcpServer::sendFile_(int client_socket, int fd, uint64_t offset,
+                          const struct stat &file_stat) {
+  uint64_t size = static_cast<uint64_t>(file_stat.st_size);
+  if (offset > size) {
+    throw std::runtime_error("Invalid offset");
+  }
+  int64_t identity[] = {static_cast<int64_t>(file_stat.st_ino),
+                        static_cast<int64_t>(file_stat.st_size),
+                        static_cast<int64_t>(file_stat.st_mtim.tv_sec),
+                        static_cast<int64_t>(file_stat.st_mtim.tv_nsec)};
+  uint64_t version = ContentHasher::hashBytes(identity, sizeof(identity));
+
+  // Status (uint8), file size (uint64) and version (uint64), then the file
+  // from the offset, streamed through a fixed-size buffer
+  uint64_t header_sent = 0;
+  uint8_t status = 1;
+  sendChunk_(client_socket, reinterpret_cast<const char *>(&status),
+             sizeof(status), header_sent);
+  sendChunk_(client_socket, reinterpret_cast<const char *>(&size),
+             sizeof(size), header_sent);
+  sendChunk_(client_socket, reinterpret_cast<const char *>(&version),
+             sizeof(version), header_sent);
+
+  uint64_t total_sent = 0;
+  char buffer[constants::tcp_server::BUFFER_SIZE];
+
+  int counter = 0;
+  for (uint64_t position = offset; position < size;) {
+    ssize_t length = pread(
+        fd, buffer, std::min<uint64_t>(sizeof(buffer), size - position),
+        static_cast<off_t>(position));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      throw std::runtime_error("Resource file shrank while being sent");
+    }
+    sendChunk_(client_socket, buffer, static_cast<size_t>(length), total_sent);
+    position += static_cast<uint64_t>(length);
+    Logger::log<LogLevel::TRACE>("Sent {} bytes, {}/{}", length, position,
+                                 size);
+    if (should_simulate_periodic_drop_ &&
+        counter % constants::tcp_server::DEFAULT_DROP_FREQUENCY ==
+            constants::tcp_server::DEFAULT_DROP_FREQUENCY) {
+      Logger::log<LogLevel::INFO>(
+          "Simulating periodic connection drop after {} bytes", total_sent);
+      shutdown(client_socket, SHUT_RDWR);
+      throw std::runtime_error("Simulated periodic connection drop");
+    }
+    counter++;
+  }
+}
+
+void TcpServer::sendCatalog_(int client_socket) {
+  std::vector<Resource> resources =
+      CatalogCodec::fromLocalResources(*resource_manager_);
+  std::vector<uint8_t> entries = CatalogCodec::serializeEntries(resources);
+  uint64_t digest = CatalogCodec::digest(entries.data(), entries.size());
+  uint32_t resource_count = resources.size();
+  uint64_t payload_length =
+      sizeof(digest) + sizeof(resource_count) + entries.size();
+
+  std::vector<uint8_t> response;
+  response.reserve(sizeof(uint8_t) + sizeof(payload_length) + payload_length);
+  response.push_back(1);
+  auto append = [&response](const void *data, size_t length) {
+    auto bytes = static_cast<const uint8_t *>(data);
+    response.insert(response.end(), bytes, bytes + length);
+  };
+  append(&payload_length, sizeof(payload_length));
+  append(&digest, sizeof(digest));
+  append(&resource_count, sizeof(resource_count));
+  append(entries.data(), entries.size());
+
+  uint64_t total_sent = 0;
+  sendChunk_(client_socket, reinterpret_cast<const char *>(response.data()),
+             response.size(), total_sent);
+  Logger::log<LogLevel::INFO>("Sent catalog with {} resources",
+                              resource_count);
+}
+
 static void (*signal_handler(TcpServer *server))(int) {
   static TcpServer *srv = server;
   static int server_socket = -1;
@@ -198,6 +295,7 @@ void TcpServer::run() {
     if (server_socket_ < 0) {
       throw std::runtime_error("Failed to initialize socket");
     }
+    this->setListenState_(ListenState::LISTENING);
 
     while (!should_stop_) {
       std::this_thread::sleep_for(constants::tcp_server::MAIN_LOOP_DELAY_MS);
@@ -213,8 +311,7 @@ void TcpServer::run() {
       }
       char client_ip[INET_ADDRSTRLEN];
       inet_ntop(AF_INET, &(client.sin_addr), client_ip, INET_ADDRSTRLEN);
-      Logger::log(LogLevel::INFO,
-                  "New connection from " + std::string(client_ip));
+      Logger::log<LogLevel::DEBUG>("New connection from {}", client_ip);
 
       if (!should_stop_) {
         try {
@@ -222,8 +319,8 @@ void TcpServer::run() {
             try {
               handleClient_(client_socket);
             } catch (const std::exception &e) {
-              Logger::log(LogLevel::ERROR,
-                          std::string("Client handler error") + e.what());
+              Logger::log<LogLevel::ERROR>("Client handler error: {}",
+                                           e.what());
             }
           });
 
@@ -231,8 +328,8 @@ void TcpServer::run() {
                         [](const std::jthread &t) { return !t.joinable(); });
 
         } catch (const std::exception &e) {
-          Logger::log(LogLevel::ERROR,
-                      std::string("Failed to create client thread") + e.what());
+          Logger::log<LogLevel::ERROR>("Failed to create client thread: {}",
+                                       e.what());
           close(client_socket);
         }
       }
@@ -246,7 +343,10 @@ void TcpServer::run() {
 
     close(server_socket_);
   } catch (const std::exception &e) {
-    Logger::log(LogLevel::ERROR, std::string("Server error:") + e.what());
+    if (this->listen_state_ == ListenState::STARTING) {
+      this->setListenState_(ListenState::FAILED);
+    }
+    Logger::log<LogLevel::ERROR>("Server error: {}", e.what());
     throw;
   }
 }
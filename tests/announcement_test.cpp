@@ -1,6 +1,8 @@
 #include "p2p-resource-sync/announcement_broadcaster.hpp"
 #include "p2p-resource-sync/announcement_receiver.hpp"
 #include "p2p-resource-sync/local_resource_manager.hpp"
+#include "p2p-resource-sync/tcp_server.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <chrono>
@@ -9,6 +11,7 @@
 #include <ctime>
 #include <gtest/gtest.h>
 #include <memory>
+#include <mutex>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <thread>
@@ -122,3 +125,241 @@ TEST_F(AnnouncementTest, BroadcastsMessageWithResource) {
 
   removeTestFile(test_file_path);
 }
+
+TEST_F(AnnouncementTest, AnnouncesCatalogChangeWithoutWaitingForInterval) {
+  const std::string test_file_path = "../test_local_files/test_change.txt";
+  createTestFile(test_file_path);
+
+  p2p::AnnouncementBroadcaster broadcaster(
+      local_manager_ref, 1, sender_port, brdcst_port, std::chrono::seconds(60));
+  p2p::AnnouncementReceiver receiver(remote_manager_ref, 2, brdcst_port, 1);
+  std::jthread broadcaster_thread([&broadcaster]() { broadcaster.run(); });
+  std::jthread receiver_thread([&receiver]() { receiver.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  local_manager_ref->addResource("test", test_file_path);
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  auto remote_resources = remote_manager_ref->getAllResources();
+
+  broadcaster.stop();
+  receiver.stop();
+  broadcaster_thread.join();
+  receiver_thread.join();
+
+  ASSERT_EQ(remote_resources.size(), 1);
+  EXPECT_EQ(remote_resources[0].second.name, "test");
+
+  removeTestFile(test_file_path);
+}
+
+TEST_F(AnnouncementTest, StopInterruptsBroadcastInterval) {
+  p2p::AnnouncementBroadcaster broadcaster(
+      local_manager_ref, 1, sender_port, brdcst_port, std::chrono::seconds(60));
+  std::jthread broadcaster_thread([&broadcaster]() { broadcaster.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  auto start = std::chrono::steady_clock::now();
+  broadcaster.stop();
+  broadcaster_thread.join();
+
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST_F(AnnouncementTest, DeliversAnnouncementsOverMulticast) {
+  const std::string test_file_path = "../test_local_files/test_multicast.txt";
+  createTestFile(test_file_path);
+  local_manager_ref->addResource("test", test_file_path);
+
+  p2p::AnnouncementBroadcaster broadcaster(
+      local_manager_ref, 1, sender_port, brdcst_port, std::chrono::seconds(60));
+  broadcaster.setTransport(std::make_shared<p2p::MulticastTransport>(
+      "239.255.77.77", brdcst_port, 1, "127.0.0.1"));
+  p2p::AnnouncementReceiver receiver(remote_manager_ref, 2, brdcst_port, 1);
+  receiver.joinMulticastGroup("239.255.77.77", "127.0.0.1");
+
+  std::jthread receiver_thread([&receiver]() { receiver.run(); });
+  std::jthread broadcaster_thread([&broadcaster]() { broadcaster.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  broadcaster.stop();
+  receiver.stop();
+  broadcaster_thread.join();
+  receiver_thread.join();
+
+  EXPECT_EQ(remote_manager_ref->getAllResources().size(), 1);
+
+  removeTestFile(test_file_path);
+}
+
+TEST_F(AnnouncementTest, KeepsNodesOnOneHostApart) {
+  const std::string test_file_path = "../test_local_files/test_one_host.txt";
+  createTestFile(test_file_path);
+  local_manager_ref->addResource("test", test_file_path);
+
+  struct in_addr loopback;
+  inet_pton(AF_INET, "127.0.0.1", &loopback);
+  // Two nodes on one host, told apart only by the port they serve on
+  p2p::AnnouncementBroadcaster first(local_manager_ref, 1, sender_port,
+                                     brdcst_port, std::chrono::seconds(60));
+  first.setServicePort(9101);
+  first.setTransport(std::make_shared<p2p::UnicastTransport>(
+      brdcst_port, std::vector<struct in_addr>{loopback}));
+  p2p::AnnouncementBroadcaster second(local_manager_ref, 3, sender_port + 10,
+                                      brdcst_port, std::chrono::seconds(60));
+  second.setServicePort(9102);
+  second.setTransport(std::make_shared<p2p::UnicastTransport>(
+      brdcst_port, std::vector<struct in_addr>{loopback}));
+  p2p::AnnouncementReceiver receiver(remote_manager_ref, 2, brdcst_port, 1);
+
+  std::jthread receiver_thread([&receiver]() { receiver.run(); });
+  std::jthread first_thread([&first]() { first.run(); });
+  std::jthread second_thread([&second]() { second.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  first.stop();
+  second.stop();
+  receiver.stop();
+  first_thread.join();
+  second_thread.join();
+  receiver_thread.join();
+
+  auto holders = remote_manager_ref->findNodesWithResource("test");
+  ASSERT_EQ(holders.size(), 2);
+  std::vector<uint16_t> ports{ntohs(holders[0].sin_port),
+                              ntohs(holders[1].sin_port)};
+  std::ranges::sort(ports);
+  EXPECT_EQ(ports, (std::vector<uint16_t>{9101, 9102}));
+
+  removeTestFile(test_file_path);
+}
+
+TEST_F(AnnouncementTest, DeliversAnnouncementsOverUnicast) {
+  const std::string test_file_path = "../test_local_files/test_unicast.txt";
+  createTestFile(test_file_path);
+  local_manager_ref->addResource("test", test_file_path);
+
+  struct in_addr loopback;
+  inet_pton(AF_INET, "127.0.0.1", &loopback);
+  p2p::AnnouncementBroadcaster broadcaster(
+      local_manager_ref, 1, sender_port, brdcst_port, std::chrono::seconds(60));
+  broadcaster.setTransport(std::make_shared<p2p::UnicastTransport>(
+      brdcst_port, std::vector<struct in_addr>{loopback}));
+  p2p::AnnouncementReceiver receiver(remote_manager_ref, 2, brdcst_port, 1);
+
+  std::jthread receiver_thread([&receiver]() { receiver.run(); });
+  std::jthread broadcaster_thread([&broadcaster]() { broadcaster.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  broadcaster.stop();
+  receiver.stop();
+  broadcaster_thread.join();
+  receiver_thread.join();
+
+  auto remote_resources = remote_manager_ref->getAllResources();
+  ASSERT_EQ(remote_resources.size(), 1);
+  EXPECT_EQ(remote_resources[0].first.sin_addr.s_addr, loopback.s_addr);
+
+  removeTestFile(test_file_path);
+}
+
+TEST_F(AnnouncementTest, MulticastTransportRejectsUnicastGroup) {
+  EXPECT_THROW(p2p::MulticastTransport("192.168.1.1", brdcst_port),
+               std::runtime_error);
+}
+
+TEST_F(AnnouncementTest, DigestModeFetchesCatalogOnce) {
+  const std::string test_file_path = "../test_local_files/test_digest.txt";
+  createTestFile(test_file_path);
+  local_manager_ref->addResource("test", test_file_path);
+
+  struct in_addr loopback;
+  inet_pton(AF_INET, "127.0.0.1", &loopback);
+  p2p::TcpServer server(local_manager_ref, 8087);
+  p2p::AnnouncementBroadcaster broadcaster(
+      local_manager_ref, 1, sender_port, brdcst_port, std::chrono::seconds(1));
+  broadcaster.setTransport(std::make_shared<p2p::UnicastTransport>(
+      brdcst_port, std::vector<struct in_addr>{loopback}));
+  broadcaster.setServicePort(8087);
+  broadcaster.enableDigestMode();
+  p2p::AnnouncementReceiver receiver(remote_manager_ref, 2, brdcst_port, 1);
+
+  std::jthread server_thread([&server]() { server.run(); });
+  std::jthread receiver_thread([&receiver]() { receiver.run(); });
+  std::jthread broadcaster_thread([&broadcaster]() { broadcaster.run(); });
+  std::this_thread::sleep_for(std::chrono::seconds(4));
+  broadcaster.stop();
+  receiver.stop();
+  server.stop();
+  broadcaster_thread.join();
+  receiver_thread.join();
+  server_thread.join();
+
+  auto remote_resources = remote_manager_ref->getAllResources();
+  ASSERT_EQ(remote_resources.size(), 1);
+  EXPECT_EQ(remote_resources[0].second.name, "test");
+
+  removeTestFile(test_file_path);
+}
+
+TEST_F(AnnouncementTest, RebroadcastsCachedDatagramWithFreshTimestamp) {
+  struct RecordingTransport : p2p::AnnouncementTransport {
+    std::mutex mutex;
+    std::vector<std::vector<uint8_t>> datagrams;
+
+    void configureSocket(int) override {}
+    void send(int, const std::vector<uint8_t> &datagram) override {
+      std::lock_guard lock(mutex);
+      datagrams.push_back(datagram);
+    }
+    size_t count() {
+      std::lock_guard lock(mutex);
+      return datagrams.size();
+    }
+  };
+  auto waitForDatagrams = [](RecordingTransport &transport, size_t count) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (transport.count() < count &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return transport.count() >= count;
+  };
+
+  const std::string test_file_path = "../test_local_files/test_cached.txt";
+  createTestFile(test_file_path);
+  local_manager_ref->addResource("test", test_file_path);
+  auto transport = std::make_shared<RecordingTransport>();
+  p2p::AnnouncementBroadcaster broadcaster(
+      local_manager_ref, 1, sender_port, brdcst_port, std::chrono::seconds(1));
+  broadcaster.setTransport(transport);
+
+  std::jthread broadcaster_thread([&broadcaster]() { broadcaster.run(); });
+  ASSERT_TRUE(waitForDatagrams(*transport, 2));
+  local_manager_ref->addResource("other", test_file_path);
+  ASSERT_TRUE(waitForDatagrams(*transport, 3));
+  broadcaster.stop();
+  broadcaster_thread.join();
+
+  auto timestamp = [](const std::vector<uint8_t> &datagram) {
+    uint64_t value;
+    std::memcpy(&value, datagram.data() + sizeof(uint32_t), sizeof(value));
+    return value;
+  };
+  const auto &first = transport->datagrams[0];
+  const auto &second = transport->datagrams[1];
+  ASSERT_EQ(first.size(), second.size());
+  EXPECT_GT(timestamp(second), timestamp(first));
+  // Only the timestamp differs while the catalog is unchanged
+  EXPECT_TRUE(std::equal(first.begin(), first.begin() + sizeof(uint32_t),
+                         second.begin()));
+  EXPECT_TRUE(std::equal(first.begin() + sizeof(uint32_t) + sizeof(uint64_t),
+                         first.end(),
+                         second.begin() + sizeof(uint32_t) + sizeof(uint64_t)));
+
+  uint32_t resource_count;
+  const auto &third = transport->datagrams[2];
+  std::memcpy(&resource_count,
+              third.data() + 2 * sizeof(uint32_t) + sizeof(uint64_t),
+              sizeof(resource_count));
+  EXPECT_EQ(resource_count, 2);
+  EXPECT_GT(third.size(), second.size());
+
+  removeTestFile(test_file_path);
+}
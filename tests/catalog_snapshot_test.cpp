@@ -0,0 +1,162 @@
+#include "p2p-resource-sync/catalog_snapshot.hpp"
+#include "p2p-resource-sync/remote_resource_manager.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+class CatalogSnapshotTest : public ::testing::Test {
+protected:
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() /
+      ("catalog_snapshot_test_" + std::to_string(getpid()) + ".snapshot");
+
+  void TearDown() override { std::filesystem::remove(path); }
+
+  struct sockaddr_in createAddress(const char *ip, uint16_t port) {
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+  }
+
+  uint64_t now() {
+    return std::chrono::system_clock::now().time_since_epoch().count();
+  }
+
+  void saveTwoNodes() {
+    p2p::RemoteResourceManager manager(std::chrono::seconds(60));
+    manager.addOrUpdateNodeResources(createAddress("10.0.0.2", 9000),
+                                     {{"movie.mkv", 700}, {"song.mp3", 5}},
+                                     now(), 42);
+    manager.addOrUpdateNodeResources(createAddress("10.0.0.1", 9000),
+                                     {{"movie.mkv", 700}}, now());
+    manager.saveSnapshot(path);
+  }
+};
+
+TEST_F(CatalogSnapshotTest, FileRoundTripsNodesAndSharesNames) {
+  saveTwoNodes();
+
+  p2p::CatalogSnapshotFile file(path);
+  ASSERT_EQ(file.nodeCount(), 2);
+  auto node = file.findNode(createAddress("10.0.0.2", 9000));
+  ASSERT_TRUE(node.has_value());
+  EXPECT_EQ(node->catalogDigest, 42);
+  ASSERT_EQ(node->entries.size(), 2);
+  EXPECT_EQ(file.name(node->entries[0].nameId), "movie.mkv");
+  EXPECT_EQ(node->entries[1].size, 5);
+
+  auto other = file.findNode(createAddress("10.0.0.1", 9000));
+  ASSERT_TRUE(other.has_value());
+  EXPECT_FALSE(other->catalogDigest.has_value());
+  EXPECT_EQ(other->entries[0].nameId, node->entries[0].nameId);
+  EXPECT_FALSE(file.findNode(createAddress("10.0.0.3", 9000)).has_value());
+}
+
+TEST_F(CatalogSnapshotTest, LoadedNodesAreProvisionalAndServeLookups) {
+  saveTwoNodes();
+
+  p2p::RemoteResourceManager manager(std::chrono::seconds(60));
+  EXPECT_EQ(manager.loadSnapshot(path), 2);
+  EXPECT_EQ(manager.getNodeCount(), 2);
+  EXPECT_TRUE(manager.isProvisional(createAddress("10.0.0.1", 9000)));
+  EXPECT_EQ(manager.findNodesWithResource("movie.mkv").size(), 2);
+  EXPECT_EQ(manager.searchResources("song").size(), 1);
+}
+
+TEST_F(CatalogSnapshotTest, AnnouncementsConfirmLoadedNodes) {
+  saveTwoNodes();
+  p2p::RemoteResourceManager manager(std::chrono::seconds(60));
+  manager.loadSnapshot(path);
+  auto first = createAddress("10.0.0.1", 9000);
+  auto second = createAddress("10.0.0.2", 9000);
+
+  // Older than the load time, but a live announcement still wins
+  manager.addOrUpdateNodeResources(second, {{"song.mp3", 5}}, 1, 43);
+  EXPECT_FALSE(manager.isProvisional(second));
+  EXPECT_FALSE(manager.hasResource(second, "movie.mkv"));
+
+  auto holders = manager.findNodesWithResource("movie.mkv");
+  ASSERT_EQ(holders.size(), 1);
+  EXPECT_TRUE(manager.isProvisional(first));
+
+  manager.addOrUpdateNodeResources(second, {{"movie.mkv", 700}}, now());
+  holders = manager.findNodesWithResource("movie.mkv");
+  ASSERT_EQ(holders.size(), 2);
+  EXPECT_EQ(holders[0].sin_addr.s_addr, second.sin_addr.s_addr);
+}
+
+TEST_F(CatalogSnapshotTest, DigestRefreshConfirmsLoadedNode) {
+  saveTwoNodes();
+  p2p::RemoteResourceManager manager(std::chrono::seconds(60));
+  manager.loadSnapshot(path);
+  auto node = createAddress("10.0.0.2", 9000);
+
+  EXPECT_FALSE(manager.refreshNode(node, 7, now()));
+  EXPECT_TRUE(manager.isProvisional(node));
+  EXPECT_TRUE(manager.refreshNode(node, 42, now()));
+  EXPECT_FALSE(manager.isProvisional(node));
+}
+
+TEST_F(CatalogSnapshotTest, LoadingKeepsKnownNodes) {
+  saveTwoNodes();
+  p2p::RemoteResourceManager manager(std::chrono::seconds(60));
+  auto node = createAddress("10.0.0.1", 9000);
+  manager.addOrUpdateNodeResources(node, {{"fresh.txt", 1}}, now());
+
+  EXPECT_EQ(manager.loadSnapshot(path), 2);
+  EXPECT_FALSE(manager.isProvisional(node));
+  EXPECT_TRUE(manager.hasResource(node, "fresh.txt"));
+  EXPECT_FALSE(manager.hasResource(node, "movie.mkv"));
+}
+
+TEST_F(CatalogSnapshotTest, UnconfirmedNodesExpire) {
+  saveTwoNodes();
+  p2p::RemoteResourceManager manager(std::chrono::seconds(1));
+  manager.loadSnapshot(path);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  manager.cleanupStaleNodes();
+  EXPECT_EQ(manager.getNodeCount(), 0);
+}
+
+TEST_F(CatalogSnapshotTest, RejectsMalformedFiles) {
+  saveTwoNodes();
+  auto size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size - 1);
+  EXPECT_THROW(p2p::CatalogSnapshotFile{path}, std::runtime_error);
+
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << std::string(64, 'x');
+  }
+  EXPECT_THROW(p2p::CatalogSnapshotFile{path}, std::runtime_error);
+  EXPECT_THROW(p2p::CatalogSnapshotFile{path.string() + ".missing"},
+               std::runtime_error);
+}
+
+TEST_F(CatalogSnapshotTest, RunSavesWhenStopping) {
+  auto node = createAddress("10.0.0.1", 9000);
+  {
+    p2p::RemoteResourceManager manager(std::chrono::seconds(60));
+    manager.enablePersistence(path, std::chrono::seconds(60));
+    manager.addOrUpdateNodeResources(node, {{"kept.txt", 3}}, now());
+    std::jthread runner([&manager]() { manager.run(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    manager.stop();
+  }
+
+  p2p::RemoteResourceManager restarted(std::chrono::seconds(60));
+  restarted.enablePersistence(path);
+  EXPECT_TRUE(restarted.hasResource(node, "kept.txt"));
+  EXPECT_TRUE(restarted.isProvisional(node));
+}
@@ -0,0 +1,158 @@
+#include "p2p-resource-sync/content_hasher.hpp"
+#include "p2p-resource-sync/hash_cache.hpp"
+#include "p2p-resource-sync/local_resource_manager.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+class ContentHasherTest : public ::testing::Test {
+protected:
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "content_hasher_test";
+
+  void SetUp() override {
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory); }
+
+  std::string writeFile(const std::string &name, const std::string &content) {
+    auto path = directory / name;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+    return path.string();
+  }
+
+  static std::optional<uint64_t> hashWith(p2p::ContentHasher &hasher,
+                                          const std::string &path) {
+    std::promise<std::optional<uint64_t>> result;
+    hasher.hashFile(path, [&result](std::optional<uint64_t> hash) {
+      result.set_value(hash);
+    });
+    return result.get_future().get();
+  }
+
+  static std::optional<uint64_t>
+  waitForHash(const p2p::LocalResourceManager &manager,
+              const std::string &name) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (std::chrono::steady_clock::now() < deadline) {
+      auto info = manager.getResourceInfo(name);
+      if (info && info->contentHash) {
+        return info->contentHash;
+      }
+      std::this_thread::sleep_for(10ms);
+    }
+    return std::nullopt;
+  }
+};
+
+TEST_F(ContentHasherTest, MatchesXxHash64ReferenceValues) {
+  EXPECT_EQ(p2p::ContentHasher::hashBytes("", 0), 0xEF46DB3751D8E999ULL);
+  EXPECT_EQ(p2p::ContentHasher::hashBytes("a", 1), 0xD24EC4F1A98C6E5BULL);
+  EXPECT_EQ(p2p::ContentHasher::hashBytes("abc", 3), 0x44BC2CF5AD770999ULL);
+  std::string long_input(100, 'x');
+  EXPECT_NE(p2p::ContentHasher::hashBytes(long_input.data(), 100),
+            p2p::ContentHasher::hashBytes(long_input.data(), 100, 1));
+}
+
+TEST_F(ContentHasherTest, HashDoesNotDependOnThreadCount) {
+  // Spans three chunks, the last one partial
+  std::string content(2 * constants::content_hash::CHUNK_SIZE + 12345, '\0');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>(i * 31 + i / 4096);
+  }
+  auto path = writeFile("large.bin", content);
+
+  p2p::ContentHasher single(1);
+  p2p::ContentHasher pool(4);
+  auto hash = hashWith(single, path);
+  ASSERT_TRUE(hash.has_value());
+  EXPECT_EQ(hashWith(pool, path), hash);
+
+  std::vector<uint64_t> chunk_hashes;
+  for (uint64_t offset = 0; offset < content.size();
+       offset += constants::content_hash::CHUNK_SIZE) {
+    auto length = std::min<uint64_t>(constants::content_hash::CHUNK_SIZE,
+                                     content.size() - offset);
+    chunk_hashes.push_back(p2p::ContentHasher::hashBytes(
+        content.data() + offset, length, chunk_hashes.size()));
+  }
+  EXPECT_EQ(*hash, p2p::ContentHasher::hashBytes(
+                       chunk_hashes.data(),
+                       chunk_hashes.size() * sizeof(uint64_t), content.size()));
+
+  content[constants::content_hash::CHUNK_SIZE + 1] ^= 1;
+  writeFile("large.bin", content);
+  EXPECT_NE(hashWith(pool, path), hash);
+}
+
+TEST_F(ContentHasherTest, ReportsUnreadableFiles) {
+  p2p::ContentHasher hasher(2);
+  EXPECT_FALSE(hashWith(hasher, (directory / "missing").string()).has_value());
+  EXPECT_TRUE(hashWith(hasher, writeFile("empty", "")).has_value());
+}
+
+TEST_F(ContentHasherTest, CacheSurvivesSaveAndLoad) {
+  p2p::HashCache cache;
+  cache.store("/data/a", 10, 100, 0xAAAA);
+  cache.store("/data/b", 20, 200, 0xBBBB);
+  cache.erase("/data/b");
+  auto file = directory / "hashes.cache";
+  cache.save(file);
+
+  p2p::HashCache loaded;
+  loaded.load(file);
+  EXPECT_EQ(loaded.size(), 1);
+  EXPECT_EQ(loaded.lookup("/data/a", 10, 100), 0xAAAA);
+  EXPECT_FALSE(loaded.lookup("/data/a", 11, 100).has_value());
+  EXPECT_FALSE(loaded.lookup("/data/a", 10, 101).has_value());
+  EXPECT_FALSE(loaded.lookup("/data/b", 20, 200).has_value());
+
+  std::ofstream(file, std::ios::binary | std::ios::trunc) << "garbage";
+  EXPECT_THROW(loaded.load(file), std::runtime_error);
+}
+
+TEST_F(ContentHasherTest, ManagerHashesResourcesAndReusesCachedHashes) {
+  auto cache_path = directory / "hashes.cache";
+  auto path = writeFile("song.mp3", "some audio");
+  uint64_t hash;
+  {
+    p2p::LocalResourceManager manager;
+    manager.enableContentHashing(cache_path, 2);
+    manager.addResource("song.mp3", path);
+    auto computed = waitForHash(manager, "song.mp3");
+    ASSERT_TRUE(computed.has_value());
+    hash = *computed;
+  }
+  ASSERT_TRUE(std::filesystem::exists(cache_path));
+
+  p2p::LocalResourceManager manager;
+  manager.enableContentHashing(cache_path, 2);
+  manager.addResource("song.mp3", path);
+  // Known from the cache, so set right away
+  EXPECT_EQ(manager.getResourceInfo("song.mp3")->contentHash, hash);
+
+  writeFile("song.mp3", "other audio");
+  manager.addResource("song.mp3", path);
+  auto rehashed = waitForHash(manager, "song.mp3");
+  ASSERT_TRUE(rehashed.has_value());
+  EXPECT_NE(*rehashed, hash);
+}
+
+TEST_F(ContentHasherTest, ManagerHashesResourcesAddedBeforeEnabling) {
+  p2p::LocalResourceManager manager;
+  manager.addResource("early", writeFile("early", "early content"));
+  EXPECT_FALSE(manager.getResourceInfo("early")->contentHash.has_value());
+
+  manager.enableContentHashing();
+  EXPECT_TRUE(waitForHash(manager, "early").has_value());
+}
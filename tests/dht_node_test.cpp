@@ -0,0 +1,192 @@
+#include "p2p-resource-sync/dht_node.hpp"
+#include "p2p-resource-sync/remote_resource_manager.hpp"
+#include <arpa/inet.h>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+class DhtNodeTest : public ::testing::Test {
+protected:
+  static struct sockaddr_in createAddress(const char *ip, uint16_t port) {
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+  }
+
+  // Node i lives at 10.0.x.y:4000 and serves resources on port 8080
+  static struct sockaddr_in nodeAddress(size_t index) {
+    struct sockaddr_in addr = createAddress("10.0.0.0", 4000);
+    addr.sin_addr.s_addr = htonl(ntohl(addr.sin_addr.s_addr) + index + 1);
+    return addr;
+  }
+
+  static struct sockaddr_in serviceAddress(size_t index) {
+    struct sockaddr_in addr = nodeAddress(index);
+    addr.sin_port = htons(8080);
+    return addr;
+  }
+
+  void startCluster(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      auto transport = network.createTransport(nodeAddress(i));
+      uint64_t id = p2p::DhtNode::keyFor("node-" + std::to_string(i));
+      nodes.push_back(std::make_unique<p2p::DhtNode>(id, transport));
+      if (i > 0) {
+        ASSERT_TRUE(nodes.back()->bootstrap({nodeAddress(0)}));
+      }
+    }
+  }
+
+  p2p::SimulatedDhtNetwork network;
+  std::vector<std::unique_ptr<p2p::DhtNode>> nodes;
+};
+
+TEST_F(DhtNodeTest, FindsProvidersAcrossCluster) {
+  const size_t cluster_size = 128;
+  startCluster(cluster_size);
+  for (size_t i = 0; i < cluster_size; ++i) {
+    nodes[i]->publish("resource_" + std::to_string(i), 100 + i,
+                      serviceAddress(i));
+  }
+
+  std::mt19937 random_engine(7);
+  std::uniform_int_distribution<size_t> pick(0, cluster_size - 1);
+  for (int lookup = 0; lookup < 50; ++lookup) {
+    size_t searcher = pick(random_engine);
+    size_t holder = pick(random_engine);
+    auto providers =
+        nodes[searcher]->findProviders("resource_" + std::to_string(holder));
+    ASSERT_EQ(providers.size(), 1);
+    EXPECT_EQ(providers[0].address.sin_addr.s_addr,
+              serviceAddress(holder).sin_addr.s_addr);
+    EXPECT_EQ(providers[0].size, 100 + holder);
+  }
+}
+
+TEST_F(DhtNodeTest, StateAndTrafficGrowLogarithmically) {
+  const size_t cluster_size = 256;
+  startCluster(cluster_size);
+  for (size_t i = 0; i < cluster_size; ++i) {
+    nodes[i]->publish("resource_" + std::to_string(i), 1, serviceAddress(i));
+  }
+
+  size_t max_routing = 0;
+  size_t max_stored = 0;
+  for (const auto &node : nodes) {
+    max_routing = std::max(max_routing, node->getRoutingTableSize());
+    max_stored = std::max(max_stored, node->getStoredProviderCount());
+  }
+  double log_n = std::log2(cluster_size);
+  EXPECT_LE(max_routing, constants::dht::BUCKET_SIZE * log_n);
+  // Each record is replicated on BUCKET_SIZE nodes, so a fair share is
+  // BUCKET_SIZE records per node
+  EXPECT_LE(max_stored, constants::dht::BUCKET_SIZE * 8);
+
+  size_t before = network.getMessageCount();
+  const size_t lookups = 32;
+  for (size_t i = 0; i < lookups; ++i) {
+    nodes[i]->findProviders("resource_" + std::to_string(cluster_size - 1 - i));
+  }
+  double per_lookup =
+      static_cast<double>(network.getMessageCount() - before) / lookups;
+  EXPECT_LE(per_lookup, constants::dht::LOOKUP_PARALLELISM * log_n);
+}
+
+TEST_F(DhtNodeTest, CachesHolders) {
+  startCluster(32);
+  nodes[5]->publish("cached", 10, serviceAddress(5));
+
+  ASSERT_EQ(nodes[20]->findProviders("cached").size(), 1);
+  size_t before = network.getMessageCount();
+  ASSERT_EQ(nodes[20]->findProviders("cached").size(), 1);
+  EXPECT_EQ(network.getMessageCount(), before);
+}
+
+TEST_F(DhtNodeTest, SurvivesFailedReplicas) {
+  const size_t cluster_size = 64;
+  startCluster(cluster_size);
+  nodes[1]->publish("replicated", 10, serviceAddress(1));
+
+  // Take a third of the cluster offline, keeping the searcher and holder
+  for (size_t i = 2; i < cluster_size; i += 3) {
+    network.setOnline(nodeAddress(i), false);
+  }
+
+  auto providers = nodes[cluster_size - 1]->findProviders("replicated");
+  ASSERT_EQ(providers.size(), 1);
+  EXPECT_EQ(providers[0].address.sin_addr.s_addr,
+            serviceAddress(1).sin_addr.s_addr);
+}
+
+TEST_F(DhtNodeTest, PublishesLocalResources) {
+  startCluster(16);
+  auto path = std::filesystem::temp_directory_path() / "dht_local_resource";
+  std::ofstream(path) << "content";
+  auto local_manager = std::make_shared<p2p::LocalResourceManager>();
+  local_manager->addResource("local", path.string());
+
+  nodes[3]->publishFrom(local_manager, serviceAddress(3));
+  nodes[3]->refresh();
+  EXPECT_EQ(nodes[9]->findProviders("local").size(), 1);
+
+  local_manager->removeResource("local");
+  local_manager->addResource("renamed", path.string());
+  nodes[3]->refresh();
+  EXPECT_EQ(nodes[9]->findProviders("renamed").size(), 1);
+
+  std::filesystem::remove(path);
+}
+
+TEST_F(DhtNodeTest, RemoteManagerUsesProviderLookup) {
+  startCluster(16);
+  nodes[2]->publish("only_in_dht", 10, serviceAddress(2));
+
+  p2p::RemoteResourceManager remote_manager(std::chrono::seconds(60));
+  auto *searcher = nodes[11].get();
+  remote_manager.setProviderLookup([searcher](const std::string &name) {
+    std::vector<struct sockaddr_in> holders;
+    for (const auto &provider : searcher->findProviders(name)) {
+      holders.push_back(provider.address);
+    }
+    return holders;
+  });
+
+  auto holders = remote_manager.findNodesWithResource("only_in_dht");
+  ASSERT_EQ(holders.size(), 1);
+  EXPECT_EQ(holders[0].sin_addr.s_addr, serviceAddress(2).sin_addr.s_addr);
+  EXPECT_TRUE(remote_manager.findNodesWithResource("missing").empty());
+}
+
+TEST_F(DhtNodeTest, WorksOverUdp) {
+  auto first_transport =
+      std::make_shared<p2p::UdpDhtTransport>("127.0.0.1", 9300);
+  auto second_transport =
+      std::make_shared<p2p::UdpDhtTransport>("127.0.0.1", 9301);
+  std::jthread first_thread([&]() { first_transport->run(); });
+  std::jthread second_thread([&]() { second_transport->run(); });
+
+  {
+    p2p::DhtNode first(p2p::DhtNode::keyFor("first"), first_transport);
+    p2p::DhtNode second(p2p::DhtNode::keyFor("second"), second_transport);
+    ASSERT_TRUE(second.bootstrap({createAddress("127.0.0.1", 9300)}));
+
+    // An unspecified provider address resolves to the publisher's host
+    second.publish("udp_resource", 42, createAddress("0.0.0.0", 8080));
+    auto providers = first.findProviders("udp_resource");
+    ASSERT_EQ(providers.size(), 1);
+    EXPECT_EQ(providers[0].address.sin_addr.s_addr,
+              createAddress("127.0.0.1", 8080).sin_addr.s_addr);
+    EXPECT_EQ(ntohs(providers[0].address.sin_port), 8080);
+    EXPECT_EQ(providers[0].size, 42);
+  }
+
+  first_transport->stop();
+  second_transport->stop();
+}
@@ -0,0 +1,165 @@
+#include "p2p-resource-sync/directory_watcher.hpp"
+#include "p2p-resource-sync/local_resource_manager.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+class DirectoryWatcherTest : public ::testing::Test {
+protected:
+  std::filesystem::path root =
+      std::filesystem::temp_directory_path() / "directory_watcher_test";
+  std::shared_ptr<p2p::LocalResourceManager> manager =
+      std::make_shared<p2p::LocalResourceManager>();
+  std::unique_ptr<p2p::DirectoryWatcher> watcher;
+  std::jthread watcher_thread;
+
+  void SetUp() override {
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+  }
+
+  void TearDown() override {
+    if (watcher) {
+      watcher->stop();
+    }
+    if (watcher_thread.joinable()) {
+      watcher_thread.join();
+    }
+    std::filesystem::remove_all(root);
+  }
+
+  void writeFile(const std::filesystem::path &relative,
+                 const std::string &content) {
+    std::filesystem::create_directories((root / relative).parent_path());
+    std::ofstream file(root / relative, std::ios::binary | std::ios::trunc);
+    file << content;
+  }
+
+  void startWatcher() {
+    watcher = std::make_unique<p2p::DirectoryWatcher>(manager, root, 20ms);
+    watcher_thread = std::jthread([this]() { watcher->run(); });
+    ASSERT_TRUE(
+        waitUntil([this]() { return watcher->getWatchedDirectoryCount() > 0; }));
+  }
+
+  static bool waitUntil(const std::function<bool()> &condition) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (std::chrono::steady_clock::now() < deadline) {
+      if (condition()) {
+        return true;
+      }
+      std::this_thread::sleep_for(10ms);
+    }
+    return condition();
+  }
+};
+
+TEST_F(DirectoryWatcherTest, RegistersExistingTree) {
+  writeFile("top.txt", "top");
+  writeFile("nested/deeper/leaf.bin", "leaf contents");
+
+  startWatcher();
+
+  ASSERT_TRUE(waitUntil([this]() { return manager->getAllResources().size() == 2; }));
+  auto leaf = manager->getResourceInfo("nested/deeper/leaf.bin");
+  ASSERT_TRUE(leaf.has_value());
+  EXPECT_EQ(leaf->size, 13);
+  EXPECT_EQ(leaf->path, (std::filesystem::canonical(root) /
+                         "nested/deeper/leaf.bin")
+                            .string());
+  EXPECT_TRUE(manager->getResourceInfo("top.txt").has_value());
+  EXPECT_EQ(watcher->getWatchedDirectoryCount(), 3);
+}
+
+TEST_F(DirectoryWatcherTest, FollowsFileChanges) {
+  startWatcher();
+
+  writeFile("song.mp3", "abc");
+  ASSERT_TRUE(waitUntil(
+      [this]() { return manager->getResourceInfo("song.mp3").has_value(); }));
+  EXPECT_EQ(manager->getResourceInfo("song.mp3")->size, 3);
+
+  writeFile("song.mp3", "abcdefgh");
+  ASSERT_TRUE(waitUntil(
+      [this]() { return manager->getResourceInfo("song.mp3")->size == 8; }));
+
+  std::filesystem::rename(root / "song.mp3", root / "renamed.mp3");
+  ASSERT_TRUE(waitUntil(
+      [this]() { return manager->getResourceInfo("renamed.mp3").has_value(); }));
+  EXPECT_FALSE(manager->getResourceInfo("song.mp3").has_value());
+
+  std::filesystem::remove(root / "renamed.mp3");
+  ASSERT_TRUE(
+      waitUntil([this]() { return manager->getAllResources().empty(); }));
+}
+
+TEST_F(DirectoryWatcherTest, FollowsDirectoryChanges) {
+  startWatcher();
+
+  writeFile("album/one.flac", "1");
+  writeFile("album/two.flac", "22");
+  ASSERT_TRUE(waitUntil([this]() {
+    return manager->getResourceInfo("album/two.flac").has_value() &&
+           manager->getResourceInfo("album/one.flac").has_value();
+  }));
+
+  std::filesystem::rename(root / "album", root / "archive");
+  ASSERT_TRUE(waitUntil([this]() {
+    return manager->getResourceInfo("archive/one.flac").has_value() &&
+           manager->getResourceInfo("archive/two.flac").has_value();
+  }));
+  EXPECT_EQ(manager->getAllResources().size(), 2);
+
+  // Files created in the moved directory are still noticed
+  writeFile("archive/three.flac", "333");
+  ASSERT_TRUE(waitUntil([this]() {
+    return manager->getResourceInfo("archive/three.flac").has_value();
+  }));
+
+  std::filesystem::remove_all(root / "archive");
+  ASSERT_TRUE(
+      waitUntil([this]() { return manager->getAllResources().empty(); }));
+  EXPECT_TRUE(
+      waitUntil([this]() { return watcher->getWatchedDirectoryCount() == 1; }));
+}
+
+TEST_F(DirectoryWatcherTest, LeavesOtherResourcesAlone) {
+  auto outside = std::filesystem::temp_directory_path() /
+                 "directory_watcher_test_outside";
+  std::ofstream(outside) << "outside";
+  manager->addResource("manual", outside.string());
+  writeFile("shared.txt", "shared");
+
+  startWatcher();
+  ASSERT_TRUE(waitUntil(
+      [this]() { return manager->getResourceInfo("shared.txt").has_value(); }));
+
+  std::filesystem::remove(root / "shared.txt");
+  ASSERT_TRUE(waitUntil(
+      [this]() { return !manager->getResourceInfo("shared.txt").has_value(); }));
+  EXPECT_TRUE(manager->getResourceInfo("manual").has_value());
+
+  std::filesystem::remove(outside);
+}
+
+TEST_F(DirectoryWatcherTest, AppliesChangesWhileEventsKeepArriving) {
+  startWatcher();
+  // Never quiet for a whole coalescing window
+  std::jthread churn([this](std::stop_token stop) {
+    for (int i = 0; !stop.stop_requested(); ++i) {
+      writeFile("churn.log", std::to_string(i));
+      std::this_thread::sleep_for(5ms);
+    }
+  });
+  writeFile("new.txt", "new");
+
+  EXPECT_TRUE(waitUntil(
+      [this]() { return manager->getResourceInfo("new.txt").has_value(); }));
+  EXPECT_TRUE(manager->getResourceInfo("churn.log").has_value());
+}
@@ -0,0 +1,252 @@
+#include "p2p-resource-sync/announcement_broadcaster.hpp"
+#include "p2p-resource-sync/announcement_receiver.hpp"
+#include "p2p-resource-sync/catalog_codec.hpp"
+#include "p2p-resource-sync/gossip_node.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class GossipNodeTest : public ::testing::Test {
+protected:
+  static constexpr uint16_t BASE_PORT = 9200;
+
+  struct TestNode {
+    std::shared_ptr<p2p::LocalResourceManager> local_manager;
+    std::shared_ptr<p2p::RemoteResourceManager> remote_manager;
+    std::unique_ptr<p2p::GossipNode> node;
+    std::jthread thread;
+  };
+
+  void TearDown() override {
+    for (auto &test_node : nodes) {
+      if (test_node.node) {
+        test_node.node->stop();
+      }
+    }
+    for (auto &test_node : nodes) {
+      if (test_node.thread.joinable()) {
+        test_node.thread.join();
+      }
+    }
+    // Nodes wait for their catalog fetches, which read other nodes' managers
+    for (auto &test_node : nodes) {
+      test_node.node.reset();
+    }
+    nodes.clear();
+    for (const auto &path : temp_files) {
+      std::filesystem::remove(path);
+    }
+  }
+
+  p2p::GossipConfig fastConfig() {
+    return p2p::GossipConfig{.protocolPeriod = std::chrono::milliseconds(100),
+                             .pingTimeout = std::chrono::milliseconds(40),
+                             .suspicionTimeout = std::chrono::milliseconds(500),
+                             .indirectProbes = 3,
+                             .maxPiggybackUpdates = 8,
+                             .syncIntervalPeriods = 5};
+  }
+
+  struct sockaddr_in gossipAddress(size_t index) {
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(BASE_PORT + index);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    return addr;
+  }
+
+  // Serves catalogs straight from the owning node's LocalResourceManager,
+  // keyed by service port, instead of going through a TcpServer
+  p2p::FetchedCatalog fetchCatalog(uint16_t service_port) {
+    auto &local_manager = nodes.at(service_port - BASE_PORT).local_manager;
+    auto resources =
+        p2p::CatalogCodec::fromLocalResources(local_manager->getAllResources());
+    auto entries = p2p::CatalogCodec::serializeEntries(resources);
+    return p2p::FetchedCatalog{
+        .digest = p2p::CatalogCodec::digest(entries.data(), entries.size()),
+        .resources = std::move(resources)};
+  }
+
+  void startCluster(size_t count) {
+    nodes.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      auto path = std::filesystem::temp_directory_path() /
+                  ("gossip_file_" + std::to_string(i));
+      std::ofstream(path) << "content of node " << i;
+      temp_files.push_back(path.string());
+
+      auto &test_node = nodes[i];
+      test_node.local_manager = std::make_shared<p2p::LocalResourceManager>();
+      test_node.local_manager->addResource("file_" + std::to_string(i),
+                                           path.string());
+      test_node.remote_manager = std::make_shared<p2p::RemoteResourceManager>(
+          std::chrono::seconds(60));
+      // The service port doubles as the key of the node in fetchCatalog
+      test_node.node = std::make_unique<p2p::GossipNode>(
+          test_node.local_manager, test_node.remote_manager, i + 1,
+          "127.0.0.1", BASE_PORT + i, BASE_PORT + i, fastConfig());
+      test_node.node->setCatalogFetchFunction(
+          [this](const struct in_addr &, uint16_t port) {
+            return this->fetchCatalog(port);
+          });
+    }
+    for (size_t i = 0; i < count; ++i) {
+      auto *node = nodes[i].node.get();
+      if (i > 0) {
+        node->join({gossipAddress(0)});
+      }
+      nodes[i].thread = std::jthread([node]() { node->run(); });
+    }
+  }
+
+  bool waitFor(const std::function<bool()> &condition,
+               std::chrono::seconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+      if (condition()) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return condition();
+  }
+
+  std::vector<TestNode> nodes;
+  std::vector<std::string> temp_files;
+};
+
+TEST_F(GossipNodeTest, ClusterConvergesOnMembershipAndCatalogs) {
+  const size_t cluster_size = 24;
+  startCluster(cluster_size);
+
+  bool converged = waitFor(
+      [&]() {
+        for (const auto &test_node : nodes) {
+          if (test_node.node->getAliveMemberCount() != cluster_size - 1 ||
+              test_node.remote_manager->getAllResources().size() !=
+                  cluster_size - 1) {
+            return false;
+          }
+        }
+        return true;
+      },
+      std::chrono::seconds(15));
+  ASSERT_TRUE(converged);
+
+  auto holders = nodes[0].remote_manager->findNodesWithResource("file_7");
+  ASSERT_EQ(holders.size(), 1);
+  EXPECT_EQ(ntohs(holders[0].sin_port), BASE_PORT + 7);
+}
+
+TEST_F(GossipNodeTest, CatalogChangeReachesAllMembers) {
+  const size_t cluster_size = 8;
+  startCluster(cluster_size);
+  ASSERT_TRUE(waitFor(
+      [&]() {
+        for (const auto &test_node : nodes) {
+          if (test_node.remote_manager->getAllResources().size() !=
+              cluster_size - 1) {
+            return false;
+          }
+        }
+        return true;
+      },
+      std::chrono::seconds(10)));
+
+  nodes[3].local_manager->addResource("extra", temp_files[0]);
+
+  bool propagated = waitFor(
+      [&]() {
+        for (size_t i = 0; i < cluster_size; ++i) {
+          if (i != 3 && nodes[i]
+                            .remote_manager->findNodesWithResource("extra")
+                            .empty()) {
+            return false;
+          }
+        }
+        return true;
+      },
+      std::chrono::seconds(10));
+  EXPECT_TRUE(propagated);
+}
+
+TEST_F(GossipNodeTest, FailedMemberIsDeclaredDeadAndForgotten) {
+  const size_t cluster_size = 6;
+  startCluster(cluster_size);
+  ASSERT_TRUE(waitFor(
+      [&]() {
+        for (const auto &test_node : nodes) {
+          if (test_node.remote_manager->getAllResources().size() !=
+              cluster_size - 1) {
+            return false;
+          }
+        }
+        return true;
+      },
+      std::chrono::seconds(10)));
+
+  nodes.back().node->stop();
+  nodes.back().thread.join();
+  nodes.back().node.reset();
+
+  bool detected = waitFor(
+      [&]() {
+        for (size_t i = 0; i + 1 < cluster_size; ++i) {
+          auto members = nodes[i].node->getMembers();
+          auto failed = std::ranges::find_if(members, [&](const auto &m) {
+            return m.nodeId == cluster_size;
+          });
+          if (failed == members.end() ||
+              failed->state != p2p::MemberState::DEAD ||
+              !nodes[i]
+                   .remote_manager
+                   ->findNodesWithResource("file_" +
+                                           std::to_string(cluster_size - 1))
+                   .empty()) {
+            return false;
+          }
+        }
+        return true;
+      },
+      std::chrono::seconds(10));
+  EXPECT_TRUE(detected);
+}
+
+TEST_F(GossipNodeTest, GossipAndAnnouncementsShareOneNodeIdentity) {
+  startCluster(2);
+  // Node 1 also announces its catalog to node 0, as on a shared LAN
+  struct in_addr loopback;
+  inet_pton(AF_INET, "127.0.0.1", &loopback);
+  p2p::AnnouncementBroadcaster broadcaster(nodes[1].local_manager, 2, 9300,
+                                           9301, std::chrono::seconds(1));
+  broadcaster.setServicePort(BASE_PORT + 1);
+  broadcaster.setTransport(std::make_shared<p2p::UnicastTransport>(
+      9301, std::vector<struct in_addr>{loopback}));
+  p2p::AnnouncementReceiver receiver(nodes[0].remote_manager, 1, 9301, 100);
+  std::jthread receiver_thread([&receiver]() { receiver.run(); });
+  std::jthread broadcaster_thread([&broadcaster]() { broadcaster.run(); });
+
+  EXPECT_TRUE(waitFor(
+      [&]() {
+        return nodes[0].node->getAliveMemberCount() == 1 &&
+               nodes[0].remote_manager->getNodeCount() > 0;
+      },
+      std::chrono::seconds(10)));
+  // Both sources have had the chance to register node 1
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  broadcaster.stop();
+  receiver.stop();
+  broadcaster_thread.join();
+  receiver_thread.join();
+
+  EXPECT_EQ(nodes[0].remote_manager->getNodeCount(), 1);
+  auto holders = nodes[0].remote_manager->findNodesWithResource("file_1");
+  ASSERT_EQ(holders.size(), 1);
+  EXPECT_EQ(ntohs(holders[0].sin_port), BASE_PORT + 1);
+}
@@ -1,7 +1,12 @@
 #include "p2p-resource-sync/local_resource_manager.hpp"
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
 
 class LocalResourceManagerTest : public ::testing::Test {
 protected:
@@ -39,6 +44,31 @@ TEST_F(LocalResourceManagerTest, AddResourceInsertSuccessful) {
   removeTempFile(temp_path);
 }
 
+TEST_F(LocalResourceManagerTest, AcceptsResourcesLargerThanFourGiB) {
+  p2p::LocalResourceManager manager;
+  std::string temp_path = createTempFile("large_sparse_resource", "");
+  // Sparse, so it takes no disk space
+  std::filesystem::resize_file(temp_path, (5ULL << 30) + 7);
+
+  EXPECT_TRUE(manager.addResource("large", temp_path));
+  EXPECT_EQ(manager.getResourceInfo("large")->size, (5ULL << 30) + 7);
+
+  removeTempFile(temp_path);
+}
+
+TEST_F(LocalResourceManagerTest, RejectsResourcesOverConfiguredSize) {
+  p2p::LocalResourceManager manager(16);
+  std::string small_path = createTempFile("small_resource", "0123456789");
+  std::string large_path =
+      createTempFile("oversized_resource", std::string(17, 'x'));
+
+  EXPECT_TRUE(manager.addResource("small", small_path));
+  EXPECT_THROW(manager.addResource("large", large_path), p2p::ResourceError);
+
+  removeTempFile(small_path);
+  removeTempFile(large_path);
+}
+
 TEST_F(LocalResourceManagerTest, AddResourceInsertThenUpdateSuccessful) {
   p2p::LocalResourceManager manager1;
   std::string temp_path = createTempFile("some_path");
@@ -183,3 +213,179 @@ TEST_F(LocalResourceManagerTest, GetResourceInfoResourceDoesNotExist) {
 
   ASSERT_FALSE(resource_info.has_value());
 }
+
+TEST_F(LocalResourceManagerTest, VersionIncrementsOnMutation) {
+  p2p::LocalResourceManager manager1;
+  std::string temp_path = createTempFile("some_path");
+
+  EXPECT_EQ(manager1.getVersion(), 0);
+  manager1.addResource("some_name", temp_path);
+  EXPECT_EQ(manager1.getVersion(), 1);
+  EXPECT_FALSE(manager1.removeResource("other_name"));
+  EXPECT_EQ(manager1.getVersion(), 1);
+  manager1.removeResource("some_name");
+  EXPECT_EQ(manager1.getVersion(), 2);
+
+  removeTempFile(temp_path);
+}
+
+TEST_F(LocalResourceManagerTest, ChangeListenerReceivesNewVersion) {
+  p2p::LocalResourceManager manager1;
+  std::string temp_path = createTempFile("some_path");
+  std::vector<uint64_t> versions;
+
+  size_t listener_id = manager1.addChangeListener(
+      [&versions](uint64_t version) { versions.push_back(version); });
+  manager1.addResource("some_name", temp_path);
+  manager1.removeChangeListener(listener_id);
+  manager1.removeResource("some_name");
+
+  ASSERT_EQ(versions.size(), 1);
+  EXPECT_EQ(versions[0], 1);
+
+  removeTempFile(temp_path);
+}
+
+TEST_F(LocalResourceManagerTest, PagesCoverCatalogInNameOrder) {
+  p2p::LocalResourceManager manager1;
+  std::string temp_path = createTempFile("some_path");
+  for (int i = 0; i < 25; ++i) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "name_%02d", i);
+    manager1.addResource(name, temp_path);
+  }
+
+  std::vector<std::string> names;
+  std::optional<std::string> cursor;
+  size_t pages = 0;
+  do {
+    auto page = manager1.getResourcePage(cursor, 10);
+    EXPECT_LE(page.resources.size(), 10);
+    for (const auto &resource : page.resources) {
+      names.push_back(resource.name);
+    }
+    cursor = page.nextCursor;
+    pages++;
+  } while (cursor);
+
+  EXPECT_EQ(pages, 3);
+  ASSERT_EQ(names.size(), 25);
+  EXPECT_TRUE(std::ranges::is_sorted(names));
+
+  removeTempFile(temp_path);
+}
+
+TEST_F(LocalResourceManagerTest, ForEachResourceVisitsAcrossPages) {
+  p2p::LocalResourceManager manager1;
+  std::string temp_path = createTempFile("some_path");
+  for (int i = 0; i < 600; ++i) {
+    manager1.addResource("name_" + std::to_string(i), temp_path);
+  }
+
+  size_t visited = 0;
+  manager1.forEachResource([&](const p2p::ResourceInfo &resource) {
+    // The lock is not held while visiting
+    if (resource.name == "name_0") {
+      manager1.removeResource("name_599");
+    }
+    visited++;
+  });
+  EXPECT_EQ(visited, 599);
+
+  removeTempFile(temp_path);
+}
+
+TEST_F(LocalResourceManagerTest, SnapshotsAreImmutableAndShared) {
+  p2p::LocalResourceManager manager1;
+  std::string temp_path = createTempFile("some_path");
+  manager1.addResource("b", temp_path);
+  manager1.addResource("a", temp_path);
+
+  auto snapshot = manager1.getSnapshot();
+  EXPECT_EQ(snapshot->version, manager1.getVersion());
+  ASSERT_EQ(snapshot->resources.size(), 2);
+  EXPECT_EQ(snapshot->resources[0]->name, "a");
+  EXPECT_EQ(snapshot->find("b")->path, temp_path);
+  EXPECT_EQ(snapshot->find("c"), nullptr);
+  // Unchanged catalog, same snapshot
+  EXPECT_EQ(manager1.getSnapshot(), snapshot);
+
+  manager1.removeResource("a");
+  manager1.addResource("c", temp_path);
+  auto next = manager1.getSnapshot();
+  EXPECT_NE(next, snapshot);
+  EXPECT_EQ(next->version, snapshot->version + 2);
+  EXPECT_EQ(next->resources.size(), 2);
+  EXPECT_NE(next->find("c"), nullptr);
+  // Entries that did not change are shared, not copied
+  EXPECT_EQ(next->find("b"), snapshot->find("b"));
+
+  // The old snapshot still shows the catalog it was taken from
+  EXPECT_EQ(snapshot->resources.size(), 2);
+  EXPECT_NE(snapshot->find("a"), nullptr);
+  EXPECT_EQ(snapshot->find("c"), nullptr);
+
+  removeTempFile(temp_path);
+}
+
+TEST_F(LocalResourceManagerTest, AddResourcesCommitsBatchAsOneVersion) {
+  p2p::LocalResourceManager manager1;
+  std::string temp_path = createTempFile("some_path");
+  std::vector<p2p::NewResource> resources;
+  for (int i = 0; i < 1000; ++i) {
+    resources.push_back({"name_" + std::to_string(i), temp_path});
+  }
+  resources.push_back({"missing", temp_path + "_missing"});
+  resources.push_back({std::string(300, 'x'), temp_path});
+
+  std::vector<uint64_t> versions;
+  manager1.addChangeListener(
+      [&versions](uint64_t version) { versions.push_back(version); });
+  auto results = manager1.addResources(resources);
+
+  ASSERT_EQ(results.size(), 1002);
+  EXPECT_TRUE(std::ranges::all_of(results.begin(), results.begin() + 1000,
+                                  [](const p2p::ResourceAddResult &result) {
+                                    return result.inserted && !result.error;
+                                  }));
+  EXPECT_FALSE(results[1000].inserted);
+  EXPECT_TRUE(results[1000].error.has_value());
+  EXPECT_TRUE(results[1001].error.has_value());
+  EXPECT_EQ(manager1.getAllResources().size(), 1000);
+  EXPECT_EQ(versions, std::vector<uint64_t>{1});
+  EXPECT_EQ(manager1.getSnapshot()->version, 1);
+
+  // Unchanged files are not committed again
+  results = manager1.addResources({{"name_0", temp_path}});
+  EXPECT_FALSE(results[0].inserted);
+  EXPECT_FALSE(results[0].error.has_value());
+  EXPECT_EQ(manager1.getVersion(), 1);
+
+  removeTempFile(temp_path);
+}
+
+TEST_F(LocalResourceManagerTest, CheckFileRefreshesChangedResource) {
+  p2p::LocalResourceManager manager1;
+  std::string temp_path = createTempFile("check_file_path", "short");
+  manager1.addResource("name", temp_path);
+  auto resource = *manager1.getResourceInfo("name");
+  auto version = manager1.getVersion();
+
+  struct stat file_stat;
+  ASSERT_EQ(stat(temp_path.c_str(), &file_stat), 0);
+  EXPECT_TRUE(manager1.checkFile(resource, file_stat));
+  EXPECT_EQ(manager1.getVersion(), version);
+
+  createTempFile("check_file_path", "much longer content");
+  ASSERT_EQ(stat(temp_path.c_str(), &file_stat), 0);
+  EXPECT_FALSE(manager1.checkFile(resource, file_stat));
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (manager1.getResourceInfo("name")->size != 19 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(manager1.getResourceInfo("name")->size, 19);
+  EXPECT_GT(manager1.getVersion(), version);
+
+  removeTempFile(temp_path);
+}
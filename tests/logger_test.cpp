@@ -0,0 +1,133 @@
+#include "p2p-resource-sync/logger.hpp"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LoggerTest : public ::testing::Test {
+protected:
+  void TearDown() override {
+    p2p::Logger::setOverflowPolicy(p2p::LogOverflowPolicy::BLOCK);
+    p2p::Logger::setNodeId(0);
+  }
+
+  static std::vector<std::string> lines(const std::string &output) {
+    std::vector<std::string> result;
+    std::istringstream stream(output);
+    for (std::string line; std::getline(stream, line);) {
+      result.push_back(line);
+    }
+    return result;
+  }
+
+  static void logFromThreads(size_t thread_count, size_t messages_each) {
+    std::vector<std::jthread> threads;
+    for (size_t t = 0; t < thread_count; ++t) {
+      threads.emplace_back([t, messages_each]() {
+        for (size_t i = 0; i < messages_each; ++i) {
+          p2p::Logger::log(p2p::LogLevel::INFO, "logger_test thread " +
+                                                    std::to_string(t) + " #" +
+                                                    std::to_string(i));
+        }
+      });
+    }
+  }
+};
+
+TEST_F(LoggerTest, FormatsTimestampNodeAndLevel) {
+  p2p::Logger::setNodeId(7);
+  testing::internal::CaptureStderr();
+  p2p::Logger::log(p2p::LogLevel::ERROR, "something failed");
+  p2p::Logger::flush();
+  auto output = lines(testing::internal::GetCapturedStderr());
+
+  ASSERT_EQ(output.size(), 1);
+  EXPECT_TRUE(std::regex_match(
+      output[0], std::regex(R"(\d{4}-\d\d-\d\d \d\d:\d\d:\d\d\.\d{3} )"
+                            R"(\[Node 7\] \[ERROR\] something failed)")))
+      << output[0];
+}
+
+TEST_F(LoggerTest, BlockingPolicyWritesEveryMessageInOrder) {
+  // More than the queue holds, so producers have to wait for the writer
+  const size_t thread_count = 4;
+  const size_t messages_each = 5000;
+  testing::internal::CaptureStderr();
+  logFromThreads(thread_count, messages_each);
+  p2p::Logger::flush();
+  auto output = lines(testing::internal::GetCapturedStderr());
+
+  std::vector<size_t> next(thread_count, 0);
+  for (const auto &line : output) {
+    auto position = line.find("logger_test thread ");
+    ASSERT_NE(position, std::string::npos) << line;
+    size_t thread = 0;
+    size_t index = 0;
+    ASSERT_EQ(std::sscanf(line.c_str() + position, "logger_test thread %zu #%zu",
+                          &thread, &index),
+              2);
+    ASSERT_LT(thread, thread_count);
+    EXPECT_EQ(index, next[thread]);
+    next[thread] = index + 1;
+  }
+  EXPECT_EQ(next, std::vector<size_t>(thread_count, messages_each));
+}
+
+TEST_F(LoggerTest, DropPolicyAccountsForEveryMessage) {
+  const size_t thread_count = 4;
+  const size_t messages_each = 20000;
+  p2p::Logger::setOverflowPolicy(p2p::LogOverflowPolicy::DROP);
+  auto dropped_before = p2p::Logger::getDroppedCount();
+  testing::internal::CaptureStderr();
+  logFromThreads(thread_count, messages_each);
+  p2p::Logger::flush();
+  auto output = lines(testing::internal::GetCapturedStderr());
+
+  size_t written = 0;
+  for (const auto &line : output) {
+    if (line.find("logger_test thread ") != std::string::npos) {
+      written++;
+    }
+  }
+  EXPECT_EQ(written + p2p::Logger::getDroppedCount() - dropped_before,
+            thread_count * messages_each);
+}
+
+TEST_F(LoggerTest, FormatsArgumentsInPlaceOfPlaceholders) {
+  EXPECT_EQ(p2p::Logger::format("{} of {} bytes from {}", 42, uint64_t{100},
+                                std::string("host")),
+            "42 of 100 bytes from host");
+  EXPECT_EQ(p2p::Logger::format("{} {} {}", true, 'x', 1.5), "true x 1.5");
+  EXPECT_EQ(p2p::Logger::format("{{}} {} {", "literal"), "{} literal {");
+  EXPECT_EQ(p2p::Logger::format("{} and {}", -1), "-1 and {}");
+  EXPECT_EQ(p2p::Logger::format("no placeholders", 1), "no placeholders");
+}
+
+namespace {
+// Counts how often it is formatted
+struct Counted {
+  int *formatted;
+};
+
+std::ostream &operator<<(std::ostream &os, const Counted &counted) {
+  (*counted.formatted)++;
+  return os << "counted";
+}
+} // namespace
+
+TEST_F(LoggerTest, LevelsBelowMinimumAreNotFormatted) {
+  constexpr bool trace_enabled = p2p::LogLevel::TRACE >= p2p::MIN_LOG_LEVEL;
+  int formatted = 0;
+  testing::internal::CaptureStderr();
+  p2p::Logger::log<p2p::LogLevel::TRACE>("trace {}", Counted{&formatted});
+  p2p::Logger::log<p2p::LogLevel::ERROR>("error {}", Counted{&formatted});
+  p2p::Logger::flush();
+  auto output = lines(testing::internal::GetCapturedStderr());
+
+  EXPECT_EQ(formatted, trace_enabled ? 2 : 1);
+  ASSERT_EQ(output.size(), trace_enabled ? 2 : 1);
+  EXPECT_NE(output.back().find("[ERROR] error counted"), std::string::npos);
+}
@@ -0,0 +1,107 @@
+#include "p2p-resource-sync/name_index.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+class NameIndexTest : public ::testing::Test {
+protected:
+  static std::vector<std::string>
+  names(const std::vector<p2p::NameIndex::Match> &matches) {
+    std::vector<std::string> result;
+    for (const auto &match : matches) {
+      result.push_back(match.name);
+    }
+    return result;
+  }
+
+  p2p::NameIndex index;
+};
+
+TEST_F(NameIndexTest, RanksExactThenPrefixThenSubstring) {
+  index.insert("report");
+  index.insert("report_2024.pdf");
+  index.insert("annual_report.pdf");
+  index.insert("unrelated.txt");
+
+  auto matches = index.search("report", 10);
+  ASSERT_EQ(matches.size(), 3);
+  EXPECT_EQ(matches[0].name, "report");
+  EXPECT_EQ(matches[0].kind, p2p::NameIndex::MatchKind::EXACT);
+  EXPECT_EQ(matches[1].name, "report_2024.pdf");
+  EXPECT_EQ(matches[1].kind, p2p::NameIndex::MatchKind::PREFIX);
+  EXPECT_EQ(matches[2].name, "annual_report.pdf");
+  EXPECT_EQ(matches[2].kind, p2p::NameIndex::MatchKind::SUBSTRING);
+}
+
+TEST_F(NameIndexTest, IsCaseInsensitive) {
+  index.insert("Holiday_Photos.ZIP");
+
+  auto matches = index.search("photos.zip", 10);
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0].name, "Holiday_Photos.ZIP");
+}
+
+TEST_F(NameIndexTest, ShortQueriesScanAllNames) {
+  index.insert("a_very_long_name_with_the_letter_q_near_the_end.bin");
+  index.insert("xy");
+  index.insert("other");
+
+  EXPECT_EQ(names(index.search("q", 10)),
+            std::vector<std::string>(
+                {"a_very_long_name_with_the_letter_q_near_the_end.bin"}));
+  EXPECT_EQ(names(index.search("XY", 10)), std::vector<std::string>({"xy"}));
+}
+
+TEST_F(NameIndexTest, FindsMisspelledNames) {
+  index.insert("ubuntu-24.04-desktop-amd64.iso");
+  index.insert("debian-12-netinst.iso");
+
+  auto matches = index.search("ubunto-24.04-desktop", 10);
+  ASSERT_FALSE(matches.empty());
+  EXPECT_EQ(matches[0].name, "ubuntu-24.04-desktop-amd64.iso");
+  EXPECT_EQ(matches[0].kind, p2p::NameIndex::MatchKind::FUZZY);
+}
+
+TEST_F(NameIndexTest, ErasedNamesAreNotFound) {
+  index.insert("first.txt");
+  index.insert("second.txt");
+  EXPECT_FALSE(index.insert("first.txt"));
+  EXPECT_TRUE(index.erase("first.txt"));
+  EXPECT_FALSE(index.erase("first.txt"));
+  index.insert("third.txt");
+
+  EXPECT_EQ(index.size(), 2);
+  EXPECT_EQ(names(index.search(".txt", 10)),
+            std::vector<std::string>({"third.txt", "second.txt"}));
+}
+
+TEST_F(NameIndexTest, RespectsLimit) {
+  for (int i = 0; i < 100; ++i) {
+    index.insert("file_" + std::to_string(i));
+  }
+  auto matches = index.search("file", 5);
+  ASSERT_EQ(matches.size(), 5);
+  // Shortest names cover the most of their name and rank first
+  EXPECT_EQ(matches[0].name, "file_0");
+}
+
+TEST_F(NameIndexTest, SubstringScanMatchesStandardFind) {
+  std::mt19937 random_engine(11);
+  std::uniform_int_distribution<int> letter('a', 'c');
+  std::uniform_int_distribution<size_t> length(0, 70);
+  for (int round = 0; round < 2000; ++round) {
+    std::string haystack(length(random_engine), ' ');
+    std::string needle(std::min<size_t>(length(random_engine) % 6, 5), ' ');
+    for (auto &c : haystack) {
+      c = static_cast<char>(letter(random_engine));
+    }
+    for (auto &c : needle) {
+      c = static_cast<char>(letter(random_engine));
+    }
+    EXPECT_EQ(p2p::NameIndex::containsSubstring(haystack, needle),
+              haystack.find(needle) != std::string::npos)
+        << haystack << " / " << needle;
+  }
+}
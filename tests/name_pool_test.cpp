@@ -0,0 +1,81 @@
+#include "p2p-resource-sync/name_pool.hpp"
+#include "p2p-resource-sync/remote_resource_manager.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class NamePoolTest : public ::testing::Test {
+protected:
+  std::shared_ptr<p2p::NamePool> pool = std::make_shared<p2p::NamePool>();
+};
+
+TEST_F(NamePoolTest, InternsEqualNamesOnce) {
+  uint32_t first = pool->acquire("movie.mkv");
+  uint32_t second = pool->acquire(std::string("movie.mkv"));
+  uint32_t other = pool->acquire("song.mp3");
+
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, other);
+  EXPECT_EQ(pool->name(first), "movie.mkv");
+  EXPECT_EQ(pool->size(), 2);
+}
+
+TEST_F(NamePoolTest, ReleasedIdsAreReused) {
+  uint32_t id = pool->acquire("temporary");
+  pool->acquire("temporary");
+  pool->release(id);
+  EXPECT_EQ(pool->name(id), "temporary");
+
+  pool->release(id);
+  EXPECT_EQ(pool->size(), 0);
+  uint32_t reused = pool->acquire("replacement");
+  EXPECT_EQ(reused, id);
+  EXPECT_EQ(pool->name(reused), "replacement");
+}
+
+TEST_F(NamePoolTest, NamesStayValidAcrossChunks) {
+  std::vector<uint32_t> ids;
+  for (int i = 0; i < 5000; ++i) {
+    ids.push_back(pool->acquire("name_" + std::to_string(i)));
+  }
+  std::string_view first = pool->name(ids[0]);
+  for (int i = 5000; i < 10000; ++i) {
+    pool->acquire("name_" + std::to_string(i));
+  }
+  EXPECT_EQ(first, "name_0");
+  EXPECT_EQ(pool->name(ids[4999]), "name_4999");
+}
+
+TEST_F(NamePoolTest, ConcurrentAcquireAndRelease) {
+  {
+    std::vector<std::jthread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([this]() {
+        for (int i = 0; i < 2000; ++i) {
+          std::string name = "shared_" + std::to_string(i % 50);
+          uint32_t id = pool->acquire(name);
+          EXPECT_EQ(pool->name(id), name);
+          pool->release(id);
+        }
+      });
+    }
+  }
+  EXPECT_EQ(pool->size(), 0);
+}
+
+TEST_F(NamePoolTest, CatalogsShareNamesAndReleaseThem) {
+  std::vector<p2p::Resource> resources = {{"a_long_shared_file_name.iso", 1},
+                                          {"b_long_shared_file_name.iso", 2}};
+  {
+    p2p::CompactCatalog first(pool, resources);
+    p2p::CompactCatalog second(pool, resources);
+    EXPECT_EQ(first.entries(), second.entries());
+    EXPECT_EQ(pool->size(), 2);
+    EXPECT_EQ(first.name(first.entries()[1]), "b_long_shared_file_name.iso");
+    EXPECT_EQ(second.resourceAt(0).size, 1);
+    EXPECT_EQ(sizeof(p2p::CompactCatalog::Entry), 12);
+  }
+  EXPECT_EQ(pool->size(), 0);
+}
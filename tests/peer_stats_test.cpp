@@ -0,0 +1,136 @@
+#include "p2p-resource-sync/peer_stats.hpp"
+#include "p2p-resource-sync/remote_resource_manager.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+class PeerStatsTest : public ::testing::Test {
+protected:
+  p2p::PeerStatsTable table{0.0};
+  struct sockaddr_in fast = createAddress("10.0.0.1", 9000);
+  struct sockaddr_in slow = createAddress("10.0.0.2", 9000);
+  struct sockaddr_in fresh = createAddress("10.0.0.3", 9000);
+
+  static struct sockaddr_in createAddress(const char *ip, uint16_t port) {
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+  }
+
+  void recordSuccess(const sockaddr_in &peer, uint64_t bytes,
+                     std::chrono::milliseconds duration) {
+    table.recordAttempt(peer, p2p::TransferSample{.bytes = bytes,
+                                                  .duration = duration,
+                                                  .rtt = 1ms,
+                                                  .succeeded = true});
+  }
+
+  void recordFailure(const sockaddr_in &peer) {
+    table.recordAttempt(peer, p2p::TransferSample{.bytes = 0,
+                                                  .duration = {},
+                                                  .rtt = std::nullopt,
+                                                  .succeeded = false});
+  }
+
+  std::vector<p2p::PeerStatsTable::Candidate>
+  candidates(std::vector<sockaddr_in> peers) {
+    std::vector<p2p::PeerStatsTable::Candidate> result;
+    for (const auto &peer : peers) {
+      result.push_back({.address = peer, .size = 1 << 20,
+                        .deprioritised = false});
+    }
+    return result;
+  }
+};
+
+TEST_F(PeerStatsTest, AveragesSamples) {
+  recordSuccess(fast, 1000, 1000ms);
+  recordSuccess(fast, 2000, 1000ms);
+
+  auto stats = table.get(fast);
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->attempts, 2);
+  EXPECT_GT(stats->throughputBytesPerSecond, 1000);
+  EXPECT_LT(stats->throughputBytesPerSecond, 2000);
+  EXPECT_EQ(stats->failureRate, 0);
+  EXPECT_EQ(stats->rtt, 1ms);
+
+  recordFailure(fast);
+  EXPECT_GT(table.get(fast)->failureRate, 0);
+  EXPECT_FALSE(table.get(slow).has_value());
+}
+
+TEST_F(PeerStatsTest, RanksFasterPeersFirstAndUnmeasuredBeforeThem) {
+  recordSuccess(fast, 10 << 20, 100ms);
+  recordSuccess(slow, 1 << 20, 1000ms);
+
+  auto ranked = table.rank(candidates({slow, fast, fresh}));
+  ASSERT_EQ(ranked.size(), 3);
+  EXPECT_EQ(ranked[0].sin_addr.s_addr, fresh.sin_addr.s_addr);
+  EXPECT_EQ(ranked[1].sin_addr.s_addr, fast.sin_addr.s_addr);
+  EXPECT_EQ(ranked[2].sin_addr.s_addr, slow.sin_addr.s_addr);
+}
+
+TEST_F(PeerStatsTest, UnhealthyAndBusyPeersLoseTheirRank) {
+  recordSuccess(fast, 10 << 20, 100ms);
+  recordSuccess(slow, 5 << 20, 100ms);
+  for (int i = 0; i < 4; ++i) {
+    table.transferStarted(fast);
+  }
+  auto ranked = table.rank(candidates({fast, slow}));
+  EXPECT_EQ(ranked[0].sin_addr.s_addr, slow.sin_addr.s_addr);
+
+  for (int i = 0; i < 4; ++i) {
+    table.transferFinished(fast);
+  }
+  recordFailure(slow);
+  recordFailure(slow);
+  recordFailure(slow);
+  ranked = table.rank(candidates({slow, fast, fresh}));
+  EXPECT_EQ(ranked.back().sin_addr.s_addr, slow.sin_addr.s_addr);
+}
+
+TEST_F(PeerStatsTest, ExplorationPromotesAnotherHealthyPeer) {
+  recordSuccess(fast, 10 << 20, 100ms);
+  recordSuccess(slow, 1 << 20, 1000ms);
+  table.setExplorationRate(1.0);
+
+  auto ranked = table.rank(candidates({fast, slow}));
+  EXPECT_EQ(ranked[0].sin_addr.s_addr, slow.sin_addr.s_addr);
+  EXPECT_EQ(ranked[1].sin_addr.s_addr, fast.sin_addr.s_addr);
+}
+
+TEST_F(PeerStatsTest, RetainKeepsBusyPeers) {
+  recordSuccess(fast, 1000, 10ms);
+  recordSuccess(slow, 1000, 10ms);
+  table.transferStarted(slow);
+
+  table.retain([](const sockaddr_in &) { return false; });
+  EXPECT_FALSE(table.get(fast).has_value());
+  EXPECT_TRUE(table.get(slow).has_value());
+}
+
+TEST_F(PeerStatsTest, ManagerRanksConfirmedHoldersByStatistics) {
+  p2p::RemoteResourceManager manager(std::chrono::seconds(60));
+  manager.setExplorationRate(0.0);
+  uint64_t now = std::chrono::system_clock::now().time_since_epoch().count();
+  manager.addOrUpdateNodeResources(fast, {{"movie.mkv", 1 << 20}}, now);
+  manager.addOrUpdateNodeResources(slow, {{"movie.mkv", 1 << 20}}, now);
+
+  manager.recordTransferAttempt(
+      slow, {.bytes = 1 << 20, .duration = 1s, .rtt = 1ms, .succeeded = true});
+  manager.recordTransferAttempt(
+      fast,
+      {.bytes = 1 << 20, .duration = 100ms, .rtt = 1ms, .succeeded = true});
+
+  auto ranked = manager.rankHolders("movie.mkv");
+  ASSERT_EQ(ranked.size(), 2);
+  EXPECT_EQ(ranked[0].sin_addr.s_addr, fast.sin_addr.s_addr);
+  EXPECT_TRUE(manager.rankHolders("missing").empty());
+}
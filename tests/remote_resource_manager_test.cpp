@@ -1,5 +1,7 @@
 #include "p2p-resource-sync/remote_resource_manager.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <atomic>
 #include <chrono>
 #include <ctime>
 #include <gtest/gtest.h>
@@ -51,6 +53,19 @@ TEST_F(RemoteResourceManagerTest, CanAddSingleResourceToNode) {
   EXPECT_FALSE(manager.getAllResources().empty());
 }
 
+TEST_F(RemoteResourceManagerTest, KeepsSizesAboveFourGiB) {
+  struct sockaddr_in node_address = this->createAddress("192.168.1.1", 8000);
+  uint64_t size = (6ULL << 30) + 3;
+  manager.addOrUpdateNodeResources(
+      node_address, {{"dataset.tar", size}},
+      std::chrono::system_clock::now().time_since_epoch().count());
+
+  auto holders = manager.findResourceHolders("dataset.tar");
+  ASSERT_EQ(holders.size(), 1);
+  EXPECT_EQ(holders[0].size, size);
+  EXPECT_EQ(manager.getAllResources()[0].second.size, size);
+}
+
 TEST_F(RemoteResourceManagerTest, CanAddMultipleResourcesToNode) {
   struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
   p2p::Resource resource1{.name = "test_resource1", .size = 100};
@@ -173,3 +188,292 @@ TEST_F(RemoteResourceManagerTest, CleanupStaleNodesSkipTest) {
   EXPECT_TRUE(manager.hasResource(node_address1, "test1.txt"));
   EXPECT_TRUE(manager.hasResource(node_address2, "test2.txt"));
 }
+
+TEST_F(RemoteResourceManagerTest, RefreshNodeWithKnownDigest) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  std::vector<p2p::Resource> resources = {{"test.txt", 1000}};
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+  manager.addOrUpdateNodeResources(node_address1, resources, timestamp, 42);
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  uint64_t refreshed_timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+  EXPECT_TRUE(manager.refreshNode(node_address1, 42, refreshed_timestamp));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  manager.cleanupStaleNodes();
+  EXPECT_TRUE(manager.hasResource(node_address1, "test.txt"));
+}
+
+TEST_F(RemoteResourceManagerTest, RefreshNodeWithUnknownDigestFails) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  struct sockaddr_in node_address2 = this->createAddress("192.168.1.2", 8000);
+  std::vector<p2p::Resource> resources = {{"test.txt", 1000}};
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+  manager.addOrUpdateNodeResources(node_address1, resources, timestamp, 42);
+
+  EXPECT_FALSE(manager.refreshNode(node_address1, 43, timestamp + 1));
+  EXPECT_FALSE(manager.refreshNode(node_address2, 42, timestamp + 1));
+}
+
+TEST_F(RemoteResourceManagerTest, AnnouncementWithOlderTimestampIsIgnored) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+  manager.addOrUpdateNodeResources(node_address1, {{"new.txt", 1}}, timestamp);
+  manager.addOrUpdateNodeResources(node_address1, {{"old.txt", 1}},
+                                   timestamp - 1);
+
+  EXPECT_TRUE(manager.hasResource(node_address1, "new.txt"));
+  EXPECT_FALSE(manager.hasResource(node_address1, "old.txt"));
+}
+
+TEST_F(RemoteResourceManagerTest, IdenticalCatalogsFromDifferentNodes) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  struct sockaddr_in node_address2 = this->createAddress("192.168.1.2", 8000);
+  std::vector<p2p::Resource> resources = {{"a.txt", 1}, {"b.txt", 2}};
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+
+  manager.addOrUpdateNodeResources(node_address1, resources, timestamp, 7);
+  manager.addOrUpdateNodeResources(node_address2, resources, timestamp, 7);
+  manager.addOrUpdateNodeResources(node_address2, {{"c.txt", 3}},
+                                   timestamp + 1, 8);
+
+  EXPECT_TRUE(manager.hasResource(node_address1, "a.txt"));
+  EXPECT_TRUE(manager.hasResource(node_address1, "b.txt"));
+  EXPECT_FALSE(manager.hasResource(node_address2, "a.txt"));
+  EXPECT_TRUE(manager.hasResource(node_address2, "c.txt"));
+  EXPECT_EQ(manager.getAllResources().size(), 3);
+}
+
+TEST_F(RemoteResourceManagerTest, IndexFollowsCatalogUpdates) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  struct sockaddr_in node_address2 = this->createAddress("192.168.1.2", 8000);
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+
+  manager.addOrUpdateNodeResources(node_address1,
+                                   {{"a.txt", 10}, {"b.txt", 20}}, timestamp);
+  manager.addOrUpdateNodeResources(node_address2, {{"b.txt", 20}}, timestamp);
+  EXPECT_EQ(manager.findNodesWithResource("b.txt").size(), 2);
+
+  // Unsorted on purpose, exercises the full reindex
+  manager.addOrUpdateNodeResources(node_address1,
+                                   {{"c.txt", 30}, {"b.txt", 25}},
+                                   timestamp + 1);
+  EXPECT_TRUE(manager.findNodesWithResource("a.txt").empty());
+  EXPECT_EQ(manager.findNodesWithResource("c.txt").size(), 1);
+
+  auto holders = manager.findResourceHolders("b.txt");
+  ASSERT_EQ(holders.size(), 2);
+  for (const auto &holder : holders) {
+    bool first = holder.address.sin_addr.s_addr ==
+                 node_address1.sin_addr.s_addr;
+    EXPECT_EQ(holder.size, first ? 25 : 20);
+  }
+
+  manager.removeNode(node_address1);
+  EXPECT_TRUE(manager.findNodesWithResource("c.txt").empty());
+  EXPECT_FALSE(manager.hasResource(node_address1, "b.txt"));
+  EXPECT_TRUE(manager.hasResource(node_address2, "b.txt"));
+}
+
+TEST_F(RemoteResourceManagerTest, SortedCatalogUpdateOnlyTouchesChanges) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+
+  std::vector<p2p::Resource> resources;
+  for (int i = 0; i < 10000; ++i) {
+    char name[16];
+    snprintf(name, sizeof(name), "file_%05d", i);
+    resources.push_back({name, static_cast<uint32_t>(i)});
+  }
+  manager.addOrUpdateNodeResources(node_address1, resources, timestamp);
+
+  resources.erase(resources.begin() + 5);
+  resources[100].size = 1;
+  resources.push_back({"zzz", 7});
+  manager.addOrUpdateNodeResources(node_address1, resources, timestamp + 1);
+
+  EXPECT_FALSE(manager.hasResource(node_address1, "file_00005"));
+  EXPECT_EQ(manager.findResourceHolders(resources[100].name)[0].size, 1);
+  EXPECT_TRUE(manager.hasResource(node_address1, "zzz"));
+  EXPECT_TRUE(manager.hasResource(node_address1, "file_09999"));
+}
+
+TEST_F(RemoteResourceManagerTest, StaleNodesLeaveTheIndex) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  this->addFreshNode(node_address1);
+  ASSERT_FALSE(manager.findNodesWithResource("test.txt").empty());
+
+  std::this_thread::sleep_for(std::chrono::seconds(3));
+  manager.cleanupStaleNodes();
+
+  EXPECT_TRUE(manager.findNodesWithResource("test.txt").empty());
+}
+
+TEST_F(RemoteResourceManagerTest, SearchReturnsHoldersAndFollowsUpdates) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  struct sockaddr_in node_address2 = this->createAddress("192.168.1.2", 8000);
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+  manager.addOrUpdateNodeResources(
+      node_address1, {{"music/album.flac", 300}, {"notes.txt", 1}}, timestamp);
+  manager.addOrUpdateNodeResources(node_address2, {{"music/album.flac", 300}},
+                                   timestamp);
+
+  auto matches = manager.searchResources("ALBUM");
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0].name, "music/album.flac");
+  ASSERT_EQ(matches[0].holders.size(), 2);
+  EXPECT_EQ(matches[0].holders[0].size, 300);
+
+  manager.addOrUpdateNodeResources(node_address1, {{"notes.txt", 1}},
+                                   timestamp + 1);
+  manager.removeNode(node_address2);
+  EXPECT_TRUE(manager.searchResources("album").empty());
+  EXPECT_EQ(manager.searchResources("note").size(), 1);
+}
+
+TEST_F(RemoteResourceManagerTest, PagesAndVisitorCoverAllResources) {
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+  for (uint16_t node = 0; node < 5; ++node) {
+    std::vector<p2p::Resource> resources;
+    for (uint32_t i = 0; i < 7; ++i) {
+      resources.push_back({"file_" + std::to_string(i), i});
+    }
+    manager.addOrUpdateNodeResources(this->createAddress("10.0.0.1", node),
+                                     resources, timestamp);
+  }
+
+  size_t visited = 0;
+  manager.forEachResource(
+      [&visited](const sockaddr_in &, std::string_view, uint32_t) {
+        visited++;
+      });
+  EXPECT_EQ(visited, 35);
+
+  std::vector<std::pair<uint16_t, std::string>> paged;
+  std::optional<p2p::RemoteResourceCursor> cursor;
+  do {
+    auto page = manager.getResourcePage(cursor, 4);
+    EXPECT_LE(page.resources.size(), 4);
+    for (const auto &[address, resource] : page.resources) {
+      paged.emplace_back(ntohs(address.sin_port), resource.name);
+    }
+    cursor = page.nextCursor;
+  } while (cursor);
+
+  ASSERT_EQ(paged.size(), 35);
+  EXPECT_EQ(paged.front(), std::make_pair(uint16_t{0}, std::string("file_0")));
+  EXPECT_EQ(paged.back(), std::make_pair(uint16_t{4}, std::string("file_6")));
+  std::ranges::sort(paged);
+  EXPECT_EQ(std::ranges::unique(paged).begin(), paged.end());
+}
+
+TEST_F(RemoteResourceManagerTest, RunExpiresNodesAtTheirDeadline) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  struct sockaddr_in node_address2 = this->createAddress("192.168.1.2", 8000);
+  std::jthread expiry_thread([this]() { manager.run(); });
+
+  this->addFreshNode(node_address1);
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  this->addFreshNode(node_address2);
+
+  // Each node leaves shortly after its own deadline, without a full scan
+  std::this_thread::sleep_for(std::chrono::milliseconds(1300));
+  EXPECT_FALSE(manager.hasResource(node_address1, "test.txt"));
+  EXPECT_TRUE(manager.hasResource(node_address2, "test.txt"));
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  EXPECT_EQ(manager.getNodeCount(), 0);
+
+  manager.stop();
+}
+
+TEST_F(RemoteResourceManagerTest, AnnouncingNodesAreRearmed) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  std::jthread expiry_thread([this]() { manager.run(); });
+
+  this->addFreshNode(node_address1);
+  for (int i = 0; i < 4; ++i) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    uint64_t timestamp =
+        std::chrono::system_clock::now().time_since_epoch().count();
+    manager.addOrUpdateNodeResources(node_address1, {{"test.txt", 1000}},
+                                     timestamp);
+  }
+  EXPECT_TRUE(manager.hasResource(node_address1, "test.txt"));
+
+  // Removed and re-added nodes are not expired by their old entry
+  manager.removeNode(node_address1);
+  this->addFreshNode(node_address1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  EXPECT_TRUE(manager.hasResource(node_address1, "test.txt"));
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  EXPECT_FALSE(manager.hasResource(node_address1, "test.txt"));
+
+  manager.stop();
+}
+
+TEST_F(RemoteResourceManagerTest, ConcurrentWritersAreBatchedAndVisible) {
+  const int writers = 8;
+  const int updates_per_writer = 200;
+  std::atomic<bool> writing{true};
+  std::atomic<size_t> reads{0};
+
+  std::vector<std::jthread> readers;
+  for (int i = 0; i < 2; ++i) {
+    readers.emplace_back([&]() {
+      while (writing) {
+        manager.findNodesWithResource("shared.txt");
+        reads++;
+      }
+    });
+  }
+
+  {
+    std::vector<std::jthread> threads;
+    for (int w = 0; w < writers; ++w) {
+      threads.emplace_back([&, w]() {
+        auto address = this->createAddress("10.0.0.1", 9000 + w);
+        uint64_t timestamp =
+            std::chrono::system_clock::now().time_since_epoch().count();
+        for (int i = 0; i < updates_per_writer; ++i) {
+          std::string own = "own_" + std::to_string(i);
+          manager.addOrUpdateNodeResources(
+              address, {{own, 1}, {"shared.txt", 2}}, timestamp + i);
+          // Every write is visible once the call returns
+          EXPECT_TRUE(manager.hasResource(address, own));
+        }
+      });
+    }
+  }
+  writing = false;
+  readers.clear();
+
+  EXPECT_GT(reads, 0);
+  EXPECT_EQ(manager.findNodesWithResource("shared.txt").size(), writers);
+  EXPECT_LE(manager.getSnapshotVersion(), writers * updates_per_writer);
+  EXPECT_EQ(manager.getAllResources().size(), writers * 2);
+}
+
+TEST_F(RemoteResourceManagerTest, DigestRefreshDoesNotPublishSnapshot) {
+  struct sockaddr_in node_address1 = this->createAddress("192.168.1.1", 8000);
+  this->addFreshNode(node_address1);
+  auto version = manager.getSnapshotVersion();
+
+  // A refresh with the known digest does not publish a new snapshot
+  uint64_t timestamp =
+      std::chrono::system_clock::now().time_since_epoch().count();
+  manager.addOrUpdateNodeResources(node_address1, {{"d.txt", 1}}, timestamp,
+                                   42);
+  EXPECT_TRUE(manager.refreshNode(node_address1, 42, timestamp + 1));
+  EXPECT_EQ(manager.getSnapshotVersion(), version + 1);
+}
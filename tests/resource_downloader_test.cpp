@@ -1,3 +1,4 @@
+#include <arpa/inet.h>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
@@ -72,6 +73,7 @@ protected:
     manager->addResource("test.txt", test_file_path);
 
     server_thread = std::thread([this]() { server->run(); });
+    ASSERT_TRUE(server->waitUntilListening(std::chrono::seconds(5)));
   }
   void TearDown() override {
     server->stop();
@@ -165,6 +167,99 @@ TEST_F(ResourceDownloaderTest, CanDownloadExistingResource) {
   EXPECT_TRUE(compareFiles(downloaded_file, original_file));
 }
 
+TEST_F(ResourceDownloaderTest, RecordsTransferStatistics) {
+  auto remote_manager =
+      std::make_shared<p2p::RemoteResourceManager>(std::chrono::seconds(60));
+  downloader->setPeerStatsSink(remote_manager);
+  struct sockaddr_in node_address {};
+  node_address.sin_family = AF_INET;
+  node_address.sin_port = htons(9000);
+  inet_pton(AF_INET, "127.0.0.1", &node_address.sin_addr);
+
+  auto [received, total_size] =
+      downloader->downloadResource(node_address, server_port, 0, "test.txt");
+  EXPECT_EQ(received, total_size);
+  downloader->downloadResource(node_address, server_port, 0, "missing.txt");
+
+  auto stats = remote_manager->getPeerStats(node_address);
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->attempts, 2);
+  EXPECT_EQ(stats->activeTransfers, 0);
+  EXPECT_GT(stats->throughputBytesPerSecond, 0);
+  EXPECT_GT(stats->failureRate, 0);
+  EXPECT_LT(stats->failureRate, 1);
+}
+
+TEST_F(ResourceDownloaderTest, ResumesPastFourGiBOfSparseFile) {
+  const uint64_t offset = 4ULL << 30;
+  const uint64_t size = offset + (1 << 20);
+  std::string large_path = test_files_dir + "/large.bin";
+  std::string partial_path = download_dir + "/large.bin";
+  {
+    std::ofstream file(large_path, std::ios::binary);
+    file.seekp(static_cast<std::streamoff>(size - 4));
+    file.write("tail", 4);
+  }
+  std::ofstream(partial_path, std::ios::binary).close();
+  std::filesystem::resize_file(partial_path, offset);
+  manager->addResource("large.bin", large_path);
+
+  auto [received, total_size] =
+      downloader->downloadResource("127.0.0.1", server_port, offset,
+                                   "large.bin");
+  EXPECT_EQ(total_size, size);
+  EXPECT_EQ(received, size);
+  EXPECT_EQ(std::filesystem::file_size(partial_path), size);
+
+  std::ifstream downloaded(partial_path, std::ios::binary);
+  downloaded.seekg(static_cast<std::streamoff>(size - 4));
+  std::string tail(4, '\0');
+  downloaded.read(tail.data(), 4);
+  EXPECT_EQ(tail, "tail");
+
+  std::filesystem::remove(large_path);
+}
+
+TEST_F(ResourceDownloaderTest, DownloadsNestedNamesIntoSubdirectories) {
+  manager->addResource("albums/live/test.txt", test_file_path);
+
+  auto [received, total_size] = downloader->downloadResource(
+      "127.0.0.1", server_port, 0, "albums/live/test.txt");
+  EXPECT_EQ(received, total_size);
+  EXPECT_TRUE(compareFiles(download_dir + "/albums/live/test.txt",
+                           test_file_path));
+  std::filesystem::remove_all(download_dir + "/albums");
+
+  EXPECT_THROW(downloader->downloadResource("127.0.0.1", server_port, 0,
+                                            "../escaped.txt"),
+               std::runtime_error);
+  EXPECT_THROW(
+      downloader->downloadResource("127.0.0.1", server_port, 0, "/etc/passwd"),
+      std::runtime_error);
+}
+
+TEST_F(ResourceDownloaderTest, ServesRewrittenFileAndRefreshesCatalog) {
+  {
+    std::ofstream test_file(test_file_path, std::ios::app);
+    test_file << "Appended after the resource was added\n";
+  }
+  auto size = std::filesystem::file_size(test_file_path);
+  ASSERT_NE(manager->getResourceInfo("test.txt")->size, size);
+
+  auto [received, total_size] =
+      downloader->downloadResource("127.0.0.1", server_port, 0, "test.txt");
+  EXPECT_EQ(total_size, size);
+  EXPECT_EQ(received, size);
+  EXPECT_TRUE(compareFiles(download_dir + "/test.txt", test_file_path));
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (manager->getResourceInfo("test.txt")->size != size &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(manager->getResourceInfo("test.txt")->size, size);
+}
+
 TEST_F(ResourceDownloaderTest, ConcurrentDownloadsStressTest) {
   const int NUM_CLIENTS = 25;
   std::vector<std::unique_ptr<p2p::ResourceDownloader>> downloaders;
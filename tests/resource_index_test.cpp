@@ -0,0 +1,208 @@
+#include "p2p-resource-sync/local_resource_manager.hpp"
+#include "p2p-resource-sync/resource_index.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+class ResourceIndexTest : public ::testing::Test {
+protected:
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "resource_index_test";
+  std::filesystem::path index_path = directory / "index.log";
+
+  void SetUp() override {
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory); }
+
+  std::string writeFile(const std::string &name, const std::string &content) {
+    auto path = directory / name;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+    return path.string();
+  }
+
+  static p2p::ResourceInfo resource(const std::string &name, uint64_t size) {
+    return p2p::ResourceInfo{.name = name,
+                             .path = "/shared/" + name,
+                             .size = size,
+                             .lastModified = 1700000000,
+                             .fileModified = 42,
+                             .contentHash = size * 3};
+  }
+
+  static bool waitUntil(const std::function<bool()> &condition) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (std::chrono::steady_clock::now() < deadline) {
+      if (condition()) {
+        return true;
+      }
+      std::this_thread::sleep_for(10ms);
+    }
+    return condition();
+  }
+};
+
+TEST_F(ResourceIndexTest, ReplaysAdditionsAndRemovals) {
+  {
+    p2p::ResourceIndex index(index_path);
+    EXPECT_TRUE(index.restored().empty());
+    index.recordAdd(resource("a", 1));
+    index.recordAdd(resource("b", 2));
+    index.recordAdd(resource("a", 10));
+    index.recordRemove("b");
+  }
+
+  p2p::ResourceIndex index(index_path);
+  ASSERT_EQ(index.restored().size(), 1);
+  const auto &a = index.restored().at("a");
+  EXPECT_EQ(a.path, "/shared/a");
+  EXPECT_EQ(a.size, 10);
+  EXPECT_EQ(a.lastModified, 1700000000);
+  EXPECT_EQ(a.fileModified, 42);
+  EXPECT_EQ(a.contentHash, 30);
+  EXPECT_EQ(index.getRecordCount(), 4);
+}
+
+TEST_F(ResourceIndexTest, DropsTornTailAndKeepsAppending) {
+  {
+    p2p::ResourceIndex index(index_path);
+    index.recordAdd(resource("kept", 1));
+    index.recordAdd(resource("torn", 2));
+  }
+  // A crash in the middle of the last write
+  std::filesystem::resize_file(index_path,
+                               std::filesystem::file_size(index_path) - 3);
+  {
+    p2p::ResourceIndex index(index_path);
+    ASSERT_EQ(index.restored().size(), 1);
+    EXPECT_TRUE(index.restored().contains("kept"));
+    index.recordAdd(resource("after", 3));
+  }
+
+  p2p::ResourceIndex index(index_path);
+  EXPECT_EQ(index.restored().size(), 2);
+  EXPECT_TRUE(index.restored().contains("after"));
+}
+
+TEST_F(ResourceIndexTest, RejectsForeignFiles) {
+  std::ofstream(index_path, std::ios::binary) << "not an index at all";
+  EXPECT_THROW(p2p::ResourceIndex index(index_path), std::runtime_error);
+}
+
+TEST_F(ResourceIndexTest, CompactionKeepsOnlyLiveResources) {
+  p2p::LocalCatalog live{
+      .version = 1,
+      .resources = {std::make_shared<const p2p::ResourceInfo>(resource("a", 1))}};
+  p2p::ResourceIndex index(index_path);
+  for (int i = 0; i < 100; ++i) {
+    index.recordAdd(resource("a", 1));
+  }
+  auto size_before = std::filesystem::file_size(index_path);
+  index.compact(live);
+  EXPECT_EQ(index.getRecordCount(), 1);
+  EXPECT_LT(std::filesystem::file_size(index_path), size_before / 50);
+
+  index.recordAdd(resource("b", 2));
+  p2p::ResourceIndex reopened(index_path);
+  EXPECT_EQ(reopened.restored().size(), 2);
+}
+
+TEST_F(ResourceIndexTest, ManagerRestoresCatalogWithoutResourceCap) {
+  auto path = writeFile("shared.bin", "content");
+  {
+    p2p::LocalResourceManager manager;
+    manager.enablePersistence(index_path);
+    for (int i = 0; i < 1500; ++i) {
+      manager.addResource("resource_" + std::to_string(i), path);
+    }
+    manager.removeResource("resource_0");
+  }
+
+  p2p::LocalResourceManager manager;
+  manager.enablePersistence(index_path);
+  EXPECT_EQ(manager.getAllResources().size(), 1499);
+  EXPECT_FALSE(manager.getResourceInfo("resource_0").has_value());
+  EXPECT_EQ(manager.getResourceInfo("resource_1499")->path, path);
+}
+
+TEST_F(ResourceIndexTest, ManagerVerifiesRestoredResourcesInBackground) {
+  auto kept = writeFile("kept.bin", "kept");
+  auto deleted = writeFile("deleted.bin", "deleted");
+  auto changed = writeFile("changed.bin", "old");
+  {
+    p2p::LocalResourceManager manager;
+    manager.enablePersistence(index_path);
+    manager.addResource("kept", kept);
+    manager.addResource("deleted", deleted);
+    manager.addResource("changed", changed);
+  }
+  std::filesystem::remove(deleted);
+  writeFile("changed.bin", "new and longer");
+
+  p2p::LocalResourceManager manager;
+  manager.enablePersistence(index_path);
+  EXPECT_TRUE(waitUntil([&manager]() {
+    return !manager.getResourceInfo("deleted").has_value() &&
+           manager.getResourceInfo("changed")->size == 14;
+  }));
+  EXPECT_TRUE(manager.getResourceInfo("kept").has_value());
+}
+
+TEST_F(ResourceIndexTest, ManagerIgnoresReAddingUnchangedFiles) {
+  auto path = writeFile("same.bin", "same");
+  p2p::LocalResourceManager manager;
+  EXPECT_TRUE(manager.addResource("same", path));
+  auto version = manager.getVersion();
+
+  EXPECT_FALSE(manager.addResource("same", path));
+  EXPECT_EQ(manager.getVersion(), version);
+}
+
+TEST_F(ResourceIndexTest, BatchCompactedMidwayKeepsEveryResource) {
+  {
+    p2p::LocalResourceManager manager;
+    manager.enablePersistence(index_path);
+    for (int i = 0; i < 10; ++i) {
+      manager.addResource("kept_" + std::to_string(i),
+                          writeFile("kept_" + std::to_string(i), "old"));
+    }
+    // Just short of compacting: 10 live resources, 1040 records
+    auto churn = writeFile("churn", "churn");
+    for (int i = 0; i < 515; ++i) {
+      manager.addResource("churn", churn);
+      manager.removeResource("churn");
+    }
+    // A published snapshot, as the broadcaster keeps one
+    manager.getSnapshot();
+
+    // New files first, then rewritten ones, which add records without
+    // adding resources and so trigger a compaction within the batch
+    std::vector<p2p::NewResource> batch{
+        {.name = "new_a", .path = writeFile("new_a", "a")},
+        {.name = "new_b", .path = writeFile("new_b", "b")}};
+    for (int i = 0; i < 10; ++i) {
+      auto name = "kept_" + std::to_string(i);
+      batch.push_back({.name = name, .path = writeFile(name, "rewritten")});
+    }
+    manager.addResources(batch);
+  }
+
+  p2p::ResourceIndex index(index_path);
+  EXPECT_LT(index.getRecordCount(), 1040);
+  EXPECT_EQ(index.restored().size(), 12);
+  EXPECT_TRUE(index.restored().contains("new_a"));
+  EXPECT_TRUE(index.restored().contains("new_b"));
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(index.restored().at("kept_" + std::to_string(i)).size, 9);
+  }
+}
@@ -1,7 +1,13 @@
+#include "p2p-resource-sync/catalog_fetcher.hpp"
 #include "p2p-resource-sync/local_resource_manager.hpp"
 #include "p2p-resource-sync/tcp_server.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <memory>
+#include <thread>
 
 class TcpServerTest : public ::testing::Test {
 protected:
@@ -15,3 +21,27 @@ protected:
 TEST_F(TcpServerTest, CanBeInstantiated) {
   EXPECT_NO_THROW({ p2p::TcpServer server(resource_manager); });
 }
+
+TEST_F(TcpServerTest, ServesCatalog) {
+  auto temp_path = std::filesystem::temp_directory_path() / "catalog_file";
+  std::ofstream(temp_path) << "catalog content";
+  resource_manager->addResource("catalog_file", temp_path.string());
+
+  p2p::TcpServer server(resource_manager, 8086);
+  std::thread server_thread([&server]() { server.run(); });
+  EXPECT_TRUE(server.waitUntilListening(std::chrono::seconds(5)));
+
+  struct in_addr loopback;
+  inet_pton(AF_INET, "127.0.0.1", &loopback);
+  p2p::CatalogFetcher fetcher;
+  p2p::FetchedCatalog catalog;
+  EXPECT_NO_THROW(catalog = fetcher.fetch(loopback, 8086));
+
+  server.stop();
+  server_thread.join();
+  std::filesystem::remove(temp_path);
+
+  ASSERT_EQ(catalog.resources.size(), 1);
+  EXPECT_EQ(catalog.resources[0].name, "catalog_file");
+  EXPECT_EQ(catalog.resources[0].size, 15);
+}